@@ -0,0 +1,420 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef ASYNCCONCURRENTQUEUE_H
+#define ASYNCCONCURRENTQUEUE_H
+
+#include "common/common.h"
+
+#if HAKLE_CPP_VERSION >= 20
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentQueue/ConcurrentQueue.h"
+
+namespace hakle {
+
+// anything that can run a resumed coroutine: a thread pool, an io loop, a strand...
+template <class Executor>
+concept IsAsyncExecutor = requires( Executor& InExecutor, std::coroutine_handle<> Handle ) { InExecutor.Post( Handle ); };
+
+namespace details {
+
+// one suspended AsyncDequeue, lives inside the awaiting coroutine's frame
+struct AsyncWaiter {
+    AsyncWaiter* Next{ nullptr };
+
+    // runs on the waking thread, moves elements straight into the awaiter; false if the queue ran dry
+    bool ( *TryTake )( AsyncWaiter& ){ nullptr };
+
+    // null means resume inline on the waking thread
+    void ( *Post )( void*, std::coroutine_handle<> ){ nullptr };
+    void*                   Executor{ nullptr };
+    std::coroutine_handle<> Handle;
+
+    void Resume() {
+        if ( Post != nullptr ) {
+            Post( Executor, Handle );
+        }
+        else {
+            Handle.resume();
+        }
+    }
+};
+
+// intrusive treiber stack, consumers push themselves one by one, a waker takes the whole stack at once
+class AsyncWaiterList {
+public:
+    HAKLE_NODISCARD bool Empty() const noexcept { return Head.load( std::memory_order_relaxed ) == nullptr; }
+
+    void Push( AsyncWaiter* First, AsyncWaiter* Last ) noexcept {
+        AsyncWaiter* OldHead = Head.load( std::memory_order_relaxed );
+        do {
+            Last->Next = OldHead;
+        } while ( !Head.compare_exchange_weak( OldHead, First, std::memory_order_release, std::memory_order_relaxed ) );
+    }
+
+    // oldest waiter first
+    AsyncWaiter* TakeAll() noexcept {
+        AsyncWaiter* Node     = Head.exchange( nullptr, std::memory_order_acquire );
+        AsyncWaiter* Reversed = nullptr;
+        while ( Node != nullptr ) {
+            AsyncWaiter* Next = Node->Next;
+            Node->Next        = Reversed;
+            Reversed          = Node;
+            Node              = Next;
+        }
+        return Reversed;
+    }
+
+private:
+    std::atomic<AsyncWaiter*> Head{ nullptr };
+};
+
+}  // namespace details
+
+// MPMC queue whose consumers can co_await an element instead of polling, built on ConcurrentQueue.
+// a consumer that finds the queue empty parks itself on an intrusive waiter list; the next enqueue takes
+// the whole list, moves elements into as many waiters as it can and resumes them on their executors,
+// so a burst of enqueues costs one list exchange instead of one wake-up per element.
+// a suspended AsyncDequeue must not be destroyed, and the queue must outlive its waiters.
+// a moved-from queue has no waiter list: it can still be enqueued into, dequeued from with TryDequeue,
+// assigned to or destroyed, but must not be awaited until something is moved back into it.
+template <class T, class Allocator = HakleAllocator<T>, IsConcurrentQueueTraits Traits = ConcurrentQueueDefaultTraits<T, Allocator>>
+class AsyncConcurrentQueue {
+private:
+    using InnerQueue = ConcurrentQueue<T, Allocator, Traits>;
+
+public:
+    using ProducerToken = typename InnerQueue::ProducerToken;
+    using ConsumerToken = typename InnerQueue::ConsumerToken;
+    using ProducerDepth = typename InnerQueue::ProducerDepth;
+    using Reservation   = typename InnerQueue::Reservation;
+    using AllocatorType = typename InnerQueue::AllocatorType;
+
+    class DequeueAwaiter;
+    template <class Iterator>
+    class DequeueBulkAwaiter;
+
+    explicit AsyncConcurrentQueue( const AllocatorType& InAllocator = AllocatorType{} ) : Inner( InAllocator ), Waiters( std::make_unique<details::AsyncWaiterList>() ) {}
+
+    ~AsyncConcurrentQueue() = default;
+
+    AsyncConcurrentQueue( AsyncConcurrentQueue&& Other ) noexcept            = default;
+    AsyncConcurrentQueue& operator=( AsyncConcurrentQueue&& Other ) noexcept = default;
+
+    AsyncConcurrentQueue( const AsyncConcurrentQueue& )            = delete;
+    AsyncConcurrentQueue& operator=( const AsyncConcurrentQueue& ) = delete;
+
+    void swap( AsyncConcurrentQueue& Other ) noexcept {
+        Inner.swap( Other.Inner );
+        Waiters.swap( Other.Waiters );
+    }
+
+    ProducerToken GetProducerToken() noexcept { return Inner.GetProducerToken(); }
+    ConsumerToken GetConsumerToken() noexcept { return Inner.GetConsumerToken(); }
+
+    template <class... Args>
+    requires std::is_constructible_v<T, Args...>
+    bool Enqueue( Args&&... args ) {
+        return Notify( Inner.Enqueue( std::forward<Args>( args )... ) );
+    }
+
+    template <class... Args>
+    requires std::is_constructible_v<T, Args...>
+    bool EnqueueWithToken( const ProducerToken& Token, Args&&... args ) {
+        return Notify( Inner.EnqueueWithToken( Token, std::forward<Args>( args )... ) );
+    }
+
+    template <std::input_iterator Iterator>
+    requires requires( Iterator Item ) { T( *Item ); }
+    bool EnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        return Notify( Inner.EnqueueBulk( std::move( ItemFirst ), Count ) );
+    }
+
+    template <std::input_iterator Iterator>
+    requires requires( Iterator Item ) { T( *Item ); }
+    bool EnqueueBulk( const ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        return Notify( Inner.EnqueueBulk( Token, std::move( ItemFirst ), Count ) );
+    }
+
+    template <class... Args>
+    requires std::is_constructible_v<T, Args...>
+    bool TryEnqueue( Args&&... args ) {
+        return Notify( Inner.TryEnqueue( std::forward<Args>( args )... ) );
+    }
+
+    template <class... Args>
+    requires std::is_constructible_v<T, Args...>
+    bool TryEnqueue( const ProducerToken& Token, Args&&... args ) {
+        return Notify( Inner.TryEnqueue( Token, std::forward<Args>( args )... ) );
+    }
+
+    template <std::input_iterator Iterator>
+    requires requires( Iterator Item ) { T( *Item ); }
+    bool TryEnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        return Notify( Inner.TryEnqueueBulk( std::move( ItemFirst ), Count ) );
+    }
+
+    template <std::input_iterator Iterator>
+    requires requires( Iterator Item ) { T( *Item ); }
+    bool TryEnqueueBulk( const ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        return Notify( Inner.TryEnqueueBulk( Token, std::move( ItemFirst ), Count ) );
+    }
+
+    bool Reserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) { return Inner.Reserve( Token, Count, OutReservation ); }
+    bool TryReserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) { return Inner.TryReserve( Token, Count, OutReservation ); }
+
+    void Commit( const ProducerToken& Token, const Reservation& InReservation ) {
+        Inner.Commit( Token, InReservation );
+        Notify( InReservation.Count != 0 );
+    }
+
+    void Cancel( const ProducerToken& Token, const Reservation& InReservation ) noexcept { Inner.Cancel( Token, InReservation ); }
+
+    template <class U>
+    bool TryDequeue( U& Element ) requires std::assignable_from<decltype( Element ), T&&> {
+        return Inner.TryDequeue( Element );
+    }
+
+    template <class U>
+    bool TryDequeue( ConsumerToken& Token, U& Element ) requires std::assignable_from<decltype( Element ), T&&> {
+        return Inner.TryDequeue( Token, Element );
+    }
+
+    template <std::output_iterator<T&&> Iterator>
+    std::size_t TryDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        return Inner.TryDequeueBulk( ItemFirst, MaxCount );
+    }
+
+    template <std::output_iterator<T&&> Iterator>
+    std::size_t TryDequeueBulk( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
+        return Inner.TryDequeueBulk( Token, ItemFirst, MaxCount );
+    }
+
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept { return Inner.SizeApprox(); }
+
+    HAKLE_NODISCARD std::vector<ProducerDepth> GetProducerDepths() const { return Inner.GetProducerDepths(); }
+
+private:
+    bool Notify( bool Enqueued ) {
+        if ( Enqueued ) {
+            // pairs with the fence in Park: either we see the new waiter, or it sees our element
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if ( Waiters != nullptr && !Waiters->Empty() ) {
+                Dispatch();
+            }
+        }
+        return Enqueued;
+    }
+
+    // false if the waiter got its elements here and should not suspend at all. it is never resumed from
+    // inside its own await_suspend: a consumer that keeps racing producers would nest one frame per element.
+    // when true the waiter may already be resumed and its frame gone, so nothing here touches it again
+    bool Park( details::AsyncWaiter* Waiter ) {
+        assert( Waiters != nullptr && "awaiting a moved-from AsyncConcurrentQueue" );
+        Waiters->Push( Waiter, Waiter );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( Inner.SizeApprox() != 0 ) {
+            return !Dispatch( Waiter );
+        }
+        return true;
+    }
+
+    // resumes every waiter that got elements except Self, returns whether Self got any
+    bool Dispatch( const details::AsyncWaiter* Self = nullptr ) {
+        bool SelfReady = false;
+        for ( ;; ) {
+            details::AsyncWaiter* Waiter = Waiters->TakeAll();
+            if ( Waiter == nullptr ) {
+                return SelfReady;
+            }
+
+            details::AsyncWaiter* ReadyFirst   = nullptr;
+            details::AsyncWaiter* ReadyLast    = nullptr;
+            details::AsyncWaiter* PendingFirst = nullptr;
+            details::AsyncWaiter* PendingLast  = nullptr;
+            bool                  Drained      = false;
+            while ( Waiter != nullptr ) {
+                details::AsyncWaiter* Next = Waiter->Next;
+                Waiter->Next               = nullptr;
+                if ( !Drained && Waiter->TryTake( *Waiter ) ) {
+                    ( ReadyLast != nullptr ? ReadyLast->Next : ReadyFirst ) = Waiter;
+                    ReadyLast                                                = Waiter;
+                }
+                else {
+                    Drained                                                      = true;
+                    ( PendingLast != nullptr ? PendingLast->Next : PendingFirst ) = Waiter;
+                    PendingLast                                                   = Waiter;
+                }
+                Waiter = Next;
+            }
+
+            if ( PendingFirst != nullptr ) {
+                Waiters->Push( PendingFirst, PendingLast );
+            }
+
+            // a resumed waiter may destroy its frame right away, so read Next before posting it
+            while ( ReadyFirst != nullptr ) {
+                details::AsyncWaiter* Next = ReadyFirst->Next;
+                if ( ReadyFirst == Self ) {
+                    SelfReady = true;
+                }
+                else {
+                    ReadyFirst->Resume();
+                }
+                ReadyFirst = Next;
+            }
+
+            if ( PendingFirst == nullptr ) {
+                return SelfReady;
+            }
+            // an enqueue that raced with us saw an empty list, so look again before leaving the waiters parked
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if ( Inner.SizeApprox() == 0 ) {
+                return SelfReady;
+            }
+        }
+    }
+
+    template <class Executor>
+    static void BindExecutor( details::AsyncWaiter& Waiter, Executor& InExecutor ) noexcept {
+        Waiter.Executor = std::addressof( InExecutor );
+        Waiter.Post     = []( void* Target, std::coroutine_handle<> Handle ) { static_cast<Executor*>( Target )->Post( Handle ); };
+    }
+
+    InnerQueue                                Inner;
+    std::unique_ptr<details::AsyncWaiterList> Waiters;
+};
+
+template <class T, class Allocator, IsConcurrentQueueTraits Traits>
+class AsyncConcurrentQueue<T, Allocator, Traits>::DequeueAwaiter : private details::AsyncWaiter {
+public:
+    explicit DequeueAwaiter( AsyncConcurrentQueue& InQueue, ConsumerToken* InToken = nullptr ) noexcept : Queue( &InQueue ), Token( InToken ) { TryTake = &Take; }
+
+    template <IsAsyncExecutor Executor>
+    DequeueAwaiter( AsyncConcurrentQueue& InQueue, ConsumerToken* InToken, Executor& InExecutor ) noexcept : DequeueAwaiter( InQueue, InToken ) {
+        BindExecutor( *this, InExecutor );
+    }
+
+    bool await_ready() { return Take( *this ); }
+
+    bool await_suspend( std::coroutine_handle<> InHandle ) {
+        Handle                     = InHandle;
+        AsyncConcurrentQueue* Owner = Queue;
+        return Owner->Park( this );
+    }
+
+    T await_resume() { return std::move( *Element ); }
+
+private:
+    static bool Take( details::AsyncWaiter& Waiter ) {
+        DequeueAwaiter& Self = static_cast<DequeueAwaiter&>( Waiter );
+        return Self.Token != nullptr ? Self.Queue->Inner.TryDequeue( *Self.Token, Self.Element ) : Self.Queue->Inner.TryDequeue( Self.Element );
+    }
+
+    AsyncConcurrentQueue* Queue;
+    ConsumerToken*        Token;
+    std::optional<T>      Element;
+};
+
+template <class T, class Allocator, IsConcurrentQueueTraits Traits>
+template <class Iterator>
+class AsyncConcurrentQueue<T, Allocator, Traits>::DequeueBulkAwaiter : private details::AsyncWaiter {
+public:
+    DequeueBulkAwaiter( AsyncConcurrentQueue& InQueue, ConsumerToken* InToken, Iterator InItemFirst, std::size_t InMaxCount ) noexcept
+        : Queue( &InQueue ), Token( InToken ), ItemFirst( std::move( InItemFirst ) ), MaxCount( InMaxCount ) {
+        TryTake = &Take;
+    }
+
+    template <IsAsyncExecutor Executor>
+    DequeueBulkAwaiter( AsyncConcurrentQueue& InQueue, ConsumerToken* InToken, Iterator InItemFirst, std::size_t InMaxCount, Executor& InExecutor ) noexcept
+        : DequeueBulkAwaiter( InQueue, InToken, std::move( InItemFirst ), InMaxCount ) {
+        BindExecutor( *this, InExecutor );
+    }
+
+    bool await_ready() { return MaxCount == 0 || Take( *this ); }
+
+    bool await_suspend( std::coroutine_handle<> InHandle ) {
+        Handle                     = InHandle;
+        AsyncConcurrentQueue* Owner = Queue;
+        return Owner->Park( this );
+    }
+
+    // at least one unless MaxCount was zero
+    std::size_t await_resume() noexcept { return Count; }
+
+private:
+    static bool Take( details::AsyncWaiter& Waiter ) {
+        DequeueBulkAwaiter& Self = static_cast<DequeueBulkAwaiter&>( Waiter );
+        Self.Count = Self.Token != nullptr ? Self.Queue->Inner.TryDequeueBulk( *Self.Token, Self.ItemFirst, Self.MaxCount ) : Self.Queue->Inner.TryDequeueBulk( Self.ItemFirst, Self.MaxCount );
+        return Self.Count != 0;
+    }
+
+    AsyncConcurrentQueue* Queue;
+    ConsumerToken*        Token;
+    Iterator              ItemFirst;
+    std::size_t           MaxCount;
+    std::size_t           Count{ 0 };
+};
+
+// co_await AsyncDequeue( Queue ) yields the next element. without an executor the coroutine is resumed
+// on whichever thread enqueued the element, with one it is handed to Executor.Post( Handle ).
+template <class T, class Allocator, class Traits>
+auto AsyncDequeue( AsyncConcurrentQueue<T, Allocator, Traits>& Queue ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::DequeueAwaiter( Queue );
+}
+
+template <class T, class Allocator, class Traits>
+auto AsyncDequeue( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, typename AsyncConcurrentQueue<T, Allocator, Traits>::ConsumerToken& Token ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::DequeueAwaiter( Queue, &Token );
+}
+
+template <class T, class Allocator, class Traits, IsAsyncExecutor Executor>
+auto AsyncDequeue( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, Executor& InExecutor ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::DequeueAwaiter( Queue, nullptr, InExecutor );
+}
+
+template <class T, class Allocator, class Traits, IsAsyncExecutor Executor>
+auto AsyncDequeue( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, typename AsyncConcurrentQueue<T, Allocator, Traits>::ConsumerToken& Token, Executor& InExecutor ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::DequeueAwaiter( Queue, &Token, InExecutor );
+}
+
+// co_await AsyncDequeueBulk( Queue, ItemFirst, MaxCount ) suspends until at least one element is there,
+// then takes up to MaxCount of them in one go and yields how many it wrote.
+template <class T, class Allocator, class Traits, std::output_iterator<T&&> Iterator>
+auto AsyncDequeueBulk( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, Iterator ItemFirst, std::size_t MaxCount ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::template DequeueBulkAwaiter<Iterator>( Queue, nullptr, std::move( ItemFirst ), MaxCount );
+}
+
+template <class T, class Allocator, class Traits, std::output_iterator<T&&> Iterator>
+auto AsyncDequeueBulk( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, typename AsyncConcurrentQueue<T, Allocator, Traits>::ConsumerToken& Token, Iterator ItemFirst,
+                       std::size_t MaxCount ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::template DequeueBulkAwaiter<Iterator>( Queue, &Token, std::move( ItemFirst ), MaxCount );
+}
+
+template <class T, class Allocator, class Traits, std::output_iterator<T&&> Iterator, IsAsyncExecutor Executor>
+auto AsyncDequeueBulk( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, Iterator ItemFirst, std::size_t MaxCount, Executor& InExecutor ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::template DequeueBulkAwaiter<Iterator>( Queue, nullptr, std::move( ItemFirst ), MaxCount, InExecutor );
+}
+
+template <class T, class Allocator, class Traits, std::output_iterator<T&&> Iterator, IsAsyncExecutor Executor>
+auto AsyncDequeueBulk( AsyncConcurrentQueue<T, Allocator, Traits>& Queue, typename AsyncConcurrentQueue<T, Allocator, Traits>::ConsumerToken& Token, Iterator ItemFirst,
+                       std::size_t MaxCount, Executor& InExecutor ) {
+    return typename AsyncConcurrentQueue<T, Allocator, Traits>::template DequeueBulkAwaiter<Iterator>( Queue, &Token, std::move( ItemFirst ), MaxCount, InExecutor );
+}
+
+}  // namespace hakle
+
+#endif  // HAKLE_CPP_VERSION >= 20
+
+#endif  // ASYNCCONCURRENTQUEUE_H
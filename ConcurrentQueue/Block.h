@@ -8,6 +8,7 @@
 #include <array>
 #include <atomic>
 #include <bit>
+#include <cstdint>
 #if defined( ENABLE_MEMORY_LEAK_DETECTION )
 #include <cstdio>
 #endif
@@ -59,6 +60,16 @@ using HakleFlagsBlock = HakleBlock<T, BLOCK_SIZE, FlagsCheckPolicy<BLOCK_SIZE>>;
 template <class T, std::size_t BLOCK_SIZE>
 using HakleCounterBlock = HakleBlock<T, BLOCK_SIZE, CounterCheckPolicy<BLOCK_SIZE>>;
 
+template <class Policy, std::size_t BLOCK_SIZE>
+struct TimestampedPolicy;
+
+// blocks of a SojournTiming queue, the plain ones above keep their layout
+template <class T, std::size_t BLOCK_SIZE>
+using HakleTimestampedFlagsBlock = HakleBlock<T, BLOCK_SIZE, TimestampedPolicy<FlagsCheckPolicy<BLOCK_SIZE>, BLOCK_SIZE>>;
+
+template <class T, std::size_t BLOCK_SIZE>
+using HakleTimestampedCounterBlock = HakleBlock<T, BLOCK_SIZE, TimestampedPolicy<CounterCheckPolicy<BLOCK_SIZE>, BLOCK_SIZE>>;
+
 // TODO: memory_order!!!
 template <std::size_t BLOCK_SIZE>
 struct FlagsCheckPolicy {
@@ -153,6 +164,13 @@ struct CounterCheckPolicy {
     std::atomic<std::size_t> Counter;
 };
 
+// Policy plus the enqueue time of every slot, written by the producer before it publishes the slot
+// and read by the consumer that claimed it, see SojournTiming in ConcurrentQueueDefaultTraits
+template <class Policy, std::size_t BLOCK_SIZE>
+struct TimestampedPolicy : Policy {
+    std::array<std::uint64_t, BLOCK_SIZE> Stamps{};
+};
+
 enum class BlockMethod { Flags, Counter };
 
 template <class T, std::size_t BLOCK_SIZE, HAKLE_CONCEPT( IsPolicy ) Policy>
@@ -118,7 +118,7 @@ public:
     }
 
     constexpr Node* TryGet() noexcept {
-        Node* CurrentHead = Head().load( std::memory_order_relaxed );
+        Node* CurrentHead = Head().load( std::memory_order_acquire );
         while ( CurrentHead != nullptr ) {
             Node*    PrevHead = CurrentHead;
             uint32_t Refs     = CurrentHead->FreeListRefs.load( std::memory_order_relaxed );
@@ -126,13 +126,13 @@ public:
                  || ( !CurrentHead->FreeListRefs.compare_exchange_strong( Refs, Refs + 1, std::memory_order_acquire,
                                                                           std::memory_order_relaxed ) ) )  // try add refs
             {
-                CurrentHead = Head().load( std::memory_order_relaxed );
+                CurrentHead = Head().load( std::memory_order_acquire );
                 continue;
             }
 
             // try Taken
             Node* Next = CurrentHead->FreeListNext.load( std::memory_order_relaxed );
-            if ( Head().compare_exchange_strong( CurrentHead, Next, std::memory_order_relaxed, std::memory_order_relaxed ) ) {
+            if ( Head().compare_exchange_strong( CurrentHead, Next, std::memory_order_acquire, std::memory_order_acquire ) ) {
                 // taken success, decrease refcount twice, for our and list's ref
                 CurrentHead->FreeListRefs.fetch_add( -2, std::memory_order_relaxed );
                 return CurrentHead;
@@ -160,7 +160,8 @@ private:
             // first update next then refs
             InNode->FreeListNext.store( CurrentHead, std::memory_order_relaxed );
             InNode->FreeListRefs.store( 1, std::memory_order_release );
-            if ( !Head().compare_exchange_strong( CurrentHead, InNode, std::memory_order_relaxed, std::memory_order_relaxed ) ) {
+            // release so that whoever takes the node also sees what was written to it before it was returned
+            if ( !Head().compare_exchange_strong( CurrentHead, InNode, std::memory_order_release, std::memory_order_relaxed ) ) {
                 // check if someone already using it
                 if ( InNode->FreeListRefs.fetch_add( AddFlag - 1, std::memory_order_release ) == 1 ) {
                     continue;
@@ -294,8 +295,14 @@ public:
     constexpr explicit HakleBlockManager( std::size_t InSize, const AllocatorType& InAllocator = AllocatorType{} ) : BaseManager( InAllocator ), Pool( InSize, InAllocator ), List( InAllocator ) {}
     HAKLE_CPP20_CONSTEXPR ~HakleBlockManager() override = default;
 
-    constexpr HakleBlockManager( HakleBlockManager&& Other ) noexcept            = default;
-    constexpr HakleBlockManager& operator=( HakleBlockManager&& Other ) noexcept = default;
+    constexpr HakleBlockManager( HakleBlockManager&& Other ) noexcept = default;
+    constexpr HakleBlockManager& operator=( HakleBlockManager&& Other ) noexcept {
+        // the free list may still link pool blocks, so it has to be cleared before the pool frees them
+        List              = std::move( Other.List );
+        Pool              = std::move( Other.Pool );
+        this->Allocator() = std::move( Other.Allocator() );
+        return *this;
+    }
 
     constexpr HakleBlockManager( const HakleBlockManager& Other )            = delete;
     constexpr HakleBlockManager& operator=( const HakleBlockManager& Other ) = delete;
@@ -345,6 +352,12 @@ using HakleFlagsBlockManager = HakleBlockManager<HakleFlagsBlock<T, BLOCK_SIZE>>
 template <class T, std::size_t BLOCK_SIZE, HAKLE_CONCEPT( IsAllocator ) ALLOCATOR_TYPE = HakleAllocator<HakleCounterBlock<T, BLOCK_SIZE>>>
 using HakleCounterBlockManager = HakleBlockManager<HakleCounterBlock<T, BLOCK_SIZE>>;
 
+template <class T, std::size_t BLOCK_SIZE, HAKLE_CONCEPT( IsAllocator ) ALLOCATOR_TYPE = HakleAllocator<HakleTimestampedFlagsBlock<T, BLOCK_SIZE>>>
+using HakleTimestampedFlagsBlockManager = HakleBlockManager<HakleTimestampedFlagsBlock<T, BLOCK_SIZE>, ALLOCATOR_TYPE>;
+
+template <class T, std::size_t BLOCK_SIZE, HAKLE_CONCEPT( IsAllocator ) ALLOCATOR_TYPE = HakleAllocator<HakleTimestampedCounterBlock<T, BLOCK_SIZE>>>
+using HakleTimestampedCounterBlockManager = HakleBlockManager<HakleTimestampedCounterBlock<T, BLOCK_SIZE>, ALLOCATOR_TYPE>;
+
 }  // namespace hakle
 
 #endif  // BLOCKMANAGER_H
@@ -0,0 +1,326 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef BLOCKINGCONCURRENTQUEUE_H
+#define BLOCKINGCONCURRENTQUEUE_H
+
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentQueue/ConcurrentQueue.h"
+#include "ReaderWriterQueue/readerwriterqueue.h"
+#include "common/common.h"
+
+namespace hakle {
+
+// MPMC queue with blocking dequeue, built on ConcurrentQueue and LightWeightSemaphore.
+// every enqueued element publishes one permit, a consumer owns an element as soon as it owns a permit.
+// timeouts are in milliseconds, a negative timeout waits forever.
+template <class T, class Allocator = HakleAllocator<T>, HAKLE_CONCEPT( IsConcurrentQueueTraits ) Traits = ConcurrentQueueDefaultTraits<T, Allocator>>
+class BlockingConcurrentQueue {
+private:
+    using InnerQueue    = ConcurrentQueue<T, Allocator, Traits>;
+    using signed_size_t = LightWeightSemaphore::signed_size_t;
+
+public:
+    using ProducerToken = typename InnerQueue::ProducerToken;
+    using ConsumerToken = typename InnerQueue::ConsumerToken;
+    using ProducerDepth = typename InnerQueue::ProducerDepth;
+    using Reservation   = typename InnerQueue::Reservation;
+    using AllocatorType = typename InnerQueue::AllocatorType;
+
+    explicit BlockingConcurrentQueue( const AllocatorType& InAllocator = AllocatorType{} ) : Inner( InAllocator ), Sem( std::make_unique<LightWeightSemaphore>() ) {}
+
+    ~BlockingConcurrentQueue() = default;
+
+    BlockingConcurrentQueue( BlockingConcurrentQueue&& Other ) noexcept            = default;
+    BlockingConcurrentQueue& operator=( BlockingConcurrentQueue&& Other ) noexcept = default;
+
+    BlockingConcurrentQueue( const BlockingConcurrentQueue& )            = delete;
+    BlockingConcurrentQueue& operator=( const BlockingConcurrentQueue& ) = delete;
+
+    void swap( BlockingConcurrentQueue& Other ) noexcept {
+        Inner.swap( Other.Inner );
+        Sem.swap( Other.Sem );
+    }
+
+    ProducerToken GetProducerToken() noexcept { return Inner.GetProducerToken(); }
+    ConsumerToken GetConsumerToken() noexcept { return Inner.GetConsumerToken(); }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool Enqueue( Args&&... args ) {
+        if ( Inner.Enqueue( std::forward<Args>( args )... ) ) {
+            Sem->Signal();
+            return true;
+        }
+        return false;
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool EnqueueWithToken( const ProducerToken& Token, Args&&... args ) {
+        if ( Inner.EnqueueWithToken( Token, std::forward<Args>( args )... ) ) {
+            Sem->Signal();
+            return true;
+        }
+        return false;
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool EnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        if ( Inner.EnqueueBulk( std::move( ItemFirst ), Count ) ) {
+            SignalMany( Count );
+            return true;
+        }
+        return false;
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool EnqueueBulk( const ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        if ( Inner.EnqueueBulk( Token, std::move( ItemFirst ), Count ) ) {
+            SignalMany( Count );
+            return true;
+        }
+        return false;
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool TryEnqueue( Args&&... args ) {
+        if ( Inner.TryEnqueue( std::forward<Args>( args )... ) ) {
+            Sem->Signal();
+            return true;
+        }
+        return false;
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool TryEnqueue( const ProducerToken& Token, Args&&... args ) {
+        if ( Inner.TryEnqueue( Token, std::forward<Args>( args )... ) ) {
+            Sem->Signal();
+            return true;
+        }
+        return false;
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool TryEnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        if ( Inner.TryEnqueueBulk( std::move( ItemFirst ), Count ) ) {
+            SignalMany( Count );
+            return true;
+        }
+        return false;
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool TryEnqueueBulk( const ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        if ( Inner.TryEnqueueBulk( Token, std::move( ItemFirst ), Count ) ) {
+            SignalMany( Count );
+            return true;
+        }
+        return false;
+    }
+
+    bool Reserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) { return Inner.Reserve( Token, Count, OutReservation ); }
+    bool TryReserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) { return Inner.TryReserve( Token, Count, OutReservation ); }
+
+    void Commit( const ProducerToken& Token, const Reservation& InReservation ) {
+        Inner.Commit( Token, InReservation );
+        SignalMany( InReservation.Count );
+    }
+
+    void Cancel( const ProducerToken& Token, const Reservation& InReservation ) noexcept { Inner.Cancel( Token, InReservation ); }
+
+    template <class U>
+    bool TryDequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        if ( Sem->TryWait() ) {
+            DequeueOwned( Element );
+            return true;
+        }
+        return false;
+    }
+
+    template <class U>
+    bool TryDequeue( ConsumerToken& Token, U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        if ( Sem->TryWait() ) {
+            DequeueOwned( Token, Element );
+            return true;
+        }
+        return false;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t TryDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        std::size_t Count = static_cast<std::size_t>( Sem->TryWaitMany( ToSigned( MaxCount ) ) );
+        DequeueBulkOwned( ItemFirst, Count );
+        return Count;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t TryDequeueBulk( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
+        std::size_t Count = static_cast<std::size_t>( Sem->TryWaitMany( ToSigned( MaxCount ) ) );
+        DequeueBulkOwned( Token, ItemFirst, Count );
+        return Count;
+    }
+
+    template <class U>
+    void WaitDequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        while ( !Sem->Wait() ) {
+        }
+        DequeueOwned( Element );
+    }
+
+    template <class U>
+    void WaitDequeue( ConsumerToken& Token, U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        while ( !Sem->Wait() ) {
+        }
+        DequeueOwned( Token, Element );
+    }
+
+    template <class U>
+    bool WaitDequeueTimed( U& Element, std::int64_t Timeout ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        if ( !Sem->Wait( Timeout ) ) {
+            return false;
+        }
+        DequeueOwned( Element );
+        return true;
+    }
+
+    template <class U>
+    bool WaitDequeueTimed( ConsumerToken& Token, U& Element, std::int64_t Timeout ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        if ( !Sem->Wait( Timeout ) ) {
+            return false;
+        }
+        DequeueOwned( Token, Element );
+        return true;
+    }
+
+    template <class U, class Rep, class Period>
+    bool WaitDequeueTimed( U& Element, const std::chrono::duration<Rep, Period>& Timeout ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        return WaitDequeueTimed( Element, ToMilliseconds( Timeout ) );
+    }
+
+    template <class U, class Rep, class Period>
+    bool WaitDequeueTimed( ConsumerToken& Token, U& Element, const std::chrono::duration<Rep, Period>& Timeout ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        return WaitDequeueTimed( Token, Element, ToMilliseconds( Timeout ) );
+    }
+
+    // blocks until at least one element is available, then takes up to MaxCount with a single wake-up
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t WaitDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        std::size_t Count = 0;
+        while ( Count == 0 && MaxCount != 0 ) {
+            Count = static_cast<std::size_t>( Sem->WaitMany( ToSigned( MaxCount ) ) );
+        }
+        DequeueBulkOwned( ItemFirst, Count );
+        return Count;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t WaitDequeueBulk( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
+        std::size_t Count = 0;
+        while ( Count == 0 && MaxCount != 0 ) {
+            Count = static_cast<std::size_t>( Sem->WaitMany( ToSigned( MaxCount ) ) );
+        }
+        DequeueBulkOwned( Token, ItemFirst, Count );
+        return Count;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t WaitDequeueBulkTimed( Iterator ItemFirst, std::size_t MaxCount, std::int64_t Timeout ) {
+        std::size_t Count = static_cast<std::size_t>( Sem->WaitMany( ToSigned( MaxCount ), Timeout ) );
+        DequeueBulkOwned( ItemFirst, Count );
+        return Count;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t WaitDequeueBulkTimed( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount, std::int64_t Timeout ) {
+        std::size_t Count = static_cast<std::size_t>( Sem->WaitMany( ToSigned( MaxCount ), Timeout ) );
+        DequeueBulkOwned( Token, ItemFirst, Count );
+        return Count;
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator, class Rep, class Period>
+    std::size_t WaitDequeueBulkTimed( Iterator ItemFirst, std::size_t MaxCount, const std::chrono::duration<Rep, Period>& Timeout ) {
+        return WaitDequeueBulkTimed( ItemFirst, MaxCount, ToMilliseconds( Timeout ) );
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator, class Rep, class Period>
+    std::size_t WaitDequeueBulkTimed( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount, const std::chrono::duration<Rep, Period>& Timeout ) {
+        return WaitDequeueBulkTimed( Token, ItemFirst, MaxCount, ToMilliseconds( Timeout ) );
+    }
+
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept { return Sem->Available(); }
+
+    HAKLE_NODISCARD std::vector<ProducerDepth> GetProducerDepths() const { return Inner.GetProducerDepths(); }
+
+private:
+    // the caller owns a permit, so an element is guaranteed to show up in the inner queue
+    template <class U>
+    void DequeueOwned( U& Element ) {
+        while ( !Inner.TryDequeue( Element ) ) {
+        }
+    }
+
+    template <class U>
+    void DequeueOwned( ConsumerToken& Token, U& Element ) {
+        while ( !Inner.TryDequeue( Token, Element ) ) {
+        }
+    }
+
+    template <class Iterator>
+    void DequeueBulkOwned( Iterator ItemFirst, std::size_t Count ) {
+        std::size_t Dequeued = 0;
+        while ( Dequeued != Count ) {
+            Dequeued += Inner.TryDequeueBulk( std::next( ItemFirst, Dequeued ), Count - Dequeued );
+        }
+    }
+
+    template <class Iterator>
+    void DequeueBulkOwned( ConsumerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        std::size_t Dequeued = 0;
+        while ( Dequeued != Count ) {
+            Dequeued += Inner.TryDequeueBulk( Token, std::next( ItemFirst, Dequeued ), Count - Dequeued );
+        }
+    }
+
+    void SignalMany( std::size_t Count ) {
+        if ( Count != 0 ) {
+            Sem->Signal( ToSigned( Count ) );
+        }
+    }
+
+    static constexpr signed_size_t ToSigned( std::size_t Value ) noexcept {
+        constexpr std::size_t Max = static_cast<std::size_t>( std::numeric_limits<signed_size_t>::max() );
+        return static_cast<signed_size_t>( Value > Max ? Max : Value );
+    }
+
+    template <class Rep, class Period>
+    static std::int64_t ToMilliseconds( const std::chrono::duration<Rep, Period>& Timeout ) noexcept {
+        if ( Timeout < Timeout.zero() ) {
+            return -1;
+        }
+        return static_cast<std::int64_t>( std::chrono::ceil<std::chrono::milliseconds>( Timeout ).count() );
+    }
+
+    InnerQueue                            Inner;
+    std::unique_ptr<LightWeightSemaphore> Sem;
+};
+
+}  // namespace hakle
+
+#endif  // BLOCKINGCONCURRENTQUEUE_H
@@ -0,0 +1,446 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef CONCURRENTBYTEQUEUE_H
+#define CONCURRENTBYTEQUEUE_H
+
+#include "common/common.h"
+
+#if HAKLE_CPP_VERSION >= 20
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <utility>
+
+#include "ConcurrentQueue/Block.h"
+#include "ConcurrentQueue/BlockManager.h"
+#include "ConcurrentQueue/ProducerIndex.h"
+#include "common/allocator.h"
+#include "common/memory.h"
+
+namespace hakle {
+
+// MPMC queue of variable-length byte records, written straight into HakleBlock storage.
+// Every record is a 4-byte length followed by its payload, padded to 4 bytes, and records are packed back to back,
+// so a record may run across several blocks. Blocks come from a HakleBlockManager and go back to it once every
+// byte in them was released, so after warm-up neither side touches the allocator.
+// Each ProducerToken owns one byte stream; streams sit in a ProducerRegistry and a dropped token's stream waits in
+// a free list for the next GetProducerToken, so neither needs a walk over every stream. Consumers claim whole records from a stream and read them in place
+// through ByteRecord, which hands out spans into the blocks and releases the bytes when it is dropped.
+// NOTE: records of one producer come out in order, records of different producers are not ordered.
+template <std::size_t BLOCK_BYTES = 4096, HAKLE_CONCEPT( IsAllocator ) Allocator = HakleAllocator<HakleCounterBlock<std::byte, BLOCK_BYTES>>>
+class ConcurrentByteQueue {
+public:
+    using BlockType        = HakleCounterBlock<std::byte, BLOCK_BYTES>;
+    using BlockManagerType = HakleBlockManager<BlockType, Allocator>;
+    using AllocatorType    = Allocator;
+    using AllocMode        = typename BlockManagerType::AllocMode;
+
+    static constexpr std::size_t BlockBytes    = BLOCK_BYTES;
+    static constexpr std::size_t MaxRecordSize = std::numeric_limits<std::uint32_t>::max() - 3;
+
+private:
+    static constexpr std::size_t HeaderSize = sizeof( std::uint32_t );
+    // the last bytes of a block are never written: they stand for the stream head, which releases them once it has
+    // moved past the block, so a block the head still points into can not be recycled under it
+    static constexpr std::size_t PinSize     = HeaderSize;
+    static constexpr std::size_t UsableBytes = BLOCK_BYTES - PinSize;
+    // set in a stream head while one consumer is claiming a record, offsets are always multiples of 4
+    static constexpr std::uint64_t ClaimBit = 1;
+
+    static_assert( BLOCK_BYTES >= 64, "BLOCK_BYTES is too small for records" );
+
+    static constexpr std::uint64_t RecordBytes( std::size_t Length ) noexcept { return HeaderSize + ( ( static_cast<std::uint64_t>( Length ) + 3 ) & ~std::uint64_t{ 3 } ); }
+
+    // one producer's byte stream, offsets count usable bytes only.
+    // FreeListNode links it into InactiveStreams while it waits for a new token
+    struct ByteStream : FreeListNode<ByteStream> {
+        // consumer side, HeadBlock and HeadBase are only touched while holding ClaimBit
+        std::atomic<std::uint64_t> Head{ 0 };
+        BlockType*                 HeadBlock{ nullptr };
+        std::uint64_t              HeadBase{ 0 };
+
+        // producer side
+        alignas( HAKLE_CACHE_LINE_SIZE ) std::atomic<std::uint64_t> Tail{ 0 };
+        BlockType*    FirstBlock{ nullptr };
+        BlockType*    TailBlock{ nullptr };
+        std::uint64_t TailBase{ 0 };
+        BlockType*    LastBlock{ nullptr };
+        std::uint64_t Capacity{ 0 };
+
+        ConcurrentByteQueue* Parent{ nullptr };
+        std::uint32_t        RegistrySlot{ 0 };
+
+        explicit ByteStream( ConcurrentByteQueue* InParent ) noexcept : Parent( InParent ) {
+            // the queue frees its streams, the free list only borrows them
+            this->HasOwner = true;
+        }
+    };
+
+    using StreamAllocatorType   = typename HakeAllocatorTraits<AllocatorType>::template RebindAlloc<ByteStream>;
+    using StreamAllocatorTraits = HakeAllocatorTraits<StreamAllocatorType>;
+    using StreamFreeList        = FreeList<ByteStream, StreamAllocatorType>;
+
+public:
+    class ProducerToken {
+    public:
+        ProducerToken() = default;
+        ~ProducerToken() {
+            if ( Stream != nullptr ) {
+                Stream->Parent->InactiveStreams.Add( Stream );
+            }
+        }
+
+        ProducerToken( ProducerToken&& Other ) noexcept : Stream( std::exchange( Other.Stream, nullptr ) ) {}
+        ProducerToken& operator=( ProducerToken&& Other ) noexcept {
+            std::swap( Stream, Other.Stream );
+            return *this;
+        }
+
+        ProducerToken( const ProducerToken& )            = delete;
+        ProducerToken& operator=( const ProducerToken& ) = delete;
+
+        HAKLE_NODISCARD bool Valid() const noexcept { return Stream != nullptr; }
+
+    private:
+        friend class ConcurrentByteQueue;
+        explicit ProducerToken( ByteStream* InStream ) noexcept : Stream( InStream ) {}
+
+        ByteStream* Stream{ nullptr };
+    };
+
+    // a claimed record, read in place; its bytes go back to the queue on Release or destruction
+    class ByteRecord {
+    public:
+        ByteRecord() = default;
+        ~ByteRecord() { Release(); }
+
+        ByteRecord( ByteRecord&& Other ) noexcept
+            : Owner( std::exchange( Other.Owner, nullptr ) ), Block( Other.Block ), Index( Other.Index ), Length( Other.Length ) {}
+        ByteRecord& operator=( ByteRecord&& Other ) noexcept {
+            if ( this != &Other ) {
+                Release();
+                Owner  = std::exchange( Other.Owner, nullptr );
+                Block  = Other.Block;
+                Index  = Other.Index;
+                Length = Other.Length;
+            }
+            return *this;
+        }
+
+        ByteRecord( const ByteRecord& )            = delete;
+        ByteRecord& operator=( const ByteRecord& ) = delete;
+
+        HAKLE_NODISCARD explicit operator bool() const noexcept { return Owner != nullptr; }
+        HAKLE_NODISCARD std::size_t Size() const noexcept { return Length; }
+
+        // true when the payload sits in a single block, which is always the case for a payload that fits in the
+        // rest of the block the record starts in
+        HAKLE_NODISCARD bool IsContiguous() const noexcept {
+            std::size_t Start = Index + HeaderSize;
+            return Start == UsableBytes ? Length <= UsableBytes : Start + Length <= UsableBytes;
+        }
+
+        // the payload, only for contiguous records
+        HAKLE_NODISCARD std::span<const std::byte> Span() const noexcept {
+            assert( IsContiguous() );
+            std::span<const std::byte> Result;
+            ForEachSpan( [ &Result ]( std::span<const std::byte> Part ) { Result = Part; } );
+            return Result;
+        }
+
+        // calls Func with every piece of the payload, in order
+        template <class Func>
+        void ForEachSpan( Func&& InFunc ) const {
+            BlockType*  Current = Block;
+            std::size_t Offset  = Index + HeaderSize;
+            std::size_t Left    = Length;
+            while ( Left != 0 ) {
+                if ( Offset == UsableBytes ) {
+                    Current = Current->Next;
+                    Offset  = 0;
+                }
+                std::size_t Count = std::min( Left, UsableBytes - Offset );
+                InFunc( std::span<const std::byte>( ( *Current )[ Offset ], Count ) );
+                Offset += Count;
+                Left -= Count;
+            }
+        }
+
+        // returns the number of bytes copied
+        std::size_t CopyTo( std::span<std::byte> Out ) const {
+            std::size_t Copied = 0;
+            ForEachSpan( [ & ]( std::span<const std::byte> Part ) {
+                std::size_t Count = std::min( Part.size(), Out.size() - Copied );
+                std::memcpy( Out.data() + Copied, Part.data(), Count );
+                Copied += Count;
+            } );
+            return Copied;
+        }
+
+        void Release() noexcept {
+            if ( Owner == nullptr ) {
+                return;
+            }
+            BlockType*    Current = Block;
+            std::size_t   Offset  = Index;
+            std::uint64_t Left    = RecordBytes( Length );
+            for ( ;; ) {
+                std::size_t Count = static_cast<std::size_t>( std::min<std::uint64_t>( Left, UsableBytes - Offset ) );
+                Left -= Count;
+                // the next block may be recycled as soon as the current one is, and it only exists if we go on
+                BlockType* Next = Left != 0 ? Current->Next : nullptr;
+                if ( Current->SetSomeEmpty( Offset, Count ) ) {
+                    Owner->Recycle( Current );
+                }
+                if ( Left == 0 ) {
+                    break;
+                }
+                Current = Next;
+                Offset  = 0;
+            }
+            Owner = nullptr;
+        }
+
+    private:
+        friend class ConcurrentByteQueue;
+
+        ConcurrentByteQueue* Owner{ nullptr };
+        BlockType*           Block{ nullptr };
+        // where the header is in Block
+        std::size_t Index{ 0 };
+        std::size_t Length{ 0 };
+    };
+
+    explicit ConcurrentByteQueue( std::size_t InitialBlockCount = 32, const AllocatorType& InAllocator = AllocatorType{} )
+        : Manager( InitialBlockCount, InAllocator ), StreamAllocator( InAllocator ), Registry( StreamAllocator ), InactiveStreams( StreamAllocator ) {}
+
+    // NOTE: every ByteRecord and ProducerToken must be gone by now
+    ~ConcurrentByteQueue() {
+        // the free list only links streams, forget them before the streams go away
+        InactiveStreams = StreamFreeList{};
+        for ( std::size_t Slot = 0, Count = Registry.Size(); Slot < Count; ++Slot ) {
+            ByteStream* Current = Registry.At( Slot );
+            if ( Current == nullptr ) {
+                continue;
+            }
+            // blocks before the head block went back to the manager when their last byte was released
+            BlockType* Block = Current->HeadBlock != nullptr ? Current->HeadBlock : Current->FirstBlock;
+            while ( Block != nullptr ) {
+                BlockType* NextBlock = Block->Next;
+                Manager.ReturnBlock( Block );
+                Block = NextBlock;
+            }
+            StreamAllocatorTraits::Destroy( StreamAllocator, Current );
+            StreamAllocatorTraits::Deallocate( StreamAllocator, Current );
+        }
+    }
+
+    ConcurrentByteQueue( const ConcurrentByteQueue& )            = delete;
+    ConcurrentByteQueue& operator=( const ConcurrentByteQueue& ) = delete;
+
+    // O(1): reuses the stream of a dropped token when there is one, otherwise registers a new stream.
+    // the token is not Valid when no stream could be allocated
+    ProducerToken GetProducerToken() {
+        // the pop acquires whatever the previous token wrote into the stream
+        if ( ByteStream* Recycled = InactiveStreams.TryGet(); Recycled != nullptr ) {
+            return ProducerToken( Recycled );
+        }
+
+        ByteStream* NewStream = StreamAllocatorTraits::Allocate( StreamAllocator );
+        if ( NewStream == nullptr ) {
+            return ProducerToken();
+        }
+        StreamAllocatorTraits::Construct( StreamAllocator, NewStream, this );
+        if ( !Registry.Add( NewStream, NewStream->RegistrySlot ) ) {
+            StreamAllocatorTraits::Destroy( StreamAllocator, NewStream );
+            StreamAllocatorTraits::Deallocate( StreamAllocator, NewStream );
+            return ProducerToken();
+        }
+        return ProducerToken( NewStream );
+    }
+
+    bool Enqueue( ProducerToken& Token, std::span<const std::byte> Record ) { return InnerEnqueue<AllocMode::CanAlloc>( Token, Record ); }
+    bool Enqueue( ProducerToken& Token, const void* Data, std::size_t Size ) { return Enqueue( Token, { static_cast<const std::byte*>( Data ), Size } ); }
+
+    // only uses blocks the manager already has
+    bool TryEnqueue( ProducerToken& Token, std::span<const std::byte> Record ) { return InnerEnqueue<AllocMode::CannotAlloc>( Token, Record ); }
+    bool TryEnqueue( ProducerToken& Token, const void* Data, std::size_t Size ) { return TryEnqueue( Token, { static_cast<const std::byte*>( Data ), Size } ); }
+
+    // releases whatever Out held, then claims the next record of some producer.
+    // may fail spuriously while another consumer is claiming from the only non-empty stream
+    bool TryDequeue( ByteRecord& Out ) {
+        Out.Release();
+        std::size_t Count = Registry.Size();
+        if ( Count == 0 ) {
+            return false;
+        }
+        // start somewhere else every time so that no producer is always served first
+        std::size_t Start = Rotation.fetch_add( 1, std::memory_order_relaxed ) % Count;
+        for ( std::size_t Step = 0; Step < Count; ++Step ) {
+            std::size_t Slot = Start + Step;
+            // a slot is null while its stream is still being registered
+            ByteStream* Current = Registry.At( Slot < Count ? Slot : Slot - Count );
+            if ( Current != nullptr && TryClaim( *Current, Out ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // claims a record, hands it to Func and releases it right after
+    template <class Func>
+    bool TryConsume( Func&& InFunc ) {
+        ByteRecord Record;
+        if ( !TryDequeue( Record ) ) {
+            return false;
+        }
+        std::forward<Func>( InFunc )( static_cast<const ByteRecord&>( Record ) );
+        return true;
+    }
+
+    // unconsumed bytes including headers and padding, not exact under contention
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept {
+        std::size_t Size = 0;
+        for ( std::size_t Slot = 0, Count = Registry.Size(); Slot < Count; ++Slot ) {
+            const ByteStream* Current = Registry.At( Slot );
+            if ( Current == nullptr ) {
+                continue;
+            }
+            std::uint64_t Head = Current->Head.load( std::memory_order_relaxed ) & ~ClaimBit;
+            std::uint64_t Tail = Current->Tail.load( std::memory_order_relaxed );
+            Size += Tail > Head ? static_cast<std::size_t>( Tail - Head ) : 0;
+        }
+        return Size;
+    }
+
+private:
+    template <AllocMode Mode>
+    bool InnerEnqueue( ProducerToken& Token, std::span<const std::byte> Record ) {
+        assert( Token.Valid() );
+        if ( Record.size() > MaxRecordSize ) {
+            return false;
+        }
+        ByteStream&         Stream = *Token.Stream;
+        const std::uint64_t Tail   = Stream.Tail.load( std::memory_order_relaxed );
+        const std::uint64_t End    = Tail + RecordBytes( Record.size() );
+        // blocks appended here stay in the stream even if a later one can not be had
+        while ( Stream.Capacity < End ) {
+            if ( !AppendBlock( Stream, Mode ) ) {
+                return false;
+            }
+        }
+
+        BlockType*    Block = Stream.TailBlock != nullptr ? Stream.TailBlock : Stream.FirstBlock;
+        std::uint64_t Base  = Stream.TailBase;
+        while ( Tail >= Base + UsableBytes ) {
+            Block = Block->Next;
+            Base += UsableBytes;
+        }
+
+        // the header never straddles blocks since offsets and UsableBytes are multiples of 4
+        std::size_t         Offset = static_cast<std::size_t>( Tail - Base );
+        const std::uint32_t Length = static_cast<std::uint32_t>( Record.size() );
+        std::memcpy( ( *Block )[ Offset ], &Length, HeaderSize );
+        Offset += HeaderSize;
+
+        const std::byte* Source = Record.data();
+        std::size_t      Left   = Record.size();
+        while ( Left != 0 ) {
+            if ( Offset == UsableBytes ) {
+                Block = Block->Next;
+                Base += UsableBytes;
+                Offset = 0;
+            }
+            std::size_t Count = std::min( Left, UsableBytes - Offset );
+            std::memcpy( ( *Block )[ Offset ], Source, Count );
+            Source += Count;
+            Offset += Count;
+            Left -= Count;
+        }
+
+        Stream.TailBlock = Block;
+        Stream.TailBase  = Base;
+        Stream.Tail.store( End, std::memory_order_release );
+        return true;
+    }
+
+    bool AppendBlock( ByteStream& Stream, AllocMode Mode ) {
+        BlockType* NewBlock = Manager.RequisitionBlock( Mode );
+        if ( NewBlock == nullptr ) {
+            return false;
+        }
+        NewBlock->Reset();
+        NewBlock->Next = nullptr;
+        // published to consumers by the release store of Tail
+        if ( Stream.LastBlock != nullptr ) {
+            Stream.LastBlock->Next = NewBlock;
+        }
+        else {
+            Stream.FirstBlock = NewBlock;
+        }
+        Stream.LastBlock = NewBlock;
+        Stream.Capacity += UsableBytes;
+        return true;
+    }
+
+    bool TryClaim( ByteStream& Stream, ByteRecord& Out ) noexcept {
+        std::uint64_t Head = Stream.Head.load( std::memory_order_relaxed );
+        if ( ( Head & ClaimBit ) != 0 || Head >= Stream.Tail.load( std::memory_order_acquire ) ) {
+            return false;
+        }
+        if ( !Stream.Head.compare_exchange_strong( Head, Head | ClaimBit, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+            return false;
+        }
+
+        // the record at Head is published and unclaimed, so every block up to it is linked and still alive
+        if ( Stream.HeadBlock == nullptr ) {
+            Stream.HeadBlock = Stream.FirstBlock;
+        }
+        while ( Head >= Stream.HeadBase + UsableBytes ) {
+            BlockType* Passed = Stream.HeadBlock;
+            Stream.HeadBlock  = Passed->Next;
+            Stream.HeadBase += UsableBytes;
+            if ( Passed->SetSomeEmpty( UsableBytes, PinSize ) ) {
+                Recycle( Passed );
+            }
+        }
+
+        std::size_t   Index = static_cast<std::size_t>( Head - Stream.HeadBase );
+        std::uint32_t Length;
+        std::memcpy( &Length, ( *Stream.HeadBlock )[ Index ], HeaderSize );
+
+        Out.Owner  = this;
+        Out.Block  = Stream.HeadBlock;
+        Out.Index  = Index;
+        Out.Length = Length;
+        Stream.Head.store( Head + RecordBytes( Length ), std::memory_order_release );
+        return true;
+    }
+
+    // by whoever released the last bytes of a block. SetSomeEmpty only releases, so the acquire load of the final
+    // count is what orders every earlier reader of the block before the producer that gets it next
+    void Recycle( BlockType* Block ) noexcept {
+        HAKLE_MAYBE_UNUSED std::size_t Count = Block->Counter.load( std::memory_order_acquire );
+        Manager.ReturnBlock( Block );
+    }
+
+    BlockManagerType         Manager;
+    StreamAllocatorType      StreamAllocator;
+    ProducerRegistry<ByteStream, StreamAllocatorType> Registry;
+    StreamFreeList                                    InactiveStreams;
+    std::atomic<std::size_t>                          Rotation{ 0 };
+};
+
+}  // namespace hakle
+
+#endif
+
+#endif  // CONCURRENTBYTEQUEUE_H
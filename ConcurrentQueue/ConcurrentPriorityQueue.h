@@ -0,0 +1,314 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef CONCURRENTPRIORITYQUEUE_H
+#define CONCURRENTPRIORITYQUEUE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include "ConcurrentQueue/ConcurrentQueue.h"
+#include "common/common.h"
+
+namespace hakle {
+
+// MPMC queue with LEVELS priority levels, level 0 is the most urgent.
+// Every level is a ConcurrentQueue of its own, so it keeps its own producer set and consumer rotation;
+// on top of that a bitmap of the levels that may hold elements (conservative, like NonEmptyProducerIndex)
+// lets a consumer jump straight to the level it should serve instead of trying every level in turn.
+// Strict priority always serves the most urgent non-empty level. Weighted round-robin walks a smooth
+// schedule built from the weights and serves the first non-empty level at or below the scheduled one,
+// so bulk traffic keeps moving while control traffic gets the larger share.
+template <class T, std::size_t LEVELS, class Allocator = HakleAllocator<T>, HAKLE_CONCEPT( IsConcurrentQueueTraits ) Traits = ConcurrentQueueDefaultTraits<T, Allocator>>
+class ConcurrentPriorityQueue {
+    static_assert( LEVELS >= 1 && LEVELS <= 64, "the level bitmap is a single 64 bit word" );
+
+private:
+    using InnerQueue = ConcurrentQueue<T, Allocator, Traits>;
+
+public:
+    using AllocatorType = typename InnerQueue::AllocatorType;
+    using WeightsType   = std::array<std::uint32_t, LEVELS>;
+
+    static constexpr std::size_t LevelCount = LEVELS;
+    // longest weighted round-robin schedule, heavier weights are scaled down to fit (one byte per turn)
+    static constexpr std::size_t MaxRoundLength = std::size_t{ 1 } << 16;
+
+    // bound to one level for its whole life
+    struct ProducerToken {
+        HAKLE_NODISCARD std::size_t GetLevel() const noexcept { return Level; }
+
+    private:
+        friend class ConcurrentPriorityQueue;
+
+        ProducerToken( std::size_t InLevel, typename InnerQueue::ProducerToken&& InToken ) noexcept : Level( InLevel ), Token( std::move( InToken ) ) {}
+
+        std::size_t                        Level;
+        typename InnerQueue::ProducerToken Token;
+    };
+
+    // one inner token per level, plus this consumer's position in the round-robin schedule
+    struct ConsumerToken {
+    private:
+        friend class ConcurrentPriorityQueue;
+
+        explicit ConsumerToken( std::array<typename InnerQueue::ConsumerToken, LEVELS>&& InTokens ) noexcept : Tokens( std::move( InTokens ) ) {}
+
+        std::array<typename InnerQueue::ConsumerToken, LEVELS> Tokens;
+        std::uint32_t                                          Round{ 0 };
+    };
+
+    // strict priority
+    explicit ConcurrentPriorityQueue( const AllocatorType& InAllocator = AllocatorType{} )
+        : Queues( MakeQueues( InAllocator, std::make_index_sequence<LEVELS>{} ) ) {}
+
+    // weighted round-robin, level i gets Weights[ i ] turns per round while it has elements.
+    // the weights are reduced by their gcd first, so { 400, 200, 100 } costs the same as { 4, 2, 1 };
+    // a round that would still be longer than MaxRoundLength is scaled down, which keeps the ratios approximately
+    explicit ConcurrentPriorityQueue( const WeightsType& Weights, const AllocatorType& InAllocator = AllocatorType{} )
+        : Queues( MakeQueues( InAllocator, std::make_index_sequence<LEVELS>{} ) ), Schedule( MakeSchedule( Weights ) ) {}
+
+    // consumers hold references into the levels
+    ConcurrentPriorityQueue( const ConcurrentPriorityQueue& )            = delete;
+    ConcurrentPriorityQueue& operator=( const ConcurrentPriorityQueue& ) = delete;
+
+    HAKLE_NODISCARD bool IsWeighted() const noexcept { return !Schedule.empty(); }
+
+    // turns in one weighted round-robin round, 0 under strict priority
+    HAKLE_NODISCARD std::size_t RoundLength() const noexcept { return Schedule.size(); }
+
+    ProducerToken GetProducerToken( std::size_t Level ) noexcept {
+        assert( Level < LEVELS );
+        return ProducerToken( Level, Queues[ Level ].GetProducerToken() );
+    }
+
+    ConsumerToken GetConsumerToken() noexcept { return MakeConsumerToken( std::make_index_sequence<LEVELS>{} ); }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool Enqueue( std::size_t Level, Args&&... args ) {
+        assert( Level < LEVELS );
+        return MarkIf( Level, Queues[ Level ].Enqueue( std::forward<Args>( args )... ) );
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool EnqueueWithToken( ProducerToken& Token, Args&&... args ) {
+        return MarkIf( Token.Level, Queues[ Token.Level ].EnqueueWithToken( Token.Token, std::forward<Args>( args )... ) );
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool EnqueueBulk( std::size_t Level, Iterator ItemFirst, std::size_t Count ) {
+        assert( Level < LEVELS );
+        return MarkIf( Level, Queues[ Level ].EnqueueBulk( std::move( ItemFirst ), Count ) );
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
+    bool EnqueueBulk( ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        return MarkIf( Token.Level, Queues[ Token.Level ].EnqueueBulk( Token.Token, std::move( ItemFirst ), Count ) );
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool TryEnqueue( std::size_t Level, Args&&... args ) {
+        assert( Level < LEVELS );
+        return MarkIf( Level, Queues[ Level ].TryEnqueue( std::forward<Args>( args )... ) );
+    }
+
+    template <class... Args>
+    HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
+    bool TryEnqueue( ProducerToken& Token, Args&&... args ) {
+        return MarkIf( Token.Level, Queues[ Token.Level ].TryEnqueue( Token.Token, std::forward<Args>( args )... ) );
+    }
+
+    template <class U>
+    HAKLE_REQUIRES( std::assignable_from<U&, T&&> )
+    bool TryDequeue( U& Element ) {
+        return DequeueFrom( NextScheduled( SharedRound ), [ & ]( std::size_t Level ) { return Queues[ Level ].TryDequeue( Element ); } );
+    }
+
+    template <class U>
+    HAKLE_REQUIRES( std::assignable_from<U&, T&&> )
+    bool TryDequeue( ConsumerToken& Token, U& Element ) {
+        return DequeueFrom( NextScheduled( Token.Round ), [ & ]( std::size_t Level ) { return Queues[ Level ].TryDequeue( Token.Tokens[ Level ], Element ); } );
+    }
+
+    // serves the scheduled level first and tops up from the following levels in priority order
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t TryDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        return DequeueBulkFrom( NextScheduled( SharedRound ), MaxCount,
+                                [ & ]( std::size_t Level, std::size_t Offset, std::size_t Count ) { return Queues[ Level ].TryDequeueBulk( std::next( ItemFirst, Offset ), Count ); } );
+    }
+
+    template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
+    std::size_t TryDequeueBulk( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
+        return DequeueBulkFrom( NextScheduled( Token.Round ), MaxCount, [ & ]( std::size_t Level, std::size_t Offset, std::size_t Count ) {
+            return Queues[ Level ].TryDequeueBulk( Token.Tokens[ Level ], std::next( ItemFirst, Offset ), Count );
+        } );
+    }
+
+    // O(producers of the level)
+    HAKLE_NODISCARD std::size_t SizeApprox( std::size_t Level ) const noexcept {
+        assert( Level < LEVELS );
+        return Queues[ Level ].SizeApprox();
+    }
+
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept {
+        std::size_t Size = 0;
+        for ( const InnerQueue& Queue : Queues ) {
+            Size += Queue.SizeApprox();
+        }
+        return Size;
+    }
+
+private:
+    template <std::size_t... Index>
+    static std::array<InnerQueue, LEVELS> MakeQueues( const AllocatorType& InAllocator, std::index_sequence<Index...> ) {
+        return { ( static_cast<void>( Index ), InnerQueue( InAllocator ) )... };
+    }
+
+    template <std::size_t... Index>
+    ConsumerToken MakeConsumerToken( std::index_sequence<Index...> ) noexcept {
+        return ConsumerToken( std::array<typename InnerQueue::ConsumerToken, LEVELS>{ Queues[ Index ].GetConsumerToken()... } );
+    }
+
+    // smooth weighted round-robin (as in nginx): every turn each level gains its weight and the richest level
+    // pays the total, which spreads a level's turns evenly over the round instead of bunching them up
+    static std::vector<std::uint8_t> MakeSchedule( WeightsType Weights ) {
+        const std::uint32_t Divisor = std::accumulate( Weights.begin(), Weights.end(), std::uint32_t{ 0 }, []( std::uint32_t A, std::uint32_t B ) { return std::gcd( A, B ); } );
+        assert( Divisor != 0 && "at least one level needs a non-zero weight" );
+        std::uint64_t Total = 0;
+        for ( std::uint32_t& Weight : Weights ) {
+            Weight /= Divisor;
+            Total += Weight;
+        }
+
+        // every non-zero weight keeps at least one turn, so leave a turn per level of slack for rounding up
+        if ( Total > MaxRoundLength ) {
+            const std::uint64_t Budget = MaxRoundLength - LEVELS;
+            const std::uint64_t Scaled = Total;
+            Total                      = 0;
+            for ( std::uint32_t& Weight : Weights ) {
+                if ( Weight != 0 ) {
+                    Weight = static_cast<std::uint32_t>( std::max<std::uint64_t>( 1, Weight * Budget / Scaled ) );
+                    Total += Weight;
+                }
+            }
+        }
+
+        std::vector<std::uint8_t> Result;
+        Result.reserve( Total );
+        std::array<std::int64_t, LEVELS> Current{};
+        for ( std::uint64_t Turn = 0; Turn < Total; ++Turn ) {
+            std::size_t Best = 0;
+            for ( std::size_t Level = 0; Level < LEVELS; ++Level ) {
+                Current[ Level ] += Weights[ Level ];
+                if ( Current[ Level ] > Current[ Best ] ) {
+                    Best = Level;
+                }
+            }
+            Current[ Best ] -= static_cast<std::int64_t>( Total );
+            Result.push_back( static_cast<std::uint8_t>( Best ) );
+        }
+        return Result;
+    }
+
+    // the level a dequeue should look at first, 0 under strict priority
+    std::size_t NextScheduled( std::uint32_t& Round ) noexcept {
+        if ( Schedule.empty() ) {
+            return 0;
+        }
+        return Schedule[ Round++ % Schedule.size() ];
+    }
+
+    std::size_t NextScheduled( std::atomic<std::uint32_t>& Round ) noexcept {
+        if ( Schedule.empty() ) {
+            return 0;
+        }
+        return Schedule[ Round.fetch_add( 1, std::memory_order_relaxed ) % Schedule.size() ];
+    }
+
+    // first set level at or after Preferred, wrapping round to the most urgent one
+    static std::size_t PickLevel( std::uint64_t Mask, std::size_t Preferred ) noexcept {
+        std::uint64_t AtOrAfter = Mask & ( ~std::uint64_t{ 0 } << Preferred );
+        return static_cast<std::size_t>( std::countr_zero( AtOrAfter != 0 ? AtOrAfter : Mask ) );
+    }
+
+    template <class TakeFunc>
+    bool DequeueFrom( std::size_t Preferred, TakeFunc&& Take ) {
+        std::uint64_t Mask = NonEmptyLevels.load( std::memory_order_acquire );
+        while ( Mask != 0 ) {
+            std::size_t Level = PickLevel( Mask, Preferred );
+            if ( Take( Level ) || UnmarkLevel( Level, [ & ] { return Take( Level ); } ) ) {
+                return true;
+            }
+            Mask &= ~( std::uint64_t{ 1 } << Level );
+        }
+        return false;
+    }
+
+    template <class TakeFunc>
+    std::size_t DequeueBulkFrom( std::size_t Preferred, std::size_t MaxCount, TakeFunc&& Take ) {
+        std::size_t   Taken = 0;
+        std::uint64_t Mask  = NonEmptyLevels.load( std::memory_order_acquire );
+        while ( Mask != 0 && Taken < MaxCount ) {
+            std::size_t Level = PickLevel( Mask, Preferred );
+            std::size_t Count = Take( Level, Taken, MaxCount - Taken );
+            if ( Count == 0 ) {
+                Count = UnmarkLevel( Level, [ & ] { return Take( Level, Taken, MaxCount - Taken ); } );
+            }
+            Taken += Count;
+            Mask &= ~( std::uint64_t{ 1 } << Level );
+            Preferred = Level;
+        }
+        return Taken;
+    }
+
+    bool MarkIf( std::size_t Level, bool Enqueued ) noexcept {
+        if ( Enqueued ) {
+            // pairs with the fence in UnmarkLevel: either we see the bit cleared, or the consumer sees our element
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            const std::uint64_t Bit = std::uint64_t{ 1 } << Level;
+            if ( ( NonEmptyLevels.load( std::memory_order_relaxed ) & Bit ) == 0 ) {
+                NonEmptyLevels.fetch_or( Bit, std::memory_order_release );
+            }
+        }
+        return Enqueued;
+    }
+
+    // called by consumers that came back empty-handed from Level: clears its bit, then retries the same
+    // dequeue instead of summing the level's producers. an element that raced in is either taken by the retry
+    // or re-marks the level itself after the fence; when the retry gets something, more may be left behind
+    template <class RetryFunc>
+    auto UnmarkLevel( std::size_t Level, RetryFunc&& Retry ) {
+        const std::uint64_t Bit = std::uint64_t{ 1 } << Level;
+        NonEmptyLevels.fetch_and( ~Bit, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        auto Result = Retry();
+        if ( Result ) {
+            NonEmptyLevels.fetch_or( Bit, std::memory_order_release );
+        }
+        return Result;
+    }
+
+    std::array<InnerQueue, LEVELS> Queues;
+    std::vector<std::uint8_t>      Schedule{};  // empty under strict priority
+    std::atomic<std::uint64_t>     NonEmptyLevels{ 0 };
+    std::atomic<std::uint32_t>     SharedRound{ 0 };  // schedule position of tokenless consumers
+};
+
+}  // namespace hakle
+
+#endif  // CONCURRENTPRIORITYQUEUE_H
@@ -9,14 +9,26 @@
 #include <atomic>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <thread>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "BlockManager.h"
 #include "ConcurrentQueue/Block.h"
 #include "ConcurrentQueue/HashTable.h"
+#include "ConcurrentQueue/LatencyHistogram.h"
+#include "ConcurrentQueue/ProducerIndex.h"
+#include "ConcurrentQueue/ReadinessNotifier.h"
+#include "ConcurrentQueue/SpillStore.h"
 #include "common/allocator.h"
 #include "common/common.h"
 #include "common/utility.h"
@@ -24,10 +36,366 @@
 namespace hakle {
 
 namespace details {
-    using thread_id_t = std::thread::id;
-    static const thread_id_t invalid_thread_id;
-    inline thread_id_t       thread_id() noexcept { return std::this_thread::get_id(); }
-    using thread_hash = std::hash<std::thread::id>;
+    // the address of a thread local is unique among live threads and leaves room for sentinel values
+    using thread_id_t = std::uintptr_t;
+    inline constexpr thread_id_t invalid_thread_id  = 0;
+    inline constexpr thread_id_t invalid_thread_id2 = 1;  // marks the entry of an exited thread
+    inline thread_id_t           thread_id() noexcept {
+        static thread_local char ThreadIdAnchor;
+        return reinterpret_cast<thread_id_t>( &ThreadIdAnchor );
+    }
+    using thread_hash = core::Hash<thread_id_t>;
+
+    class ThreadExitNotifier;
+
+    struct ThreadExitListener {
+        using CallbackType = void ( * )( void* );
+
+        CallbackType        Callback{ nullptr };
+        void*               UserData{ nullptr };
+        ThreadExitListener* Next{ nullptr };
+        ThreadExitNotifier* Chain{ nullptr };
+    };
+
+    // runs the listeners of a thread when its thread locals are destroyed
+    class ThreadExitNotifier {
+    public:
+        static void Subscribe( ThreadExitListener* Listener ) {
+            ThreadExitNotifier&         Notifier = Instance();
+            std::lock_guard<std::mutex> Guard( Mutex() );
+            Listener->Next  = Notifier.Tail;
+            Listener->Chain = &Notifier;
+            Notifier.Tail   = Listener;
+        }
+
+        static void Unsubscribe( ThreadExitListener* Listener ) {
+            std::lock_guard<std::mutex> Guard( Mutex() );
+            if ( Listener->Chain == nullptr ) {
+                return;
+            }
+            ThreadExitListener** Prev = &Listener->Chain->Tail;
+            for ( ThreadExitListener* Current = *Prev; Current != nullptr; Current = Current->Next ) {
+                if ( Current == Listener ) {
+                    *Prev = Current->Next;
+                    break;
+                }
+                Prev = &Current->Next;
+            }
+            Listener->Chain = nullptr;
+        }
+
+        ThreadExitNotifier( const ThreadExitNotifier& )            = delete;
+        ThreadExitNotifier& operator=( const ThreadExitNotifier& ) = delete;
+
+    private:
+        ThreadExitNotifier() = default;
+
+        ~ThreadExitNotifier() {
+            // holding the mutex keeps a concurrent Unsubscribe (and the owner's destruction) waiting
+            std::lock_guard<std::mutex> Guard( Mutex() );
+            for ( ThreadExitListener* Current = Tail; Current != nullptr; Current = Current->Next ) {
+                Current->Chain = nullptr;
+                Current->Callback( Current->UserData );
+            }
+        }
+
+        static ThreadExitNotifier& Instance() {
+            static thread_local ThreadExitNotifier Notifier;
+            return Notifier;
+        }
+
+        static std::mutex& Mutex() {
+            static std::mutex GlobalMutex;
+            return GlobalMutex;
+        }
+
+        ThreadExitListener* Tail{ nullptr };
+    };
+
+    // queue ids are never reused, so a cached entry of a destroyed queue can never match again
+    inline std::uint64_t NextQueueId() noexcept {
+        static std::atomic<std::uint64_t> Counter{ 1 };
+        return Counter.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    // per thread xorshift64*, seeded from the thread id, cheap enough to run on every dequeue
+    inline std::uint64_t ThreadLocalRandom() noexcept {
+        static thread_local std::uint64_t State = ( static_cast<std::uint64_t>( thread_id() ) * 0x9E3779B97F4A7C15ULL ) | 1;
+        State ^= State >> 12;
+        State ^= State << 25;
+        State ^= State >> 27;
+        return State * 0x2545F4914F6CDD1DULL;
+    }
+
+    // process wide epoch based reclamation for producer list nodes: a thread pins the current epoch while it may
+    // hold node pointers, and a node unlinked at epoch E is freed once no thread is pinned below E
+    class EpochDomain {
+    public:
+        static constexpr std::uint64_t Idle = ~std::uint64_t{ 0 };
+
+        static void Pin() noexcept {
+            Record& Local = LocalRecord();
+            if ( Local.Nest++ == 0 ) {
+                // release, so a reclaimer reading the new epoch also sees everything done under the last pin
+                Local.Epoch.store( GlobalEpoch().load( std::memory_order_relaxed ), std::memory_order_release );
+                // pairs with the fence in MinPinnedEpoch: either the reclaimer sees us pinned, or we see the unlink
+                std::atomic_thread_fence( std::memory_order_seq_cst );
+            }
+        }
+
+        static void Unpin() noexcept {
+            Record& Local = LocalRecord();
+            if ( --Local.Nest == 0 ) {
+                Local.Epoch.store( Idle, std::memory_order_release );
+            }
+        }
+
+        // call after unlinking, what was unlinked is safe to free once MinPinnedEpoch() reaches the result
+        static std::uint64_t Advance() noexcept { return GlobalEpoch().fetch_add( 1, std::memory_order_seq_cst ) + 1; }
+
+        static std::uint64_t MinPinnedEpoch() noexcept {
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            std::uint64_t Min = Idle;
+            for ( Record* Current = Records().load( std::memory_order_acquire ); Current != nullptr; Current = Current->Next ) {
+                Min = std::min( Min, Current->Epoch.load( std::memory_order_seq_cst ) );
+            }
+            return Min;
+        }
+
+    private:
+        struct Record {
+            std::atomic<std::uint64_t> Epoch{ Idle };
+            std::atomic<bool>          InUse{ true };
+            Record*                    Next{ nullptr };
+            std::uint32_t              Nest{ 0 };  // owner only
+        };
+
+        // records are never freed, an exiting thread hands its record to the next one
+        struct RecordHolder {
+            Record* Owned{ Acquire() };
+            ~RecordHolder() {
+                Owned->Epoch.store( Idle, std::memory_order_relaxed );
+                Owned->InUse.store( false, std::memory_order_release );
+            }
+        };
+
+        static Record* Acquire() {
+            for ( Record* Current = Records().load( std::memory_order_acquire ); Current != nullptr; Current = Current->Next ) {
+                bool Expected = false;
+                if ( !Current->InUse.load( std::memory_order_relaxed ) && Current->InUse.compare_exchange_strong( Expected, true, std::memory_order_acq_rel, std::memory_order_relaxed ) ) {
+                    Current->Nest = 0;
+                    return Current;
+                }
+            }
+
+            Record* NewRecord = new Record;
+            Record* Head      = Records().load( std::memory_order_relaxed );
+            do {
+                NewRecord->Next = Head;
+            } while ( !Records().compare_exchange_weak( Head, NewRecord, std::memory_order_release, std::memory_order_relaxed ) );
+            return NewRecord;
+        }
+
+        static Record& LocalRecord() noexcept {
+            static thread_local RecordHolder Holder;
+            return *Holder.Owned;
+        }
+
+        static std::atomic<std::uint64_t>& GlobalEpoch() noexcept {
+            static std::atomic<std::uint64_t> Epoch{ 1 };
+            return Epoch;
+        }
+
+        static std::atomic<Record*>& Records() noexcept {
+            static std::atomic<Record*> Head{ nullptr };
+            return Head;
+        }
+    };
+
+    struct EpochGuard {
+        EpochGuard() noexcept { EpochDomain::Pin(); }
+        ~EpochGuard() { EpochDomain::Unpin(); }
+
+        EpochGuard( const EpochGuard& )            = delete;
+        EpochGuard& operator=( const EpochGuard& ) = delete;
+    };
+
+    // stands in for EpochGuard when nothing is ever reclaimed
+    struct NullGuard {};
+
+    // stands in for ReadinessNotifier when the traits leave it off
+    struct NullNotifier {};
+
+    // stands in for SpillStore when the traits leave spilling off
+    struct NullSpill {};
+
+    // per thread (queue id -> implicit producer) cache, spares the hash table lookup on tokenless enqueue
+    struct ImplicitProducerCache {
+        static constexpr std::size_t CacheSize = 4;
+
+        struct Entry {
+            std::uint64_t QueueId{ 0 };
+            void*         Producer{ nullptr };
+        };
+
+        HAKLE_NODISCARD void* Find( std::uint64_t QueueId ) const noexcept {
+            for ( const Entry& Current : Entries ) {
+                if ( Current.QueueId == QueueId ) {
+                    return Current.Producer;
+                }
+            }
+            return nullptr;
+        }
+
+        void Insert( std::uint64_t QueueId, void* Producer ) noexcept {
+            Entries[ Next ] = Entry{ QueueId, Producer };
+            Next            = ( Next + 1 ) % CacheSize;
+        }
+
+        static ImplicitProducerCache& Instance() noexcept {
+            static thread_local ImplicitProducerCache Cache;
+            return Cache;
+        }
+
+        Entry       Entries[ CacheSize ]{};
+        std::size_t Next{ 0 };
+    };
+
+    // blocks of a SojournTiming queue, see TimestampedPolicy
+    template <class Block, class = void>
+    struct HasStampsImpl : std::false_type {};
+
+    template <class Block>
+    struct HasStampsImpl<Block, std::void_t<decltype( std::declval<Block&>().Stamps )>> : std::true_type {};
+
+    template <class Block>
+    inline constexpr bool HasStamps = HasStampsImpl<Block>::value;
+
+    // the sojourn histograms of one queue, one per consumer thread so that recording stays single writer.
+    // a thread finds its own through a per thread cache (a separate ImplicitProducerCache instance) and on a miss
+    // by its thread id in the list. nothing is freed before the queue, so what was recorded survives the threads
+    class ConsumerHistograms {
+    public:
+        ConsumerHistograms() = default;
+        ~ConsumerHistograms() { Clear(); }
+
+        ConsumerHistograms( const ConsumerHistograms& )            = delete;
+        ConsumerHistograms& operator=( const ConsumerHistograms& ) = delete;
+
+        // nullptr when out of memory, the caller then records nothing
+        LogLinearHistogram* Local( std::uint64_t QueueId ) noexcept {
+            static thread_local ImplicitProducerCache Cache;
+            if ( void* Found = Cache.Find( QueueId ) ) {
+                return static_cast<LogLinearHistogram*>( Found );
+            }
+
+            // thread_id() is the address of a thread_local, which the runtime hands to a later thread once this one
+            // exits. that thread then takes over the exited thread's node: still one writer at a time, and the
+            // histogram simply goes on with the new thread's samples
+            const thread_id_t Self = thread_id();
+            Node*             Mine = nullptr;
+            for ( Node* Current = Head.load( std::memory_order_acquire ); Current != nullptr && Mine == nullptr; Current = Current->Next ) {
+                Mine = Current->Owner == Self ? Current : nullptr;
+            }
+            if ( Mine == nullptr ) {
+                if ( ( Mine = new ( std::nothrow ) Node{} ) == nullptr ) {
+                    return nullptr;
+                }
+                Mine->Owner = Self;
+                Mine->Next  = Head.load( std::memory_order_relaxed );
+                while ( !Head.compare_exchange_weak( Mine->Next, Mine, std::memory_order_release, std::memory_order_relaxed ) ) {
+                }
+            }
+            Cache.Insert( QueueId, &Mine->Histogram );
+            return &Mine->Histogram;
+        }
+
+        // every consumer's histogram added up, consumers may keep recording meanwhile
+        HAKLE_NODISCARD LogLinearHistogram Merged() const noexcept {
+            LogLinearHistogram Result;
+            for ( const Node* Current = Head.load( std::memory_order_acquire ); Current != nullptr; Current = Current->Next ) {
+                Result.Merge( Current->Histogram );
+            }
+            return Result;
+        }
+
+        // NOTE: not thread safe, nobody may record meanwhile
+        void Clear() noexcept {
+            Node* Current = Head.exchange( nullptr, std::memory_order_relaxed );
+            while ( Current != nullptr ) {
+                Node* Next = Current->Next;
+                delete Current;
+                Current = Next;
+            }
+        }
+
+        void swap( ConsumerHistograms& Other ) noexcept { core::SwapRelaxed( Head, Other.Head ); }
+
+    private:
+        struct Node {
+            LogLinearHistogram Histogram;
+            thread_id_t        Owner{ invalid_thread_id };
+            Node*              Next{ nullptr };
+        };
+
+        std::atomic<Node*> Head{ nullptr };
+    };
+
+    // stands in for ConsumerHistograms when the traits leave SojournTiming off
+    struct NullHistograms {};
+
+    // where a dequeue records sojourn times. the consumer's histogram is looked up on the first record, i.e. only
+    // once something was claimed, so failed dequeues never pay for the lookup
+    struct SojournSink {
+        ConsumerHistograms* Histograms{ nullptr };
+        std::uint64_t       QueueId{ 0 };
+        LogLinearHistogram* Local{ nullptr };
+
+        // nullptr when out of memory, nothing is recorded then
+        LogLinearHistogram* Get() noexcept {
+            if ( Local == nullptr && Histograms != nullptr ) {
+                Local = Histograms->Local( QueueId );
+            }
+            return Local;
+        }
+    };
+
+    // Iterator walks contiguous storage of trivially copyable T, so a run of elements can be copied with memcpy
+#if HAKLE_CPP_VERSION >= 20
+    template <class T, class Iterator>
+    inline constexpr bool IsMemcpyable = std::is_trivially_copyable_v<T> && std::contiguous_iterator<Iterator> && std::is_same_v<std::iter_value_t<Iterator>, T>;
+#else
+    template <class T, class Iterator>
+    inline constexpr bool IsMemcpyable = false;
+#endif
+
+    // the range EnqueueBulkMove hands on: moving a trivially copyable element is a copy, so a memcpy-able range is
+    // passed as is to keep the block copy path, anything else goes through a move iterator
+    template <class T, class Iterator>
+    constexpr auto MoveFromIterator( Iterator ItemFirst ) noexcept {
+        HAKLE_CONSTEXPR_IF( IsMemcpyable<T, Iterator> ) { return ItemFirst; }
+        else {
+            return std::make_move_iterator( ItemFirst );
+        }
+    }
+
+    // the consumer DequeueBulk hands to ConsumeBulk: moves each element out through ItemFirst,
+    // or copies whole spans when that is just a memcpy
+    template <class T, class Iterator>
+    constexpr auto MoveToIterator( Iterator& ItemFirst ) noexcept {
+        HAKLE_CONSTEXPR_IF( IsMemcpyable<T, Iterator> ) {
+            return [ &ItemFirst ]( T* Slots, std::size_t Count ) noexcept {
+                std::memcpy( std::to_address( ItemFirst ), Slots, Count * sizeof( T ) );
+                ItemFirst += Count;
+            };
+        }
+        else {
+            return [ &ItemFirst ]( T& Value ) noexcept( noexcept( *ItemFirst = std::move( Value ) ) ) {
+                *ItemFirst = std::move( Value );
+                ++ItemFirst;
+            };
+        }
+    }
 }  // namespace details
 
 #ifdef HAKLE_USE_CONCEPT
@@ -70,9 +438,14 @@ concept HasMakeImplicitBlockManager = HasMakeImplicitBlockManagerHelper<Traits>:
 
 struct _QueueTypelessBase {};
 
+// size limit meaning "bounded only by memory"
+inline constexpr std::size_t UnlimitedSize = std::numeric_limits<std::size_t>::max();
+
 // TODO: manager traits
 // NOTE: QueueBase is an internal non-virtual base class and must never be destroyed via a base-class pointer.
-template <class T, std::size_t BLOCK_SIZE, class Allocator, HAKLE_CONCEPT( IsBlock ) BLOCK_TYPE, HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE>
+// ISOLATED_LAYOUT puts the consumer counters and the producer tail on cache lines of their own,
+// at the cost of padding every sub-queue to whole lines
+template <class T, std::size_t BLOCK_SIZE, class Allocator, HAKLE_CONCEPT( IsBlock ) BLOCK_TYPE, HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE, bool ISOLATED_LAYOUT = false>
 HAKLE_REQUIRES( CheckBlockSize<BLOCK_SIZE, BLOCK_TYPE>&& CheckBlockManager<BLOCK_TYPE, BLOCK_MANAGER_TYPE> )
 struct _QueueBase : public _QueueTypelessBase {
 public:
@@ -98,21 +471,182 @@ public:
     HAKLE_NODISCARD constexpr std::size_t GetTail() const noexcept { return TailIndex.load( std::memory_order_relaxed ); }
 
 protected:
-    std::atomic<std::size_t> HeadIndex{};
-    std::atomic<std::size_t> TailIndex{};
+    // MaxSize rounded up to whole blocks, the limit is only checked when a new block is needed
+    template <std::size_t MaxSize>
+    constexpr static std::size_t RoundedMaxSize = MaxSize > UnlimitedSize - BlockSize ? UnlimitedSize : ( MaxSize + BlockSize - 1 ) & ~( BlockSize - 1 );
+
+    // true when a new block based at BlockBase would grow the sub-queue beyond MaxSize
+    template <std::size_t MaxSize>
+    HAKLE_NODISCARD constexpr static bool ExceedsMaxSize( std::size_t Head, std::size_t BlockBase ) noexcept {
+        constexpr std::size_t Limit = RoundedMaxSize<MaxSize>;
+        HAKLE_CONSTEXPR_IF( Limit == UnlimitedSize ) { return false; }
+        return Limit == 0 || BlockBase - Head > Limit - BlockSize;
+    }
+
+    // producer side: true when no block based at BlockBase may be added, because the index space would wrap past
+    // the head or the sub-queue would grow beyond MaxSize.
+    // the head only moves forward, so a stale copy can only err towards full; HeadIndex, which consumers keep
+    // writing, is reloaded only when the cached copy says full
+    template <std::size_t MaxSize>
+    HAKLE_NODISCARD constexpr bool IsFullAt( std::size_t BlockBase ) noexcept {
+        if HAKLE_LIKELY ( !WouldOverrun<MaxSize>( PO_CachedHeadIndex, BlockBase ) ) {
+            return false;
+        }
+        PO_CachedHeadIndex = HeadIndex.load( std::memory_order_relaxed );
+        return WouldOverrun<MaxSize>( PO_CachedHeadIndex, BlockBase );
+    }
+
+    template <std::size_t MaxSize>
+    HAKLE_NODISCARD constexpr static bool WouldOverrun( std::size_t Head, std::size_t BlockBase ) noexcept {
+        return !CircularLessThan( Head, BlockBase + BlockSize ) || ExceedsMaxSize<MaxSize>( Head, BlockBase );
+    }
+
+    // claims up to MaxCount published elements for the caller, returns how many and the index of the first one.
+    // with a single consumer nobody races for the head, so plain loads and a store replace the attempt counters
+    template <bool SingleConsumer>
+    HAKLE_NODISCARD constexpr std::size_t ClaimRange( std::size_t MaxCount, std::size_t& FirstIndex ) noexcept {
+        HAKLE_CONSTEXPR_IF( SingleConsumer ) {
+            std::size_t Head = HeadIndex.load( std::memory_order_relaxed );
+            std::size_t Tail = TailIndex.load( std::memory_order_acquire );
+            if ( !CircularLessThan( Head, Tail ) ) {
+                return 0;
+            }
+
+            std::size_t Count = std::min( Tail - Head, MaxCount );
+            FirstIndex        = Head;
+            HeadIndex.store( Head + Count, std::memory_order_relaxed );
+            return Count;
+        }
+        else {
+            std::size_t FailedCount  = DequeueFailedCount.load( std::memory_order_relaxed );
+            std::size_t DesiredCount = TailIndex.load( std::memory_order_relaxed ) - ( DequeueAttemptsCount.load( std::memory_order_relaxed ) - FailedCount );
+            if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, DesiredCount ) ) ) {
+                DesiredCount = std::min( DesiredCount, MaxCount );
+                // pairs with the release increment of DequeueFailedCount: a consumer bumps it only after its own
+                // fetch_add on DequeueAttemptsCount, so once we have read its FailedCount, the attempts count we
+                // fetch below is at least as new and AttemptsCount - FailedCount cannot wrap around
+                std::atomic_thread_fence( std::memory_order_acquire );
+
+                std::size_t AttemptsCount = DequeueAttemptsCount.fetch_add( DesiredCount, std::memory_order_relaxed );
+                std::size_t ActualCount   = TailIndex.load( std::memory_order_acquire ) - ( AttemptsCount - FailedCount );
+                if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, ActualCount ) ) ) {
+                    ActualCount = std::min( ActualCount, DesiredCount );
+                    if ( ActualCount < DesiredCount ) {
+                        DequeueFailedCount.fetch_add( DesiredCount - ActualCount, std::memory_order_release );
+                    }
+
+                    FirstIndex = HeadIndex.fetch_add( ActualCount, std::memory_order_relaxed );
+                    return ActualCount;
+                }
+
+                DequeueFailedCount.fetch_add( DesiredCount, std::memory_order_release );
+            }
+            return 0;
+        }
+    }
+
+    // bulk enqueue may memcpy whole spans instead of constructing one by one,
+    // not under leak detection, which has to see every Construct / Destroy
+#if defined( ENABLE_MEMORY_LEAK_DETECTION )
+    template <class Iterator>
+    constexpr static bool CanBlockCopy = false;
+#else
+    template <class Iterator>
+    constexpr static bool CanBlockCopy = details::IsMemcpyable<ValueType, Iterator>;
+#endif
+
+    // consumers take either Func( ValueType& ) per element or Func( ValueType* Slots, std::size_t Count ) per span
+    template <class Function>
+    constexpr static bool IsSpanConsumer = std::is_invocable_v<Function&, ValueType*, std::size_t>;
+
+    template <class Function>
+    constexpr static bool IsNothrowConsumer = IsSpanConsumer<Function> ? std::is_nothrow_invocable_v<Function&, ValueType*, std::size_t> : std::is_nothrow_invocable_v<Function&, ValueType&>;
+
+    // hands [ CurrentIndex, EndIndex ) of InBlock to Func and destroys it,
+    // if Func throws, CurrentIndex is left at the first element still alive
+    template <class Function>
+    constexpr void VisitSlots( BlockType& InBlock, std::size_t& CurrentIndex, std::size_t EndIndex, std::size_t& NeedCount, Function& Func ) {
+        HAKLE_CONSTEXPR_IF( IsSpanConsumer<Function> ) {
+            Func( InBlock[ CurrentIndex ], EndIndex - CurrentIndex );
+#if !defined( ENABLE_MEMORY_LEAK_DETECTION )
+            HAKLE_CONSTEXPR_IF( std::is_trivially_destructible<ValueType>::value ) {
+                NeedCount -= EndIndex - CurrentIndex;
+                CurrentIndex = EndIndex;
+                return;
+            }
+#endif
+            while ( CurrentIndex != EndIndex ) {
+                ValueAllocatorTraits::Destroy( ValueAllocator, InBlock[ CurrentIndex ] );
+                ++CurrentIndex;
+                --NeedCount;
+            }
+        }
+        else {
+            while ( CurrentIndex != EndIndex ) {
+                ValueType& Value = *InBlock[ CurrentIndex ];
+                Func( Value );
+                ValueAllocatorTraits::Destroy( ValueAllocator, &Value );
+                ++CurrentIndex;
+                --NeedCount;
+            }
+        }
+    }
+
+    // SojournTiming: blocks carry the enqueue time of each slot
+    constexpr static bool Timed = details::HasStamps<BlockType>;
+
+    // producer side, stamps Count slots from Index of InBlock on, following Next; before they are published
+    constexpr void StampSlots( BlockType* InBlock, std::size_t Index, std::size_t Count ) noexcept {
+        HAKLE_CONSTEXPR_IF( Timed ) {
+            const std::uint64_t Now = SojournClock::Now();
+            while ( true ) {
+                std::size_t SpanCount = std::min( BlockSize - Index, Count );
+                std::fill_n( InBlock->Stamps.begin() + Index, SpanCount, Now );
+                if ( ( Count -= SpanCount ) == 0 ) {
+                    break;
+                }
+                InBlock = InBlock->Next;
+                Index   = 0;
+            }
+        }
+    }
+
+    // consumer side, [ Index, EndIndex ) of InBlock is claimed and not yet handed back
+    constexpr static void RecordSojourn( const BlockType& InBlock, std::size_t Index, std::size_t EndIndex, details::SojournSink* Sojourn ) noexcept {
+        HAKLE_CONSTEXPR_IF( Timed ) {
+            LogLinearHistogram* Histogram = Sojourn != nullptr ? Sojourn->Get() : nullptr;
+            if ( Histogram == nullptr ) {
+                return;
+            }
+            const std::uint64_t Now = SojournClock::Now();
+            for ( ; Index != EndIndex; ++Index ) {
+                std::uint64_t Stamp = InBlock.Stamps[ Index ];
+                Histogram->Record( Now > Stamp ? Now - Stamp : 0 );
+            }
+        }
+    }
+
+    constexpr static std::size_t HotFieldAlignment = ISOLATED_LAYOUT ? HAKLE_CACHE_LINE_SIZE : alignof( std::atomic<std::size_t> );
+
+    // written by consumers
+    alignas( HotFieldAlignment ) std::atomic<std::size_t> HeadIndex{};
     std::atomic<std::size_t> DequeueAttemptsCount{};
     std::atomic<std::size_t> DequeueFailedCount{};
-    BlockType*               TailBlock{};
+
+    // written by the producer
+    alignas( HotFieldAlignment ) std::atomic<std::size_t> TailIndex{};
+    BlockType*  TailBlock{};
+    std::size_t PO_CachedHeadIndex{};  // producer's last look at HeadIndex, see IsFullAt
 
     [[no_unique_address]] ValueAllocatorType ValueAllocator{};
 };
 
 // SPMC Queue
 template <class T, std::size_t BLOCK_SIZE, class Allocator = HakleAllocator<T>, HAKLE_CONCEPT( IsBlock ) BLOCK_TYPE = HakleFlagsBlock<T, BLOCK_SIZE>,
-          HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE = HakleBlockManager<BLOCK_TYPE>>
-class FastQueue : public _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE> {
+          HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE = HakleBlockManager<BLOCK_TYPE>, std::size_t MAX_SIZE = UnlimitedSize, bool SINGLE_CONSUMER = false, bool ISOLATED_LAYOUT = false>
+class FastQueue : public _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE, ISOLATED_LAYOUT> {
 public:
-    using Base = _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE>;
+    using Base = _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE, ISOLATED_LAYOUT>;
 
     using Base::BlockSize;
     using typename Base::AllocMode;
@@ -134,7 +668,7 @@ private:
 
 public:
     constexpr explicit FastQueue( std::size_t InSize, BlockManagerType& InBlockManager, const ValueAllocatorType& InAllocator = ValueAllocatorType{} ) noexcept
-        : Base( InAllocator ), BlockManager( InBlockManager ), IndexEntryAllocator( IndexEntryAllocatorType( InAllocator ) ), IndexEntryArrayAllocator( IndexEntryArrayAllocatorType( InAllocator ) ) {
+        : Base( InAllocator ), BlockManager( &InBlockManager ), IndexEntryAllocator( IndexEntryAllocatorType( InAllocator ) ), IndexEntryArrayAllocator( IndexEntryArrayAllocatorType( InAllocator ) ) {
         std::size_t InitialSize = CeilToPow2( InSize ) >> 1;
         if ( InitialSize < 2 ) {
             InitialSize = 2;
@@ -144,6 +678,9 @@ public:
         CreateNewBlockIndexArray( 0 );
     }
 
+    // the owning queue rebinds its producers after a move or swap
+    constexpr void RebindBlockManager( BlockManagerType& InBlockManager ) noexcept { BlockManager = &InBlockManager; }
+
     HAKLE_CPP20_CONSTEXPR ~FastQueue() {
         if ( this->TailBlock != nullptr ) {
             // first, we find the first block that's half dequeued
@@ -181,7 +718,7 @@ public:
             BlockType* Block = this->TailBlock;
             do {
                 BlockType* NextBlock = Block->Next;
-                BlockManager.ReturnBlock( Block );
+                BlockManager->ReturnBlock( Block );
                 Block = NextBlock;
             } while ( Block != this->TailBlock );
         }
@@ -215,8 +752,7 @@ public:
             }
             else {
                 // we need to find a new block index and get a new block from block manager
-                // TODO: add MAX_SIZE check
-                if HAKLE_UNLIKELY ( !CircularLessThan( this->HeadIndex.load( std::memory_order_relaxed ), CurrentTailIndex + BlockSize ) ) {
+                if HAKLE_UNLIKELY ( this->template IsFullAt<MAX_SIZE>( CurrentTailIndex ) ) {
                     return false;
                 }
 
@@ -228,7 +764,7 @@ public:
                     }
                 }
 
-                BlockType* NewBlock = BlockManager.RequisitionBlock( Mode );
+                BlockType* NewBlock = BlockManager->RequisitionBlock( Mode );
                 if HAKLE_UNLIKELY ( NewBlock == nullptr ) {
                     return false;
                 }
@@ -266,6 +802,7 @@ public:
             }
 
             HAKLE_CONSTEXPR_IF( !std::is_nothrow_constructible<ValueType, Args&&...>::value ) {
+                this->StampSlots( this->TailBlock, InnerIndex, 1 );
                 this->TailIndex.store( NewTailIndex, std::memory_order_release );
                 return true;
             }
@@ -273,6 +810,7 @@ public:
 
         ValueAllocatorTraits::Construct( this->ValueAllocator, ( *( this->TailBlock ) )[ InnerIndex ], std::forward<Args>( args )... );
 
+        this->StampSlots( this->TailBlock, InnerIndex, 1 );
         this->TailIndex.store( NewTailIndex, std::memory_order_release );
         return true;
     }
@@ -280,12 +818,15 @@ public:
     template <AllocMode Mode, HAKLE_CONCEPT( std::input_iterator ) Iterator>
     HAKLE_REQUIRES( requires( Iterator Item ) { ValueType( *Item ); } )
     HAKLE_CPP20_CONSTEXPR bool EnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        if HAKLE_UNLIKELY ( Count == 0 ) {
+            return true;
+        }
+
         // set original state
-        std::size_t OriginIndexEntriesUsed = PO_IndexEntriesUsed;
-        std::size_t OriginNextIndexEntry   = PO_NextIndexEntry;
-        BlockType*  StartBlock             = this->TailBlock;
-        std::size_t StartTailIndex         = this->TailIndex.load( std::memory_order_relaxed );
-        BlockType*  FirstAllocatedBlock    = nullptr;
+        std::size_t OriginNextIndexEntry = PO_NextIndexEntry;
+        BlockType*  StartBlock           = this->TailBlock;
+        std::size_t StartTailIndex       = this->TailIndex.load( std::memory_order_relaxed );
+        BlockType*  FirstAllocatedBlock  = nullptr;
 
         // roll back
         auto RollBack = [ this, &OriginNextIndexEntry, &StartBlock ]() -> void {
@@ -293,87 +834,22 @@ public:
             this->TailBlock   = StartBlock;
         };
 
-        std::size_t LastTailIndex = StartTailIndex - 1;
-        // std::size_t BlockCountNeed =
-        //     ( ( ( Count + LastTailIndex ) & ~( BlockSize - 1 ) ) - ( ( LastTailIndex & ~( BlockSize - 1 ) ) ) ) >> BlockSizeLog2;
-
-        // StartTailIndex - 1 must be signed before shifting
-        std::size_t BlockCountNeed   = ( ( Count + StartTailIndex - 1 ) >> BlockSizeLog2 ) - ( static_cast<std::make_signed_t<std::size_t>>( StartTailIndex - 1 ) >> BlockSizeLog2 );
-        std::size_t CurrentTailIndex = LastTailIndex & ~( BlockSize - 1 );
-
-        if HAKLE_LIKELY ( BlockCountNeed > 0 ) {
-            while ( BlockCountNeed > 0 && this->TailBlock != nullptr && this->TailBlock->Next->IsEmpty() ) {
-                // we can re-use that block
-                --BlockCountNeed;
-                CurrentTailIndex += BlockSize;
-
-                this->TailBlock     = this->TailBlock->Next;
-                FirstAllocatedBlock = FirstAllocatedBlock == nullptr ? this->TailBlock : FirstAllocatedBlock;
-                this->TailBlock->Reset();
-
-                auto& Entry       = this->CurrentIndexEntryArray.load( std::memory_order_relaxed )->Entries[ PO_NextIndexEntry ];
-                Entry.Base        = CurrentTailIndex;
-                Entry.InnerBlock  = this->TailBlock;
-                PO_NextIndexEntry = ( PO_NextIndexEntry + 1 ) & ( PO_IndexEntriesSize - 1 );
-            }
-
-            while ( BlockCountNeed > 0 ) {
-                // we must get a new block
-                --BlockCountNeed;
-                CurrentTailIndex += BlockSize;
-
-                // TODO: add MAX_SIZE check
-                if HAKLE_UNLIKELY ( !CircularLessThan( this->HeadIndex.load( std::memory_order_relaxed ), CurrentTailIndex + BlockSize ) ) {
-                    RollBack();
-                    return false;
-                }
-
-                if HAKLE_UNLIKELY ( CurrentIndexEntryArray.load( std::memory_order_relaxed ) == nullptr || PO_IndexEntriesUsed == PO_IndexEntriesSize ) {
-                    // need to create a new index entry array
-                    HAKLE_CONSTEXPR_IF( Mode == AllocMode::CannotAlloc ) {
-                        RollBack();
-                        return false;
-                    }
-                    else if ( !CreateNewBlockIndexArray( OriginIndexEntriesUsed ) ) {
-                        RollBack();
-                        return false;
-                    }
-
-                    OriginNextIndexEntry = OriginIndexEntriesUsed;
-                }
-
-                BlockType* NewBlock = BlockManager.RequisitionBlock( Mode );
-                if HAKLE_UNLIKELY ( NewBlock == nullptr ) {
-                    RollBack();
-                    return false;
-                }
-
-                NewBlock->Reset();
-                if ( this->TailBlock == nullptr ) {
-                    NewBlock->Next = NewBlock;
-                }
-                else {
-                    NewBlock->Next        = this->TailBlock->Next;
-                    this->TailBlock->Next = NewBlock;
-                }
-                this->TailBlock     = NewBlock;
-                FirstAllocatedBlock = FirstAllocatedBlock == nullptr ? this->TailBlock : FirstAllocatedBlock;
-                // get a new block
-                ++PO_IndexEntriesUsed;
-
-                auto& Entry       = this->CurrentIndexEntryArray.load( std::memory_order_relaxed )->Entries[ PO_NextIndexEntry ];
-                Entry.Base        = CurrentTailIndex;
-                Entry.InnerBlock  = this->TailBlock;
-                PO_NextIndexEntry = ( PO_NextIndexEntry + 1 ) & ( PO_IndexEntriesSize - 1 );
-            }
+        if HAKLE_UNLIKELY ( !AcquireBlocks<Mode>( StartTailIndex, Count, FirstAllocatedBlock, OriginNextIndexEntry ) ) {
+            return false;
         }
 
         // we already have enough blocks, let's fill them
         std::size_t StartInnerIndex = StartTailIndex & ( BlockSize - 1 );
         BlockType*  CurrentBlock    = ( StartInnerIndex == 0 && FirstAllocatedBlock != nullptr ) ? FirstAllocatedBlock : StartBlock;
+        this->StampSlots( CurrentBlock, StartInnerIndex, Count );
         while ( true ) {
             std::size_t EndInnerIndex = ( CurrentBlock == this->TailBlock ) ? ( StartTailIndex + Count - 1 ) & ( BlockSize - 1 ) : ( BlockSize - 1 );
-            HAKLE_CONSTEXPR_IF( std::is_nothrow_constructible<ValueType, typename std::iterator_traits<Iterator>::value_type>::value ) {
+            HAKLE_CONSTEXPR_IF( Base::template CanBlockCopy<Iterator> ) {
+                std::size_t SpanCount = EndInnerIndex + 1 - StartInnerIndex;
+                std::memcpy( ( *CurrentBlock )[ StartInnerIndex ], std::to_address( ItemFirst ), SpanCount * sizeof( ValueType ) );
+                ItemFirst += SpanCount;
+            }
+            else HAKLE_CONSTEXPR_IF( std::is_nothrow_constructible<ValueType, typename std::iterator_traits<Iterator>::value_type>::value ) {
                 while ( StartInnerIndex <= EndInnerIndex ) {
                     ValueAllocatorTraits::Construct( this->ValueAllocator, ( *CurrentBlock )[ StartInnerIndex ], *ItemFirst++ );
                     ++StartInnerIndex;
@@ -441,148 +917,297 @@ public:
         return true;
     }
 
-    // TODO: EnqueueBulkMove
+    // uninitialized slots handed out by Reserve, laid out as one contiguous span per block
+    struct Reservation {
+        BlockType*  FirstBlock{ nullptr };
+        std::size_t FirstIndex{ 0 };
+        std::size_t Count{ 0 };
+
+        // calls Func( ValueType* Slots, std::size_t SlotCount ) for each span, in queue order
+        template <class Function>
+        constexpr void ForEachSpan( Function&& Func ) const {
+            BlockType*  Block = FirstBlock;
+            std::size_t Index = FirstIndex;
+            std::size_t Left  = Count;
+            while ( Left != 0 ) {
+                std::size_t SpanCount = std::min( BlockSize - Index, Left );
+                Func( ( *Block )[ Index ], SpanCount );
+                Left -= SpanCount;
+                Block = Block->Next;
+                Index = 0;
+            }
+        }
 
-    // Dequeue
-    template <class U>
-    constexpr bool Dequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), ValueType&&> ) {
-        std::size_t FailedCount = this->DequeueFailedCount.load( std::memory_order_relaxed );
-        if ( HAKLE_LIKELY( CircularLessThan( this->DequeueAttemptsCount.load( std::memory_order_relaxed ) - FailedCount, this->TailIndex.load( std::memory_order_relaxed ) ) ) ) {
-            // TODO: understand this
-            std::atomic_thread_fence( std::memory_order_acquire );
-
-            std::size_t AttemptsCount = this->DequeueAttemptsCount.fetch_add( 1, std::memory_order_relaxed );
-            if ( HAKLE_LIKELY( CircularLessThan( AttemptsCount - FailedCount, this->TailIndex.load( std::memory_order_acquire ) ) ) ) {
-                // NOTE: getting headIndex must be front of getting CurrentIndexEntryArray
-                // if get CurrentIndexEntryArray first, there is a situation that makes FirstBlockIndexBase larger than IndexEntryTailBase
-                std::size_t Index      = this->HeadIndex.fetch_add( 1, std::memory_order_relaxed );
-                std::size_t InnerIndex = Index & ( BlockSize - 1 );
-
-                // we can dequeue
-                IndexEntryArray* LocalIndexEntryArray = this->CurrentIndexEntryArray.load( std::memory_order_acquire );
-                std::size_t      LocalIndexEntryIndex = LocalIndexEntryArray->Tail.load( std::memory_order_acquire );
-
-                std::size_t IndexEntryTailBase  = LocalIndexEntryArray->Entries[ LocalIndexEntryIndex ].Base;
-                std::size_t FirstBlockIndexBase = Index & ~( BlockSize - 1 );
-                std::size_t Offset              = ( FirstBlockIndexBase - IndexEntryTailBase ) >> BlockSizeLog2;
-                BlockType*  DequeueBlock        = LocalIndexEntryArray->Entries[ ( LocalIndexEntryIndex + Offset ) & ( LocalIndexEntryArray->Size - 1 ) ].InnerBlock;
-                ValueType&  Value               = *( *DequeueBlock )[ InnerIndex ];
-
-                HAKLE_CONSTEXPR_IF( !std::is_nothrow_assignable<U&, ValueType>::value ) {
-                    struct Guard {
-                        BlockType*                                    Block;
-                        CompressPair<std::size_t, ValueAllocatorType> ValueAllocatorPair;
-
-                        ~Guard() {
-                            ValueAllocatorTraits::Destroy( ValueAllocatorPair.Second(), ( *Block )[ ValueAllocatorPair.First() ] );
-                            Block->SetEmpty( ValueAllocatorPair.First() );
-                        }
-                    } guard{ .Block = DequeueBlock, .ValueAllocatorPair = { InnerIndex, this->ValueAllocator } };
+    private:
+        friend class FastQueue;
 
-                    Element = std::move( Value );
-                }
-                else {
-                    Element = std::move( Value );
-                    ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                    DequeueBlock->SetEmpty( InnerIndex );
+        BlockType*  StartBlock{ nullptr };
+        BlockType*  FirstAllocatedBlock{ nullptr };
+        std::size_t OriginNextIndexEntry{ 0 };
+    };
+
+    // reserves Count slots past the tail for in-place construction, consumers see none of them until Commit
+    // at most one reservation may be open, and no other enqueue may run until it is committed or cancelled
+    template <AllocMode Mode>
+    HAKLE_CPP20_CONSTEXPR bool Reserve( std::size_t Count, Reservation& OutReservation ) {
+        Reservation Result;
+        Result.StartBlock           = this->TailBlock;
+        Result.OriginNextIndexEntry = PO_NextIndexEntry;
+
+        std::size_t StartTailIndex = this->TailIndex.load( std::memory_order_relaxed );
+        if HAKLE_UNLIKELY ( !AcquireBlocks<Mode>( StartTailIndex, Count, Result.FirstAllocatedBlock, Result.OriginNextIndexEntry ) ) {
+            return false;
+        }
+
+        Result.FirstIndex = StartTailIndex & ( BlockSize - 1 );
+        Result.FirstBlock = ( Result.FirstIndex == 0 && Result.FirstAllocatedBlock != nullptr ) ? Result.FirstAllocatedBlock : Result.StartBlock;
+        Result.Count      = Count;
+        OutReservation    = Result;
+        return true;
+    }
+
+    // publishes every slot of InReservation at once, all of them must have been constructed
+    HAKLE_CPP20_CONSTEXPR void Commit( const Reservation& InReservation ) noexcept {
+        if ( InReservation.FirstAllocatedBlock != nullptr ) {
+            this->CurrentIndexEntryArray.load( std::memory_order_relaxed )->Tail.store( ( PO_NextIndexEntry - 1 ) & ( PO_IndexEntriesSize - 1 ), std::memory_order_release );
+        }
+        if ( InReservation.Count != 0 ) {
+            this->StampSlots( InReservation.FirstBlock, InReservation.FirstIndex, InReservation.Count );
+        }
+        this->TailIndex.store( this->TailIndex.load( std::memory_order_relaxed ) + InReservation.Count, std::memory_order_release );
+    }
+
+    // gives the slots back, whatever was constructed in them must be destroyed first
+    HAKLE_CPP20_CONSTEXPR void Cancel( const Reservation& InReservation ) noexcept {
+        if ( InReservation.FirstAllocatedBlock != nullptr ) {
+            BlockType* AllocatedBlock = InReservation.FirstAllocatedBlock;
+            while ( true ) {
+                AllocatedBlock->SetAllEmpty();
+                if ( AllocatedBlock == this->TailBlock ) {
+                    break;
                 }
-                return true;
+                AllocatedBlock = AllocatedBlock->Next;
             }
-
-            this->DequeueFailedCount.fetch_add( 1, std::memory_order_release );
         }
-        return false;
+
+        // when StartBlock is nullptr, we should not go back to prevent block leak
+        PO_NextIndexEntry = InReservation.OriginNextIndexEntry;
+        this->TailBlock   = InReservation.StartBlock == nullptr ? this->TailBlock : InReservation.StartBlock;
     }
 
-    template <HAKLE_CONCEPT( std::output_iterator<ValueType&&> ) Iterator>
-    std::size_t DequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
-        std::size_t FailedCount  = this->DequeueFailedCount.load( std::memory_order_relaxed );
-        std::size_t DesiredCount = this->TailIndex.load( std::memory_order_relaxed ) - ( this->DequeueAttemptsCount.load( std::memory_order_relaxed ) - FailedCount );
-        if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, DesiredCount ) ) ) {
-            DesiredCount = std::min( DesiredCount, MaxCount );
-            // TODO: understand this
-            std::atomic_thread_fence( std::memory_order_acquire );
-
-            std::size_t AttemptsCount = this->DequeueAttemptsCount.fetch_add( DesiredCount, std::memory_order_relaxed );
-            std::size_t ActualCount   = this->TailIndex.load( std::memory_order_acquire ) - ( AttemptsCount - FailedCount );
-            if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, ActualCount ) ) ) {
-                ActualCount = std::min( ActualCount, DesiredCount );
-                if ( ActualCount < DesiredCount ) {
-                    this->DequeueFailedCount.fetch_add( DesiredCount - ActualCount, std::memory_order_release );
+    // like EnqueueBulk, but the elements are moved out of the source range
+    template <AllocMode Mode, HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { ValueType( std::move( *Item ) ); } )
+    HAKLE_CPP20_CONSTEXPR bool EnqueueBulkMove( Iterator ItemFirst, std::size_t Count ) {
+        return EnqueueBulk<Mode>( details::MoveFromIterator<ValueType>( ItemFirst ), Count );
+    }
+
+    // Dequeue
+    // Sojourn, when the blocks are timed, gets the time the element spent in the queue
+    template <class U>
+    constexpr bool Dequeue( U& Element, details::SojournSink* Sojourn = nullptr ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), ValueType&&> ) {
+        // NOTE: getting headIndex must be front of getting CurrentIndexEntryArray
+        // if get CurrentIndexEntryArray first, there is a situation that makes FirstBlockIndexBase larger than IndexEntryTailBase
+        std::size_t Index;
+        if ( this->template ClaimRange<SINGLE_CONSUMER>( 1, Index ) == 0 ) {
+            return false;
+        }
+        std::size_t InnerIndex = Index & ( BlockSize - 1 );
+
+        // we can dequeue
+        IndexEntryArray* LocalIndexEntryArray = this->CurrentIndexEntryArray.load( std::memory_order_acquire );
+        std::size_t      LocalIndexEntryIndex = LocalIndexEntryArray->Tail.load( std::memory_order_acquire );
+
+        std::size_t IndexEntryTailBase  = LocalIndexEntryArray->Entries[ LocalIndexEntryIndex ].Base;
+        std::size_t FirstBlockIndexBase = Index & ~( BlockSize - 1 );
+        std::size_t Offset              = ( FirstBlockIndexBase - IndexEntryTailBase ) >> BlockSizeLog2;
+        BlockType*  DequeueBlock        = LocalIndexEntryArray->Entries[ ( LocalIndexEntryIndex + Offset ) & ( LocalIndexEntryArray->Size - 1 ) ].InnerBlock;
+        ValueType&  Value               = *( *DequeueBlock )[ InnerIndex ];
+        this->RecordSojourn( *DequeueBlock, InnerIndex, InnerIndex + 1, Sojourn );
+
+        HAKLE_CONSTEXPR_IF( !std::is_nothrow_assignable<U&, ValueType>::value ) {
+            struct Guard {
+                BlockType*                                    Block;
+                CompressPair<std::size_t, ValueAllocatorType> ValueAllocatorPair;
+
+                ~Guard() {
+                    ValueAllocatorTraits::Destroy( ValueAllocatorPair.Second(), ( *Block )[ ValueAllocatorPair.First() ] );
+                    Block->SetEmpty( ValueAllocatorPair.First() );
                 }
+            } guard{ .Block = DequeueBlock, .ValueAllocatorPair = { InnerIndex, this->ValueAllocator } };
 
-                std::size_t FirstIndex = this->HeadIndex.fetch_add( ActualCount, std::memory_order_relaxed );
-                std::size_t InnerIndex = FirstIndex & ( BlockSize - 1 );
+            Element = std::move( Value );
+        }
+        else {
+            Element = std::move( Value );
+            ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
+            DequeueBlock->SetEmpty( InnerIndex );
+        }
+        return true;
+    }
 
-                IndexEntryArray* LocalIndexEntriesArray = this->CurrentIndexEntryArray.load( std::memory_order_acquire );
-                std::size_t      LocalIndexEntryIndex   = LocalIndexEntriesArray->Tail.load( std::memory_order_acquire );
+    template <HAKLE_CONCEPT( std::output_iterator<ValueType&&> ) Iterator>
+    std::size_t DequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        return ConsumeBulk( details::MoveToIterator<ValueType>( ItemFirst ), MaxCount );
+    }
 
-                std::size_t IndexEntryTailBase  = LocalIndexEntriesArray->Entries[ LocalIndexEntryIndex ].Base;
-                std::size_t FirstBlockIndexBase = FirstIndex & ~( BlockSize - 1 );
-                std::size_t Offset              = ( FirstBlockIndexBase - IndexEntryTailBase ) >> BlockSizeLog2;
-                BlockType*  FirstDequeueBlock   = LocalIndexEntriesArray->Entries[ ( LocalIndexEntryIndex + Offset ) & ( LocalIndexEntriesArray->Size - 1 ) ].InnerBlock;
+    // hands up to MaxCount elements to Func in place, one by one or span by span, and destroys them after the call
+    // if Func throws, the rest of the claimed elements are destroyed without being visited.
+    // Claimed, if given, is increased by the number of elements taken before Func sees any of them
+    template <class Function>
+    std::size_t ConsumeBulk( Function&& Func, std::size_t MaxCount, details::SojournSink* Sojourn = nullptr, std::size_t* Claimed = nullptr ) {
+        std::size_t FirstIndex;
+        std::size_t ActualCount = this->template ClaimRange<SINGLE_CONSUMER>( MaxCount, FirstIndex );
+        if ( ActualCount == 0 ) {
+            return 0;
+        }
+        if ( Claimed != nullptr ) {
+            *Claimed += ActualCount;
+        }
 
-                BlockType*  DequeueBlock = FirstDequeueBlock;
-                std::size_t StartIndex   = InnerIndex;
-                std::size_t NeedCount    = ActualCount;
-                while ( NeedCount != 0 ) {
-                    std::size_t EndIndex     = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
-                    std::size_t CurrentIndex = StartIndex;
-                    HAKLE_CONSTEXPR_IF( std::is_nothrow_assignable<typename std::iterator_traits<Iterator>::value_type&, ValueType&&>::value ) {
+        std::size_t InnerIndex = FirstIndex & ( BlockSize - 1 );
+
+        IndexEntryArray* LocalIndexEntriesArray = this->CurrentIndexEntryArray.load( std::memory_order_acquire );
+        std::size_t      LocalIndexEntryIndex   = LocalIndexEntriesArray->Tail.load( std::memory_order_acquire );
+
+        std::size_t IndexEntryTailBase  = LocalIndexEntriesArray->Entries[ LocalIndexEntryIndex ].Base;
+        std::size_t FirstBlockIndexBase = FirstIndex & ~( BlockSize - 1 );
+        std::size_t Offset              = ( FirstBlockIndexBase - IndexEntryTailBase ) >> BlockSizeLog2;
+        BlockType*  FirstDequeueBlock   = LocalIndexEntriesArray->Entries[ ( LocalIndexEntryIndex + Offset ) & ( LocalIndexEntriesArray->Size - 1 ) ].InnerBlock;
+
+        BlockType*  DequeueBlock = FirstDequeueBlock;
+        std::size_t StartIndex   = InnerIndex;
+        std::size_t NeedCount    = ActualCount;
+        while ( NeedCount != 0 ) {
+            std::size_t EndIndex     = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
+            std::size_t CurrentIndex = StartIndex;
+            this->RecordSojourn( *DequeueBlock, StartIndex, EndIndex, Sojourn );
+            HAKLE_CONSTEXPR_IF( Base::template IsNothrowConsumer<Function> ) {
+                this->VisitSlots( *DequeueBlock, CurrentIndex, EndIndex, NeedCount, Func );
+            }
+            else {
+                HAKLE_TRY {
+                    this->VisitSlots( *DequeueBlock, CurrentIndex, EndIndex, NeedCount, Func );
+                }
+                HAKLE_CATCH( ... ) {
+                    // we need to destroy all the remaining values
+                    goto Enter;
+                    while ( NeedCount != 0 ) {
+                        EndIndex     = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
+                        CurrentIndex = StartIndex;
+                    Enter:
                         while ( CurrentIndex != EndIndex ) {
                             ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                            *ItemFirst       = std::move( Value );
-                            ++ItemFirst;
                             ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                            ++CurrentIndex;
                             --NeedCount;
+                            ++CurrentIndex;
                         }
+
+                        DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex );
+                        StartIndex   = 0;
+                        DequeueBlock = DequeueBlock->Next;
                     }
-                    else {
-                        HAKLE_TRY {
-                            while ( CurrentIndex != EndIndex ) {
-                                ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                                *ItemFirst++     = std::move( Value );
-                                ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                                ++CurrentIndex;
-                                --NeedCount;
-                            }
-                        }
-                        HAKLE_CATCH( ... ) {
-                            // we need to destroy all the remaining values
-                            goto Enter;
-                            while ( NeedCount != 0 ) {
-                                EndIndex     = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
-                                CurrentIndex = StartIndex;
-                            Enter:
-                                while ( CurrentIndex != EndIndex ) {
-                                    ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                                    ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                                    --NeedCount;
-                                    ++CurrentIndex;
-                                }
-
-                                DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex );
-                                StartIndex   = 0;
-                                DequeueBlock = DequeueBlock->Next;
-                            }
-                            HAKLE_RETHROW;
-                        }
-                    }
-                    BlockType* TempBlock = DequeueBlock;
-                    DequeueBlock         = DequeueBlock->Next;
-                    TempBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex );
-                    StartIndex = 0;
+                    HAKLE_RETHROW;
                 }
-                return ActualCount;
             }
-
-            this->DequeueFailedCount.fetch_add( DesiredCount, std::memory_order_release );
+            BlockType* TempBlock = DequeueBlock;
+            DequeueBlock         = DequeueBlock->Next;
+            TempBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex );
+            StartIndex = 0;
         }
-        return 0;
+        return ActualCount;
     }
 
 private:
+    // links in and indexes the blocks needed for Count slots past StartTailIndex, the index tail is left unpublished
+    // on failure the producer state is rolled back and false is returned
+    template <AllocMode Mode>
+    HAKLE_CPP20_CONSTEXPR bool AcquireBlocks( std::size_t StartTailIndex, std::size_t Count, BlockType*& FirstAllocatedBlock, std::size_t& OriginNextIndexEntry ) {
+        std::size_t OriginIndexEntriesUsed = PO_IndexEntriesUsed;
+        BlockType*  StartBlock             = this->TailBlock;
+
+        auto RollBack = [ this, &OriginNextIndexEntry, &StartBlock ]() -> void {
+            PO_NextIndexEntry = OriginNextIndexEntry;
+            this->TailBlock   = StartBlock;
+        };
+
+        std::size_t LastTailIndex = StartTailIndex - 1;
+        // std::size_t BlockCountNeed =
+        //     ( ( ( Count + LastTailIndex ) & ~( BlockSize - 1 ) ) - ( ( LastTailIndex & ~( BlockSize - 1 ) ) ) ) >> BlockSizeLog2;
+
+        // StartTailIndex - 1 must be signed before shifting
+        std::size_t BlockCountNeed   = ( ( Count + StartTailIndex - 1 ) >> BlockSizeLog2 ) - ( static_cast<std::make_signed_t<std::size_t>>( StartTailIndex - 1 ) >> BlockSizeLog2 );
+        std::size_t CurrentTailIndex = LastTailIndex & ~( BlockSize - 1 );
+
+        if HAKLE_LIKELY ( BlockCountNeed > 0 ) {
+            while ( BlockCountNeed > 0 && this->TailBlock != nullptr && this->TailBlock->Next->IsEmpty() ) {
+                // we can re-use that block
+                --BlockCountNeed;
+                CurrentTailIndex += BlockSize;
+
+                this->TailBlock     = this->TailBlock->Next;
+                FirstAllocatedBlock = FirstAllocatedBlock == nullptr ? this->TailBlock : FirstAllocatedBlock;
+                this->TailBlock->Reset();
+
+                auto& Entry       = this->CurrentIndexEntryArray.load( std::memory_order_relaxed )->Entries[ PO_NextIndexEntry ];
+                Entry.Base        = CurrentTailIndex;
+                Entry.InnerBlock  = this->TailBlock;
+                PO_NextIndexEntry = ( PO_NextIndexEntry + 1 ) & ( PO_IndexEntriesSize - 1 );
+            }
+
+            while ( BlockCountNeed > 0 ) {
+                // we must get a new block
+                --BlockCountNeed;
+                CurrentTailIndex += BlockSize;
+
+                if HAKLE_UNLIKELY ( this->template IsFullAt<MAX_SIZE>( CurrentTailIndex ) ) {
+                    RollBack();
+                    return false;
+                }
+
+                if HAKLE_UNLIKELY ( CurrentIndexEntryArray.load( std::memory_order_relaxed ) == nullptr || PO_IndexEntriesUsed == PO_IndexEntriesSize ) {
+                    // need to create a new index entry array
+                    HAKLE_CONSTEXPR_IF( Mode == AllocMode::CannotAlloc ) {
+                        RollBack();
+                        return false;
+                    }
+                    else if ( !CreateNewBlockIndexArray( OriginIndexEntriesUsed ) ) {
+                        RollBack();
+                        return false;
+                    }
+
+                    OriginNextIndexEntry = OriginIndexEntriesUsed;
+                }
+
+                BlockType* NewBlock = BlockManager->RequisitionBlock( Mode );
+                if HAKLE_UNLIKELY ( NewBlock == nullptr ) {
+                    RollBack();
+                    return false;
+                }
+
+                NewBlock->Reset();
+                if ( this->TailBlock == nullptr ) {
+                    NewBlock->Next = NewBlock;
+                }
+                else {
+                    NewBlock->Next        = this->TailBlock->Next;
+                    this->TailBlock->Next = NewBlock;
+                }
+                this->TailBlock     = NewBlock;
+                FirstAllocatedBlock = FirstAllocatedBlock == nullptr ? this->TailBlock : FirstAllocatedBlock;
+                // get a new block
+                ++PO_IndexEntriesUsed;
+
+                auto& Entry       = this->CurrentIndexEntryArray.load( std::memory_order_relaxed )->Entries[ PO_NextIndexEntry ];
+                Entry.Base        = CurrentTailIndex;
+                Entry.InnerBlock  = this->TailBlock;
+                PO_NextIndexEntry = ( PO_NextIndexEntry + 1 ) & ( PO_IndexEntriesSize - 1 );
+            }
+        }
+
+        return true;
+    }
+
     struct IndexEntry {
         std::size_t Base{ 0 };
         BlockType*  InnerBlock{ nullptr };
@@ -642,7 +1267,7 @@ private:
     std::atomic<IndexEntryArray*> CurrentIndexEntryArray{ nullptr };
 
     // Block Manager
-    BlockManagerType& BlockManager{};
+    BlockManagerType* BlockManager{ nullptr };
 
     std::size_t PO_IndexEntriesUsed{};
     std::size_t PO_IndexEntriesSize{};
@@ -654,10 +1279,10 @@ private:
 };
 
 template <class T, std::size_t BLOCK_SIZE, class Allocator = HakleAllocator<T>, HAKLE_CONCEPT( IsBlockWithMeaningfulSetResult ) BLOCK_TYPE = HakleCounterBlock<T, BLOCK_SIZE>,
-          HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE = HakleBlockManager<BLOCK_TYPE>>
-class SlowQueue : public _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE> {
+          HAKLE_CONCEPT( IsBlockManager ) BLOCK_MANAGER_TYPE = HakleBlockManager<BLOCK_TYPE>, std::size_t MAX_SIZE = UnlimitedSize, bool SINGLE_CONSUMER = false, bool ISOLATED_LAYOUT = false>
+class SlowQueue : public _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE, ISOLATED_LAYOUT> {
 public:
-    using Base = _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE>;
+    using Base = _QueueBase<T, BLOCK_SIZE, Allocator, BLOCK_TYPE, BLOCK_MANAGER_TYPE, ISOLATED_LAYOUT>;
 
     using Base::BlockSize;
     using typename Base::AllocMode;
@@ -683,7 +1308,7 @@ private:
 
 public:
     constexpr SlowQueue( std::size_t InSize, BlockManagerType& InBlockManager, const ValueAllocatorType& InAllocator = ValueAllocatorType{} )
-        : Base( InAllocator ), BlockManager( InBlockManager ), IndexEntryAllocator( IndexEntryAllocatorType( InAllocator ) ), IndexEntryArrayAllocator( IndexEntryArrayAllocatorType( InAllocator ) ),
+        : Base( InAllocator ), BlockManager( &InBlockManager ), IndexEntryAllocator( IndexEntryAllocatorType( InAllocator ) ), IndexEntryArrayAllocator( IndexEntryArrayAllocatorType( InAllocator ) ),
           IndexEntryPointerAllocator( IndexEntryPointerAllocatorType( InAllocator ) ) {
         std::size_t InitialSize = CeilToPow2( InSize ) >> 1;
         if ( InitialSize < 2 ) {
@@ -694,6 +1319,9 @@ public:
         CreateNewBlockIndexArray();
     }
 
+    // the owning queue rebinds its producers after a move or swap
+    constexpr void RebindBlockManager( BlockManagerType& InBlockManager ) noexcept { BlockManager = &InBlockManager; }
+
     HAKLE_CPP20_CONSTEXPR ~SlowQueue() {
         std::size_t Index = this->HeadIndex.load( std::memory_order_relaxed );
         std::size_t Tail  = this->TailIndex.load( std::memory_order_relaxed );
@@ -707,11 +1335,16 @@ public:
             }
             ValueAllocatorTraits::Destroy( this->ValueAllocator, ( *Block )[ InnerIndex ] );
             if ( InnerIndex == BlockSize - 1 || Index == Tail - 1 ) {
-                BlockManager.ReturnBlock( Block );
+                BlockManager->ReturnBlock( Block );
             }
             ++Index;
         }
 
+        // a drained queue still holds its tail block unless the head reached the end of it
+        if ( Block == nullptr && this->TailBlock != nullptr && ( Tail & ( BlockSize - 1 ) ) != 0 ) {
+            BlockManager->ReturnBlock( this->TailBlock );
+        }
+
         // Delete IndexEntryArray
         IndexEntryArray* CurrentArray = CurrentIndexEntryArray.load( std::memory_order_relaxed );
         if ( CurrentArray != nullptr ) {
@@ -738,8 +1371,7 @@ public:
         std::size_t NewTailIndex     = CurrentTailIndex + 1;
         std::size_t InnerIndex       = CurrentTailIndex & ( BlockSize - 1 );
         if HAKLE_UNLIKELY ( InnerIndex == 0 ) {
-            // TODO: add MAX_SIZE check
-            if HAKLE_UNLIKELY ( !CircularLessThan( this->HeadIndex.load( std::memory_order_relaxed ), CurrentTailIndex + BlockSize ) ) {
+            if HAKLE_UNLIKELY ( this->template IsFullAt<MAX_SIZE>( CurrentTailIndex ) ) {
                 return false;
             }
 
@@ -748,7 +1380,7 @@ public:
                 return false;
             }
 
-            BlockType* NewBlock = BlockManager.RequisitionBlock( Mode );
+            BlockType* NewBlock = BlockManager->RequisitionBlock( Mode );
             if HAKLE_UNLIKELY ( NewBlock == nullptr ) {
                 RewindBlockIndexTail();
                 NewIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
@@ -762,7 +1394,7 @@ public:
                 HAKLE_CATCH( ... ) {
                     RewindBlockIndexTail();
                     NewIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
-                    BlockManager.ReturnBlock( NewBlock );
+                    BlockManager->ReturnBlock( NewBlock );
                     HAKLE_RETHROW;
                 }
             }
@@ -772,12 +1404,14 @@ public:
             this->TailBlock = NewBlock;
 
             HAKLE_CONSTEXPR_IF( !std::is_nothrow_constructible<ValueType, Args&&...>::value ) {
+                this->StampSlots( this->TailBlock, InnerIndex, 1 );
                 this->TailIndex.store( NewTailIndex, std::memory_order_release );
                 return true;
             }
         }
 
         ValueAllocatorTraits::Construct( this->ValueAllocator, ( *this->TailBlock )[ InnerIndex ], std::forward<Args>( args )... );
+        this->StampSlots( this->TailBlock, InnerIndex, 1 );
         this->TailIndex.store( NewTailIndex, std::memory_order_release );
         return true;
     }
@@ -785,6 +1419,10 @@ public:
     template <AllocMode Mode, HAKLE_CONCEPT( std::input_iterator ) Iterator>
     HAKLE_REQUIRES( requires( Iterator Item ) { ValueType( *Item ); } )
     HAKLE_CPP20_CONSTEXPR bool EnqueueBulk( Iterator ItemFirst, std::size_t Count ) {
+        if HAKLE_UNLIKELY ( Count == 0 ) {
+            return true;
+        }
+
         std::size_t OriginTailIndex     = this->TailIndex.load( std::memory_order_relaxed );
         BlockType*  OriginTailBlock     = this->TailBlock;
         BlockType*  FirstAllocatedBlock = nullptr;
@@ -799,7 +1437,7 @@ public:
                 RewindBlockIndexTail();
             }
 
-            BlockManager.ReturnBlocks( FirstAllocatedBlock );
+            BlockManager->ReturnBlocks( FirstAllocatedBlock );
             this->TailBlock = OriginTailBlock;
         };
 
@@ -815,9 +1453,8 @@ public:
                 BlockType*  NewBlock      = nullptr;
                 IndexEntry* IndexEntry    = nullptr;
 
-                // TODO: add MAX_SIZE check
-                bool full = !CircularLessThan( this->HeadIndex.load( std::memory_order_relaxed ), CurrentTailIndex + BlockSize );
-                if ( full || !( IndexInserted = InsertBlockIndexEntry<Mode>( IndexEntry, CurrentTailIndex ) ) || !( NewBlock = BlockManager.RequisitionBlock( Mode ) ) ) {
+                bool full = this->template IsFullAt<MAX_SIZE>( CurrentTailIndex );
+                if ( full || !( IndexInserted = InsertBlockIndexEntry<Mode>( IndexEntry, CurrentTailIndex ) ) || !( NewBlock = BlockManager->RequisitionBlock( Mode ) ) ) {
                     if ( IndexInserted ) {
                         RewindBlockIndexTail();
                         IndexEntry->Value.store( nullptr, std::memory_order_relaxed );
@@ -845,9 +1482,15 @@ public:
         std::size_t StartInnerIndex = OriginTailIndex & ( BlockSize - 1 );
         BlockType*  StartBlock      = ( StartInnerIndex == 0 && FirstAllocatedBlock != nullptr ) ? FirstAllocatedBlock : OriginTailBlock;
         BlockType*  CurrentBlock    = StartBlock;
+        this->StampSlots( CurrentBlock, StartInnerIndex, Count );
         while ( true ) {
             std::size_t EndInnerIndex = ( CurrentBlock == this->TailBlock ) ? ( OriginTailIndex + Count - 1 ) & ( BlockSize - 1 ) : ( BlockSize - 1 );
-            HAKLE_CONSTEXPR_IF( std::is_nothrow_constructible<ValueType, typename std::iterator_traits<Iterator>::value_type>::value ) {
+            HAKLE_CONSTEXPR_IF( Base::template CanBlockCopy<Iterator> ) {
+                std::size_t SpanCount = EndInnerIndex + 1 - StartInnerIndex;
+                std::memcpy( ( *CurrentBlock )[ StartInnerIndex ], std::to_address( ItemFirst ), SpanCount * sizeof( ValueType ) );
+                ItemFirst += SpanCount;
+            }
+            else HAKLE_CONSTEXPR_IF( std::is_nothrow_constructible<ValueType, typename std::iterator_traits<Iterator>::value_type>::value ) {
                 while ( StartInnerIndex <= EndInnerIndex ) {
                     ValueAllocatorTraits::Construct( this->ValueAllocator, ( *CurrentBlock )[ StartInnerIndex++ ], *ItemFirst++ );
                 }
@@ -898,145 +1541,129 @@ public:
         return true;
     }
 
-    template <class U>
-    constexpr bool Dequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), ValueType&&> ) {
-        std::size_t FailedCount = this->DequeueFailedCount.load( std::memory_order_relaxed );
-        if ( HAKLE_LIKELY( CircularLessThan( this->DequeueAttemptsCount.load( std::memory_order_relaxed ) - FailedCount, this->TailIndex.load( std::memory_order_relaxed ) ) ) ) {
-            // TODO: understand this
-            std::atomic_thread_fence( std::memory_order_acquire );
-
-            std::size_t AttemptsCount = this->DequeueAttemptsCount.fetch_add( 1, std::memory_order_relaxed );
-            if ( HAKLE_LIKELY( CircularLessThan( AttemptsCount - FailedCount, this->TailIndex.load( std::memory_order_acquire ) ) ) ) {
-                std::size_t Index      = this->HeadIndex.fetch_add( 1, std::memory_order_relaxed );
-                std::size_t InnerIndex = Index & ( BlockSize - 1 );
-
-                IndexEntry* Entry = GetBlockIndexEntryForIndex( Index );
-                BlockType*  Block = Entry->Value.load( std::memory_order_relaxed );
-                ValueType&  Value = *( *Block )[ InnerIndex ];
-
-                HAKLE_CONSTEXPR_IF( !std::is_nothrow_assignable<U, ValueType>::value ) {
-                    struct Guard {
-                        IndexEntry*                                   Entry;
-                        BlockType*                                    Block;
-                        BlockManagerType&                             BlockManager;
-                        CompressPair<std::size_t, ValueAllocatorType> ValueAllocatorPair;
-
-                        ~Guard() {
-                            ValueAllocatorTraits::Destroy( ValueAllocatorPair.Second(), ( *Block )[ ValueAllocatorPair.First() ] );
-                            if ( Block->SetEmpty( ValueAllocatorPair.First() ) ) {
-                                Entry->Value.store( nullptr, std::memory_order_relaxed );
-                                BlockManager.ReturnBlock( Block );
-                            }
-                        }
-                    } guard{ .Entry = Entry, .Block = Block, .BlockManager = BlockManager, .ValueAllocatorPair = { InnerIndex, this->ValueAllocator } };
+    // like EnqueueBulk, but the elements are moved out of the source range
+    template <AllocMode Mode, HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { ValueType( std::move( *Item ) ); } )
+    HAKLE_CPP20_CONSTEXPR bool EnqueueBulkMove( Iterator ItemFirst, std::size_t Count ) {
+        return EnqueueBulk<Mode>( details::MoveFromIterator<ValueType>( ItemFirst ), Count );
+    }
 
-                    Element = std::move( Value );
-                }
-                else {
-                    Element = std::move( Value );
-                    ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                    if ( Block->SetEmpty( InnerIndex ) ) {
+    // Sojourn, when the blocks are timed, gets the time the element spent in the queue
+    template <class U>
+    constexpr bool Dequeue( U& Element, details::SojournSink* Sojourn = nullptr ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), ValueType&&> ) {
+        std::size_t Index;
+        if ( this->template ClaimRange<SINGLE_CONSUMER>( 1, Index ) == 0 ) {
+            return false;
+        }
+        std::size_t InnerIndex = Index & ( BlockSize - 1 );
+
+        IndexEntry* Entry = GetBlockIndexEntryForIndex( Index );
+        BlockType*  Block = Entry->Value.load( std::memory_order_relaxed );
+        ValueType&  Value = *( *Block )[ InnerIndex ];
+        this->RecordSojourn( *Block, InnerIndex, InnerIndex + 1, Sojourn );
+
+        HAKLE_CONSTEXPR_IF( !std::is_nothrow_assignable<U, ValueType>::value ) {
+            struct Guard {
+                IndexEntry*                                   Entry;
+                BlockType*                                    Block;
+                BlockManagerType&                             BlockManager;
+                CompressPair<std::size_t, ValueAllocatorType> ValueAllocatorPair;
+
+                ~Guard() {
+                    ValueAllocatorTraits::Destroy( ValueAllocatorPair.Second(), ( *Block )[ ValueAllocatorPair.First() ] );
+                    if ( Block->SetEmpty( ValueAllocatorPair.First() ) ) {
                         Entry->Value.store( nullptr, std::memory_order_relaxed );
                         BlockManager.ReturnBlock( Block );
                     }
                 }
-                return true;
-            }
+            } guard{ .Entry = Entry, .Block = Block, .BlockManager = *BlockManager, .ValueAllocatorPair = { InnerIndex, this->ValueAllocator } };
 
-            this->DequeueFailedCount.fetch_add( 1, std::memory_order_release );
+            Element = std::move( Value );
         }
-        return false;
+        else {
+            Element = std::move( Value );
+            ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
+            if ( Block->SetEmpty( InnerIndex ) ) {
+                Entry->Value.store( nullptr, std::memory_order_relaxed );
+                BlockManager->ReturnBlock( Block );
+            }
+        }
+        return true;
     }
 
     template <HAKLE_CONCEPT( std::output_iterator<ValueType&&> ) Iterator>
     std::size_t DequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
-        std::size_t FailedCount  = this->DequeueFailedCount.load( std::memory_order_relaxed );
-        std::size_t DesiredCount = this->TailIndex.load( std::memory_order_relaxed ) - ( this->DequeueAttemptsCount.load( std::memory_order_relaxed ) - FailedCount );
-        if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, DesiredCount ) ) ) {
-            DesiredCount = std::min( DesiredCount, MaxCount );
-            // TODO: understand this
-            std::atomic_thread_fence( std::memory_order_acquire );
-
-            std::size_t AttemptsCount = this->DequeueAttemptsCount.fetch_add( DesiredCount, std::memory_order_relaxed );
-            std::size_t ActualCount   = this->TailIndex.load( std::memory_order_acquire ) - ( AttemptsCount - FailedCount );
-            if ( HAKLE_LIKELY( CircularLessThan<std::size_t>( 0, ActualCount ) ) ) {
-                ActualCount = std::min( ActualCount, DesiredCount );
-                if ( ActualCount < DesiredCount ) {
-                    this->DequeueFailedCount.fetch_add( DesiredCount - ActualCount, std::memory_order_release );
-                }
-
-                std::size_t Index      = this->HeadIndex.fetch_add( ActualCount, std::memory_order_relaxed );
-                std::size_t InnerIndex = Index & ( BlockSize - 1 );
+        return ConsumeBulk( details::MoveToIterator<ValueType>( ItemFirst ), MaxCount );
+    }
 
-                std::size_t StartIndex = InnerIndex;
-                std::size_t NeedCount  = ActualCount;
+    // hands up to MaxCount elements to Func in place, one by one or span by span, and destroys them after the call
+    // if Func throws, the rest of the claimed elements are destroyed without being visited.
+    // Claimed, if given, is increased by the number of elements taken before Func sees any of them
+    template <class Function>
+    std::size_t ConsumeBulk( Function&& Func, std::size_t MaxCount, details::SojournSink* Sojourn = nullptr, std::size_t* Claimed = nullptr ) {
+        std::size_t Index;
+        std::size_t ActualCount = this->template ClaimRange<SINGLE_CONSUMER>( MaxCount, Index );
+        if ( ActualCount == 0 ) {
+            return 0;
+        }
+        if ( Claimed != nullptr ) {
+            *Claimed += ActualCount;
+        }
 
-                IndexEntryArray* LocalIndexEntryArray;
-                std::size_t      IndexEntryIndex = GetBlockIndexIndexForIndex( Index, LocalIndexEntryArray );
-                while ( NeedCount != 0 ) {
-                    IndexEntry* DequeueIndexEntry = LocalIndexEntryArray->Index[ IndexEntryIndex ];
-                    BlockType*  DequeueBlock      = DequeueIndexEntry->Value.load( std::memory_order_relaxed );
-                    std::size_t EndIndex          = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
-                    std::size_t CurrentIndex      = StartIndex;
-                    HAKLE_CONSTEXPR_IF( std::is_nothrow_assignable<typename std::iterator_traits<Iterator>::value_type, ValueType&&>::value ) {
+        std::size_t InnerIndex = Index & ( BlockSize - 1 );
+
+        std::size_t StartIndex = InnerIndex;
+        std::size_t NeedCount  = ActualCount;
+
+        IndexEntryArray* LocalIndexEntryArray;
+        std::size_t      IndexEntryIndex = GetBlockIndexIndexForIndex( Index, LocalIndexEntryArray );
+        while ( NeedCount != 0 ) {
+            IndexEntry* DequeueIndexEntry = LocalIndexEntryArray->Index[ IndexEntryIndex ];
+            BlockType*  DequeueBlock      = DequeueIndexEntry->Value.load( std::memory_order_relaxed );
+            std::size_t EndIndex          = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
+            std::size_t CurrentIndex      = StartIndex;
+            this->RecordSojourn( *DequeueBlock, StartIndex, EndIndex, Sojourn );
+            HAKLE_CONSTEXPR_IF( Base::template IsNothrowConsumer<Function> ) {
+                this->VisitSlots( *DequeueBlock, CurrentIndex, EndIndex, NeedCount, Func );
+            }
+            else {
+                HAKLE_TRY {
+                    this->VisitSlots( *DequeueBlock, CurrentIndex, EndIndex, NeedCount, Func );
+                }
+                HAKLE_CATCH( ... ) {
+                    // we need to destroy all the remaining values
+                    goto Enter;
+                    while ( NeedCount != 0 ) {
+                        DequeueIndexEntry = LocalIndexEntryArray->Index[ IndexEntryIndex ];
+                        DequeueBlock      = DequeueIndexEntry->Value.load( std::memory_order_relaxed );
+                        EndIndex          = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
+                        CurrentIndex      = StartIndex;
+                    Enter:
                         while ( CurrentIndex != EndIndex ) {
                             ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                            *ItemFirst       = std::move( Value );
-                            ++ItemFirst;
                             ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                            ++CurrentIndex;
                             --NeedCount;
+                            ++CurrentIndex;
                         }
-                    }
-                    else {
-                        HAKLE_TRY {
-                            while ( CurrentIndex != EndIndex ) {
-                                ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                                *ItemFirst++     = std::move( Value );
-                                ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                                ++CurrentIndex;
-                                --NeedCount;
-                            }
-                        }
-                        HAKLE_CATCH( ... ) {
-                            // we need to destroy all the remaining values
-                            goto Enter;
-                            while ( NeedCount != 0 ) {
-                                DequeueIndexEntry = LocalIndexEntryArray->Index[ IndexEntryIndex ];
-                                DequeueBlock      = DequeueIndexEntry->Value.load( std::memory_order_relaxed );
-                                EndIndex          = ( NeedCount > ( BlockSize - StartIndex ) ) ? BlockSize : ( NeedCount + StartIndex );
-                                CurrentIndex      = StartIndex;
-                            Enter:
-                                while ( CurrentIndex != EndIndex ) {
-                                    ValueType& Value = *( *DequeueBlock )[ CurrentIndex ];
-                                    ValueAllocatorTraits::Destroy( this->ValueAllocator, &Value );
-                                    --NeedCount;
-                                    ++CurrentIndex;
-                                }
-
-                                if ( DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex ) ) {
-                                    DequeueIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
-                                    BlockManager.ReturnBlock( DequeueBlock );
-                                }
-                                StartIndex      = 0;
-                                IndexEntryIndex = ( IndexEntryIndex + 1 ) & ( LocalIndexEntryArray->Size - 1 );
-                            }
-                            HAKLE_RETHROW;
+
+                        if ( DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex ) ) {
+                            DequeueIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
+                            BlockManager->ReturnBlock( DequeueBlock );
                         }
+                        StartIndex      = 0;
+                        IndexEntryIndex = ( IndexEntryIndex + 1 ) & ( LocalIndexEntryArray->Size - 1 );
                     }
-                    if ( DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex ) ) {
-                        DequeueIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
-                        BlockManager.ReturnBlock( DequeueBlock );
-                    }
-                    StartIndex      = 0;
-                    IndexEntryIndex = ( IndexEntryIndex + 1 ) & ( LocalIndexEntryArray->Size - 1 );
+                    HAKLE_RETHROW;
                 }
-                return ActualCount;
             }
-
-            this->DequeueFailedCount.fetch_add( DesiredCount, std::memory_order_release );
+            if ( DequeueBlock->SetSomeEmpty( StartIndex, EndIndex - StartIndex ) ) {
+                DequeueIndexEntry->Value.store( nullptr, std::memory_order_relaxed );
+                BlockManager->ReturnBlock( DequeueBlock );
+            }
+            StartIndex      = 0;
+            IndexEntryIndex = ( IndexEntryIndex + 1 ) & ( LocalIndexEntryArray->Size - 1 );
         }
-        return 0;
+        return ActualCount;
     }
 
 private:
@@ -1159,7 +1786,7 @@ private:
     }
 
     std::atomic<IndexEntryArray*> CurrentIndexEntryArray{};
-    BlockManagerType&             BlockManager;
+    BlockManagerType*             BlockManager{ nullptr };
     std::size_t                   IndexEntriesSize{};
 
     [[no_unique_address]] IndexEntryAllocatorType        IndexEntryAllocator{};
@@ -1199,6 +1826,39 @@ struct ConcurrentQueueDefaultTraits {
     static constexpr std::size_t InitialExplicitQueueSize = 32;
     static constexpr std::size_t InitialImplicitQueueSize = 32;
 
+    // per producer limit, rounded up to whole blocks; enqueue fails once a producer would need a block beyond it
+    static constexpr std::size_t MaxSubQueueSize = UnlimitedSize;
+    // limit on the whole queue, anything but UnlimitedSize adds a shared counter to every enqueue and dequeue
+    static constexpr std::size_t MaxCapacity = UnlimitedSize;
+    // promise that at most one thread dequeues at a time, sub-queues then claim elements without read-modify-write atomics
+    static constexpr bool SingleConsumer = false;
+    // ConsumerToken consumers advance the shared rotation after taking this many items from one producer
+    static constexpr std::size_t ConsumerRotationQuota = 256;
+    // scale the quota with the depth of the producer a consumer settles on, see ConcurrentQueue::RotationQuotaFor
+    static constexpr bool AdaptiveRotationQuota = false;
+    // tokenless TryDequeue samples two random non-empty producers and takes the larger one,
+    // instead of every consumer scanning the first three from the head of the registry
+    static constexpr bool RandomProducerSelection = false;
+    // unlink explicit producers whose token is gone once they are drained, and free their sub-queue;
+    // consumers then pin an epoch on every dequeue, see details::EpochDomain
+    static constexpr bool ReclaimInactiveProducers = false;
+    // keep each sub-queue's producer and consumer fields on separate cache lines, trading about one cache line
+    // per producer for no false sharing between the enqueuing thread and the dequeuers
+    static constexpr bool CacheLineIsolatedLayout = false;
+    // let a sleeping consumer be woken through a callback (e.g. an eventfd) when the queue stops being empty,
+    // see ConcurrentQueue::ArmNotifier; when off, enqueue does not even look at the notifier
+    static constexpr bool ReadinessNotification = false;
+    // once a producer holds this many blocks of elements, its later elements go to spill segment files until
+    // consumers have read all of them back, see SpillStore.h; 0 leaves spilling off. needs a trivially copyable T
+    static constexpr std::size_t SpillBlockBudget = 0;
+    // bytes per spill segment file, and where the (unnamed) files are created, better not a tmpfs
+    static constexpr std::size_t SpillSegmentSize = 1 << 20;
+    static constexpr const char* SpillDirectory   = "/var/tmp";
+    // stamp every element with its enqueue time and record its time in the queue on dequeue, per consumer thread,
+    // see ConcurrentQueue::GetSojournHistogram. needs the timestamped block types below, SojournTimingTraits has them;
+    // spilled elements are not timed
+    static constexpr bool SojournTiming = false;
+
     using AllocatorType = Allocator;
 
     using ExplicitBlockType = HakleFlagsBlock<T, BlockSize>;
@@ -1217,11 +1877,93 @@ struct ConcurrentQueueDefaultTraits {
     static ImplicitBlockManagerType MakeImplicitBlockManager( const ExplicitAllocatorType& InAllocator, std::size_t BlockPoolSize ) { return ImplicitBlockManagerType( BlockPoolSize, InAllocator ); }
 };
 
+// the size limits, SingleConsumer, the rotation quota, the producer policies, the layout, the notifier, the spill settings and SojournTiming are optional in custom traits
+template <class Traits, class = void>
+struct TraitsMaxSubQueueSize : std::integral_constant<std::size_t, UnlimitedSize> {};
+
+template <class Traits>
+struct TraitsMaxSubQueueSize<Traits, std::void_t<decltype( Traits::MaxSubQueueSize )>> : std::integral_constant<std::size_t, Traits::MaxSubQueueSize> {};
+
+template <class Traits, class = void>
+struct TraitsMaxCapacity : std::integral_constant<std::size_t, UnlimitedSize> {};
+
+template <class Traits>
+struct TraitsMaxCapacity<Traits, std::void_t<decltype( Traits::MaxCapacity )>> : std::integral_constant<std::size_t, Traits::MaxCapacity> {};
+
+template <class Traits, class = void>
+struct TraitsSingleConsumer : std::false_type {};
+
+template <class Traits>
+struct TraitsSingleConsumer<Traits, std::void_t<decltype( Traits::SingleConsumer )>> : std::bool_constant<Traits::SingleConsumer> {};
+
+template <class Traits, class = void>
+struct TraitsConsumerRotationQuota : std::integral_constant<std::size_t, 256> {};
+
+template <class Traits>
+struct TraitsConsumerRotationQuota<Traits, std::void_t<decltype( Traits::ConsumerRotationQuota )>> : std::integral_constant<std::size_t, Traits::ConsumerRotationQuota> {};
+
+template <class Traits, class = void>
+struct TraitsAdaptiveRotationQuota : std::false_type {};
+
+template <class Traits>
+struct TraitsAdaptiveRotationQuota<Traits, std::void_t<decltype( Traits::AdaptiveRotationQuota )>> : std::bool_constant<Traits::AdaptiveRotationQuota> {};
+
+template <class Traits, class = void>
+struct TraitsRandomProducerSelection : std::false_type {};
+
+template <class Traits>
+struct TraitsRandomProducerSelection<Traits, std::void_t<decltype( Traits::RandomProducerSelection )>> : std::bool_constant<Traits::RandomProducerSelection> {};
+
+template <class Traits, class = void>
+struct TraitsReclaimInactiveProducers : std::false_type {};
+
+template <class Traits>
+struct TraitsReclaimInactiveProducers<Traits, std::void_t<decltype( Traits::ReclaimInactiveProducers )>> : std::bool_constant<Traits::ReclaimInactiveProducers> {};
+
+template <class Traits, class = void>
+struct TraitsCacheLineIsolatedLayout : std::false_type {};
+
+template <class Traits>
+struct TraitsCacheLineIsolatedLayout<Traits, std::void_t<decltype( Traits::CacheLineIsolatedLayout )>> : std::bool_constant<Traits::CacheLineIsolatedLayout> {};
+
+template <class Traits, class = void>
+struct TraitsReadinessNotification : std::false_type {};
+
+template <class Traits>
+struct TraitsReadinessNotification<Traits, std::void_t<decltype( Traits::ReadinessNotification )>> : std::bool_constant<Traits::ReadinessNotification> {};
+
+template <class Traits, class = void>
+struct TraitsSpillBlockBudget : std::integral_constant<std::size_t, 0> {};
+
+template <class Traits>
+struct TraitsSpillBlockBudget<Traits, std::void_t<decltype( Traits::SpillBlockBudget )>> : std::integral_constant<std::size_t, Traits::SpillBlockBudget> {};
+
+template <class Traits, class = void>
+struct TraitsSpillSegmentSize : std::integral_constant<std::size_t, 1 << 20> {};
+
+template <class Traits>
+struct TraitsSpillSegmentSize<Traits, std::void_t<decltype( Traits::SpillSegmentSize )>> : std::integral_constant<std::size_t, Traits::SpillSegmentSize> {};
+
+template <class Traits, class = void>
+struct TraitsSpillDirectory {
+    static constexpr const char* value = "/var/tmp";
+};
+
+template <class Traits>
+struct TraitsSpillDirectory<Traits, std::void_t<decltype( Traits::SpillDirectory )>> {
+    static constexpr const char* value = Traits::SpillDirectory;
+};
+
+template <class Traits, class = void>
+struct TraitsSojournTiming : std::false_type {};
+
+template <class Traits>
+struct TraitsSojournTiming<Traits, std::void_t<decltype( Traits::SojournTiming )>> : std::bool_constant<Traits::SojournTiming> {};
+
 template <class T, class Allocator = HakleAllocator<T>, HAKLE_CONCEPT( IsConcurrentQueueTraits ) Traits = ConcurrentQueueDefaultTraits<T, Allocator>>
 class ConcurrentQueue : private Traits {
 private:
     struct ProducerListNode;
-    static constexpr std::size_t EXPLICIT_CONSUMER_CONSUMPTION_QUOTA_BEFORE_ROTATE = 256;
 
 public:
     struct ProducerToken;
@@ -1233,6 +1975,29 @@ public:
     using Traits::InitialHashSize;
     using Traits::InitialImplicitQueueSize;
 
+    static constexpr std::size_t MaxSubQueueSize = TraitsMaxSubQueueSize<Traits>::value;
+    static constexpr std::size_t MaxCapacity     = TraitsMaxCapacity<Traits>::value;
+    static constexpr bool        SingleConsumer  = TraitsSingleConsumer<Traits>::value;
+
+    static constexpr std::size_t ConsumerRotationQuota = TraitsConsumerRotationQuota<Traits>::value;
+    static constexpr bool        AdaptiveRotationQuota = TraitsAdaptiveRotationQuota<Traits>::value;
+    static constexpr bool        RandomProducerSelection = TraitsRandomProducerSelection<Traits>::value;
+    static constexpr bool        ReclaimInactiveProducers = TraitsReclaimInactiveProducers<Traits>::value;
+    static constexpr bool        CacheLineIsolatedLayout  = TraitsCacheLineIsolatedLayout<Traits>::value;
+    static constexpr bool        ReadinessNotification    = TraitsReadinessNotification<Traits>::value;
+    static constexpr std::size_t SpillBlockBudget         = TraitsSpillBlockBudget<Traits>::value;
+    static constexpr std::size_t SpillSegmentSize         = TraitsSpillSegmentSize<Traits>::value;
+    static constexpr bool        SpillToDisk              = SpillBlockBudget != 0;
+    static constexpr bool        SojournTiming            = TraitsSojournTiming<Traits>::value;
+    // a reclaim pass runs every this many released producer tokens
+    static constexpr std::uint32_t ProducerReclaimInterval = 64;
+    static_assert( ConsumerRotationQuota > 0 && ConsumerRotationQuota <= std::numeric_limits<std::uint32_t>::max() / 16, "ConsumerRotationQuota out of range" );
+#if defined( __linux__ )
+    static_assert( !SpillToDisk || std::is_trivially_copyable<T>::value, "SpillBlockBudget needs a trivially copyable T" );
+#else
+    static_assert( !SpillToDisk, "SpillBlockBudget needs Linux" );
+#endif
+
     using typename Traits::ExplicitBlockType;
     using typename Traits::ImplicitBlockType;
 
@@ -1243,13 +2008,16 @@ public:
     using typename Traits::ExplicitBlockManagerType;
     using typename Traits::ImplicitBlockManagerType;
 
+    static_assert( SojournTiming == details::HasStamps<ExplicitBlockType> && SojournTiming == details::HasStamps<ImplicitBlockType>,
+                   "SojournTiming goes together with timestamped block types, see SojournTimingTraits" );
+
     using Traits::MakeDefaultExplicitBlockManager;
     using Traits::MakeDefaultImplicitBlockManager;
 
     using BaseProducer = _QueueTypelessBase;
 
-    using ExplicitProducer = FastQueue<T, BlockSize, Allocator, ExplicitBlockType, ExplicitBlockManagerType>;
-    using ImplicitProducer = SlowQueue<T, BlockSize, Allocator, ImplicitBlockType, ImplicitBlockManagerType>;
+    using ExplicitProducer = FastQueue<T, BlockSize, Allocator, ExplicitBlockType, ExplicitBlockManagerType, MaxSubQueueSize, SingleConsumer, CacheLineIsolatedLayout>;
+    using ImplicitProducer = SlowQueue<T, BlockSize, Allocator, ImplicitBlockType, ImplicitBlockManagerType, MaxSubQueueSize, SingleConsumer, CacheLineIsolatedLayout>;
 
     using ExplicitProducerAllocatorTraits = typename HakeAllocatorTraits<AllocatorType>::template RebindTraits<ExplicitProducer>;
     using ImplicitProducerAllocatorTraits = typename HakeAllocatorTraits<AllocatorType>::template RebindTraits<ImplicitProducer>;
@@ -1290,15 +2058,29 @@ public:
     HAKLE_CPP20_CONSTEXPR ~ConcurrentQueue() { ClearList(); }
 
     explicit constexpr ConcurrentQueue( ConcurrentQueue&& Other ) noexcept
-        : ProducerListsHead( std::move( Other.ProducerListsHead ) ), ProducerCount( std::move( Other.ProducerCount.load( std::memory_order_relaxed ) ) ),
-          NextExplicitConsumerId( std::move( Other.NextExplicitConsumerId.load( std::memory_order_relaxed ) ) ),
-          GlobalExplicitConsumerOffset( std::move( Other.GlobalExplicitConsumerOffset.load( std::memory_order_relaxed ) ) ), ExplicitManager( std::move( Other.ExplicitManager ) ),
-          ImplicitManager( std::move( Other.ImplicitManager ) ), ExplicitProducerAllocator( std::move( Other.ExplicitProducerAllocator ) ),
-          ImplicitProducerAllocator( std::move( Other.ImplicitProducerAllocator ) ), ValueAllocator( std::move( Other.ValueAllocatorPair ) ),
-          ProducerListNodeAllocator( std::move( Other.ProducerListNodeAllocator ) ), ImplicitMap( std::move( Other.ImplicitMap ) ) {
+        : ProducerListsHead( Other.ProducerListsHead.load( std::memory_order_relaxed ) ), ProducerCount( Other.ProducerCount.load( std::memory_order_relaxed ) ),
+          ExplicitManager( std::move( Other.ExplicitManager ) ), ImplicitManager( std::move( Other.ImplicitManager ) ),
+          GlobalExplicitConsumerOffset( Other.GlobalExplicitConsumerOffset.load( std::memory_order_relaxed ) ),
+          NextExplicitConsumerId( Other.NextExplicitConsumerId.load( std::memory_order_relaxed ) ), ExplicitProducerAllocator( std::move( Other.ExplicitProducerAllocator ) ),
+          ImplicitProducerAllocator( std::move( Other.ImplicitProducerAllocator ) ), ValueAllocator( std::move( Other.ValueAllocator ) ),
+          ProducerListNodeAllocator( std::move( Other.ProducerListNodeAllocator ) ), QueueId( Other.QueueId ) {
+        // swap rather than move so Other is left with an empty but usable map
+        ImplicitMap.swap( Other.ImplicitMap );
+        NonEmptyIndex.swap( Other.NonEmptyIndex );
+        Registry.swap( Other.Registry );
+        InactiveExplicitNodes = std::move( Other.InactiveExplicitNodes );
+        InactiveImplicitNodes = std::move( Other.InactiveImplicitNodes );
+        // the producers move with the id, so thread caches stay valid for this queue and miss for Other
+        Other.QueueId = details::NextQueueId();
+        UsedCapacity.store( Other.UsedCapacity.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        Other.UsedCapacity.store( 0, std::memory_order_relaxed );
         Other.ProducerListsHead.store( nullptr, std::memory_order_relaxed );
         Other.ProducerCount.store( 0, std::memory_order_relaxed );
         Other.GlobalExplicitConsumerOffset = Other.NextExplicitConsumerId = 0;
+        TakeReclaimState( Other );
+        // the consumer watching these elements follows them
+        HAKLE_CONSTEXPR_IF( ReadinessNotification ) { Notifier.swap( Other.Notifier ); }
+        HAKLE_CONSTEXPR_IF( SojournTiming ) { SojournHistograms.swap( Other.SojournHistograms ); }
         ReclaimProducerLists();
     }
 
@@ -1312,11 +2094,33 @@ public:
         ImplicitProducerAllocator = std::move( Other.ImplicitProducerAllocator );
         ValueAllocator            = std::move( Other.ValueAllocator );
         ProducerListNodeAllocator = std::move( Other.ProducerListNodeAllocator );
-        ImplicitMap               = std::move( Other.ImplicitMap );
-
+        QueueId                   = Other.QueueId;
+
+        ImplicitMap.swap( Other.ImplicitMap );
+        Other.ImplicitMap = ImplicitMapType{ details::invalid_thread_id, details::invalid_thread_id2 };
+        NonEmptyIndex.Clear();
+        NonEmptyIndex.swap( Other.NonEmptyIndex );
+        Registry.Clear();
+        Registry.swap( Other.Registry );
+        InactiveExplicitNodes = std::move( Other.InactiveExplicitNodes );
+        InactiveImplicitNodes = std::move( Other.InactiveImplicitNodes );
+
+        Other.QueueId = details::NextQueueId();
+        UsedCapacity.store( Other.UsedCapacity.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        Other.UsedCapacity.store( 0, std::memory_order_relaxed );
         Other.ProducerListsHead.store( nullptr, std::memory_order_relaxed );
         Other.ProducerCount.store( 0, std::memory_order_relaxed );
         Other.GlobalExplicitConsumerOffset = Other.NextExplicitConsumerId = 0;
+        TakeReclaimState( Other );
+        HAKLE_CONSTEXPR_IF( ReadinessNotification ) {
+            Notifier.swap( Other.Notifier );
+            Other.Notifier.Bind( nullptr, nullptr );
+        }
+        // ours were recorded under the id this queue just gave up
+        HAKLE_CONSTEXPR_IF( SojournTiming ) {
+            SojournHistograms.Clear();
+            SojournHistograms.swap( Other.SojournHistograms );
+        }
 
         ReclaimProducerLists();
         return *this;
@@ -1330,6 +2134,7 @@ public:
         core::SwapRelaxed( ProducerCount, Other.ProducerCount );
         core::SwapRelaxed( NextExplicitConsumerId, Other.NextExplicitConsumerId );
         core::SwapRelaxed( GlobalExplicitConsumerOffset, Other.GlobalExplicitConsumerOffset );
+        core::SwapRelaxed( UsedCapacity, Other.UsedCapacity );
 
         using std::swap;
         swap( ExplicitManager, Other.ExplicitManager );
@@ -1339,16 +2144,119 @@ public:
         swap( ValueAllocator, Other.ValueAllocator );
         swap( ProducerListNodeAllocator, Other.ProducerListNodeAllocator );
         swap( ImplicitMap, Other.ImplicitMap );
+        swap( QueueId, Other.QueueId );
+        swap( RetiredNodes, Other.RetiredNodes );
+        swap( FreeNodes, Other.FreeNodes );
+        core::SwapRelaxed( ListGeneration, Other.ListGeneration );
+        NonEmptyIndex.swap( Other.NonEmptyIndex );
+        Registry.swap( Other.Registry );
+        swap( InactiveExplicitNodes, Other.InactiveExplicitNodes );
+        swap( InactiveImplicitNodes, Other.InactiveImplicitNodes );
+        HAKLE_CONSTEXPR_IF( ReadinessNotification ) { Notifier.swap( Other.Notifier ); }
+        HAKLE_CONSTEXPR_IF( SojournTiming ) { SojournHistograms.swap( Other.SojournHistograms ); }
+
+        ReclaimProducerLists();
+        Other.ReclaimProducerLists();
+    }
+
+    // NOTE: not thread safe, only for moves; our own retired and free nodes must be cleared already
+    constexpr void TakeReclaimState( ConcurrentQueue& Other ) noexcept {
+        RetiredNodes = std::exchange( Other.RetiredNodes, nullptr );
+        FreeNodes    = std::exchange( Other.FreeNodes, nullptr );
+        ListGeneration.store( Other.ListGeneration.load( std::memory_order_relaxed ), std::memory_order_relaxed );
     }
 
     constexpr void ClearList() noexcept {
+        // the free lists only link nodes, forget them before the nodes go away
+        InactiveExplicitNodes = InactiveNodeList{};
+        InactiveImplicitNodes = InactiveNodeList{};
         ForEachProducerSafe( [ this ]( ProducerListNode* Node ) { DeleteProducerListNode( Node ); } );
+        for ( ProducerListNode* Nodes : { RetiredNodes, FreeNodes } ) {
+            while ( Nodes != nullptr ) {
+                ProducerListNode* Next = Nodes->RetiredNext;
+                DeleteProducerListNode( Nodes );
+                Nodes = Next;
+            }
+        }
+        RetiredNodes = FreeNodes = nullptr;
     }
 
     constexpr ProducerToken GetProducerToken() noexcept { return ProducerToken( *this ); }
     constexpr ConsumerToken GetConsumerToken() noexcept { return ConsumerToken( *this ); }
 
-    template <class... Args>
+    enum class ProducerType { Explicit, Implicit };
+
+    struct ProducerDepth {
+        std::size_t  Depth{ 0 };
+        ProducerType Type{ ProducerType::Explicit };
+        bool         Active{ true };  // false once its token is gone or its thread has exited
+    };
+
+    // sum of the sub-queue sizes, O(producers), only exact while no one enqueues or dequeues
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept {
+        [[maybe_unused]] ReclaimGuard Guard;
+        std::size_t                   Size = 0;
+        for ( const ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr; Node = Node->GetNext() ) {
+            Size += Node->GetProducerSize();
+        }
+        return Size;
+    }
+
+    // readiness notification, needs ReadinessNotification in the traits. Callback( UserData ) runs on an enqueuing
+    // thread for the first element published after ArmNotifier, e.g. EventFdNotifier::Signal.
+    // NOTE: not thread safe, set it before the queue is shared
+    void SetNotifier( ReadinessNotifier::CallbackType Callback, void* UserData ) noexcept {
+        static_assert( ReadinessNotification, "SetNotifier needs ReadinessNotification in the traits" );
+        Notifier.Bind( Callback, UserData );
+    }
+
+    // consumer side, call after TryDequeue came back empty and before going to sleep.
+    // true: sleep, the callback fires (or already fired) for the next element; false: elements arrived, keep dequeuing
+    bool ArmNotifier() {
+        static_assert( ReadinessNotification, "ArmNotifier needs ReadinessNotification in the traits" );
+        return Notifier.Arm( [ this ]() { return SizeApprox() == 0; } );
+    }
+
+    // still armed means nothing was enqueued since the last successful ArmNotifier
+    HAKLE_NODISCARD bool IsNotifierArmed() const noexcept {
+        static_assert( ReadinessNotification, "IsNotifierArmed needs ReadinessNotification in the traits" );
+        return Notifier.IsArmed();
+    }
+
+    // SojournTiming: how long the elements dequeued so far spent in the queue, in nanoseconds from enqueue to dequeue,
+    // all consumer threads merged. consumers may keep going meanwhile, the copy is then a little behind
+    HAKLE_NODISCARD LogLinearHistogram GetSojournHistogram() const noexcept {
+        static_assert( SojournTiming, "GetSojournHistogram needs SojournTiming in the traits" );
+        return SojournHistograms.Merged();
+    }
+
+    // one entry per producer, newest first; depths are read one by one, not atomically as a whole
+    HAKLE_NODISCARD std::vector<ProducerDepth> GetProducerDepths() const {
+        [[maybe_unused]] ReclaimGuard Guard;
+        std::vector<ProducerDepth>    Depths;
+        Depths.reserve( ProducerCount.load( std::memory_order_relaxed ) );
+        for ( const ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr; Node = Node->GetNext() ) {
+            Depths.push_back( ProducerDepth{ Node->GetProducerSize(), Node->Type, !Node->Inactive.load( std::memory_order_relaxed ) } );
+        }
+        return Depths;
+    }
+
+    // unlinks drained explicit producers whose token is gone, and frees the sub-queues of those unlinked earlier
+    // that no consumer can still see; returns how many sub-queues were freed. Also runs every
+    // ProducerReclaimInterval released tokens. Returns 0 if another thread is already reclaiming
+    std::size_t CollectInactiveProducers() {
+        HAKLE_CONSTEXPR_IF( !ReclaimInactiveProducers ) { return 0; }
+        else {
+            std::unique_lock<std::mutex> Lock( ReclaimMutex, std::try_to_lock );
+            if ( !Lock.owns_lock() ) {
+                return 0;
+            }
+            UnlinkInactiveProducers();
+            return FreeRetiredProducers();
+        }
+    }
+
+    template <class... Args>
     HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
     constexpr bool EnqueueWithToken( const ProducerToken& Token, Args&&... args ) {
         return InnerEnqueueWithToken<AllocMode::CanAlloc>( Token, std::forward<Args>( args )... );
@@ -1373,6 +2281,19 @@ public:
         return InnerEnqueueBulk<AllocMode::CanAlloc>( ItermFirst, Count );
     }
 
+    // like EnqueueBulk, but the elements are moved out of the source range
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( std::move( *Item ) ); } )
+    constexpr bool EnqueueBulkMove( const ProducerToken& Token, Iterator ItermFirst, std::size_t Count ) {
+        return InnerEnqueueBulk<AllocMode::CanAlloc>( Token, details::MoveFromIterator<T>( ItermFirst ), Count );
+    }
+
+    template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
+    HAKLE_REQUIRES( requires( Iterator Item ) { T( std::move( *Item ) ); } )
+    constexpr bool EnqueueBulkMove( Iterator ItermFirst, std::size_t Count ) {
+        return InnerEnqueueBulk<AllocMode::CanAlloc>( details::MoveFromIterator<T>( ItermFirst ), Count );
+    }
+
     template <class... Args>
     HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
     constexpr bool TryEnqueue( Args&&... args ) {
@@ -1384,7 +2305,7 @@ public:
     template <class... Args>
     HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
     constexpr bool TryEnqueue( const ProducerToken& Token, Args&&... args ) {
-        return InnerEnqueue<AllocMode::CannotAlloc>( Token, std::forward<Args>( args )... );
+        return InnerEnqueueWithToken<AllocMode::CannotAlloc>( Token, std::forward<Args>( args )... );
     }
 
     template <HAKLE_CONCEPT( std::input_iterator ) Iterator>
@@ -1399,12 +2320,40 @@ public:
         return InnerEnqueueBulk<AllocMode::CannotAlloc>( ItermFirst, Count );
     }
 
+    using Reservation = typename ExplicitProducer::Reservation;
+
+    // in-place bulk enqueue on the token's producer: construct T in every slot of the reserved spans,
+    // then Commit publishes them all at once (or Cancel gives them back)
+    constexpr bool Reserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) {
+        return InnerReserve<AllocMode::CanAlloc>( Token, Count, OutReservation );
+    }
+
+    constexpr bool TryReserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) {
+        return InnerReserve<AllocMode::CannotAlloc>( Token, Count, OutReservation );
+    }
+
+    constexpr void Commit( const ProducerToken& Token, const Reservation& InReservation ) noexcept {
+        Token.ProducerNode->GetExplicitProducer()->Commit( InReservation );
+        if ( InReservation.Count != 0 ) {
+            MarkNonEmpty( Token.ProducerNode );
+        }
+    }
+
+    constexpr void Cancel( const ProducerToken& Token, const Reservation& InReservation ) noexcept {
+        Token.ProducerNode->GetExplicitProducer()->Cancel( InReservation );
+        ReleaseCapacity( InReservation.Count );
+    }
+
+    // only producers marked in NonEmptyIndex are visited, see ProducerIndex.h
     template <class U>
     constexpr bool TryDequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        [[maybe_unused]] ReclaimGuard Guard;
+        HAKLE_CONSTEXPR_IF( RandomProducerSelection ) { return TryDequeueTwoChoices( Element ); }
+
         std::size_t       NonEmptyCount = 0;
         ProducerListNode* Best          = nullptr;
         std::size_t       BestSize      = 0;
-        ForEachProducerWithBreak( [ &NonEmptyCount, &Best, &BestSize ]( ProducerListNode* Node ) -> bool {
+        NonEmptyIndex.FindMarked( [ this, &NonEmptyCount, &Best, &BestSize ]( ProducerListNode* Node ) -> bool {
             std::size_t Size = Node->GetProducerSize();
             if ( Size > 0 ) {
                 ++NonEmptyCount;
@@ -1413,7 +2362,10 @@ public:
                     Best     = Node;
                 }
             }
-            return NonEmptyCount < 3;
+            else {
+                UnmarkProducer( Node );
+            }
+            return NonEmptyCount >= 3;
         } );
 
         if ( NonEmptyCount > 0 ) {
@@ -1421,18 +2373,30 @@ public:
                 return true;
             }
 
-            return ForEachProducerWithReturn( [ &Element, Best ]( ProducerListNode* Node ) -> bool { return Node != Best && Node->ProducerDequeue( Element ); } );
+            return NonEmptyIndex.FindMarked( [ this, &Element, Best ]( ProducerListNode* Node ) -> bool {
+                if ( Node == Best ) {
+                    return false;
+                }
+                if ( Node->ProducerDequeue( Element ) ) {
+                    return true;
+                }
+                UnmarkProducer( Node );
+                return false;
+            } );
         }
         return false;
     }
 
     template <class U>
     constexpr bool TryDequeueNonInterleaved( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        [[maybe_unused]] ReclaimGuard Guard;
         return ForEachProducerWithReturn( [ &Element ]( ProducerListNode* Node ) -> bool { return Node->ProducerDequeue( Element ); } );
     }
 
     template <class U>
     constexpr bool TryDequeue( ConsumerToken& Token, U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
+        [[maybe_unused]] ReclaimGuard Guard;
+        RevalidateConsumerToken( Token );
         if ( Token.DesiredProducer == nullptr || Token.LastKnownGlobalOffset != GlobalExplicitConsumerOffset.load( std::memory_order_relaxed ) ) {
             if ( !UpdateProducerForConsumer( Token ) ) {
                 return false;
@@ -1440,26 +2404,30 @@ public:
         }
 
         if ( Token.CurrentProducer->ProducerDequeue( Element ) ) {
-            if ( ++Token.ItemsConsumed == EXPLICIT_CONSUMER_CONSUMPTION_QUOTA_BEFORE_ROTATE ) {
+            if ( ++Token.ItemsConsumed == Token.Quota ) {
                 GlobalExplicitConsumerOffset.fetch_add( 1, std::memory_order_relaxed );
             }
             return true;
         }
 
-        ProducerListNode* Head = ProducerListsHead.load( std::memory_order_acquire );
-        ProducerListNode* Node = Token.CurrentProducer->Next;
+        // the walk wraps at most once, CurrentProducer may have been unlinked meanwhile
+        ProducerListNode* Head    = ProducerListsHead.load( std::memory_order_acquire );
+        ProducerListNode* Node    = Token.CurrentProducer->GetNext();
+        bool              Wrapped = Node == nullptr;
         if ( Node == nullptr ) {
             Node = Head;
         }
-        while ( Node != Token.CurrentProducer ) {
+        while ( Node != nullptr && Node != Token.CurrentProducer ) {
             if ( Node->ProducerDequeue( Element ) ) {
                 Token.CurrentProducer = Node;
                 Token.ItemsConsumed   = 1;
+                Token.Quota           = RotationQuotaFor( Node );
                 return true;
             }
-            Node = Node->Next;
-            if ( Node == nullptr ) {
-                Node = Head;
+            Node = Node->GetNext();
+            if ( Node == nullptr && !Wrapped ) {
+                Wrapped = true;
+                Node    = Head;
             }
         }
 
@@ -1468,49 +2436,75 @@ public:
 
     template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
     std::size_t TryDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
-        std::size_t Count = 0;
-        ForEachProducerWithBreak( [ &ItemFirst, &MaxCount, &Count ]( ProducerListNode* Node ) -> bool {
-            Count += Node->ProducerDequeueBulk( std::next( ItemFirst, Count ), MaxCount - Count );
-            return Count != MaxCount;
-        } );
-        return Count;
+        return TryConsumeBulk( details::MoveToIterator<T>( ItemFirst ), MaxCount );
     }
 
     template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
     std::size_t TryDequeueBulk( ConsumerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
+        return TryConsumeBulk( Token, details::MoveToIterator<T>( ItemFirst ), MaxCount );
+    }
+
+    // like TryDequeueBulk, but Func( T& ) sees each element where it sits in the block, so nothing is moved out.
+    // Func( T* Slots, std::size_t Count ) instead gets each contiguous run at once.
+    // elements are destroyed once Func returns, Func must not keep a reference to them
+    template <class Function>
+    HAKLE_REQUIRES( std::invocable<Function&, T&> || std::invocable<Function&, T*, std::size_t> )
+    std::size_t TryConsumeBulk( Function&& Func, std::size_t MaxCount ) {
+        [[maybe_unused]] ReclaimGuard Guard;
+        std::size_t                   Count = 0;
+        NonEmptyIndex.FindMarked( [ this, &Func, &MaxCount, &Count ]( ProducerListNode* Node ) -> bool {
+            std::size_t Wanted = MaxCount - Count;
+            std::size_t Got    = Node->ProducerConsumeBulk( Func, Wanted );
+            Count += Got;
+            if ( Got < Wanted ) {
+                UnmarkProducer( Node );
+            }
+            return Count == MaxCount;
+        } );
+        return Count;
+    }
+
+    template <class Function>
+    HAKLE_REQUIRES( std::invocable<Function&, T&> || std::invocable<Function&, T*, std::size_t> )
+    std::size_t TryConsumeBulk( ConsumerToken& Token, Function&& Func, std::size_t MaxCount ) {
+        [[maybe_unused]] ReclaimGuard Guard;
+        RevalidateConsumerToken( Token );
         if ( Token.DesiredProducer == nullptr || Token.LastKnownGlobalOffset != GlobalExplicitConsumerOffset.load( std::memory_order_relaxed ) ) {
             if ( !UpdateProducerForConsumer( Token ) ) {
                 return 0;
             }
         }
 
-        std::size_t Count = Token.CurrentProducer->ProducerDequeueBulk( ItemFirst, MaxCount );
+        std::size_t Count = Token.CurrentProducer->ProducerConsumeBulk( Func, MaxCount );
         Token.ItemsConsumed += Count;
         if ( Count == MaxCount ) {
-            if ( Token.ItemsConsumed >= EXPLICIT_CONSUMER_CONSUMPTION_QUOTA_BEFORE_ROTATE ) {
+            if ( Token.ItemsConsumed >= Token.Quota ) {
                 GlobalExplicitConsumerOffset.fetch_add( 1, std::memory_order_relaxed );
             }
             return Count;
         }
 
-        ProducerListNode* Head = ProducerListsHead.load( std::memory_order_acquire );
-        ProducerListNode* Node = Token.CurrentProducer->Next;
+        ProducerListNode* Head    = ProducerListsHead.load( std::memory_order_acquire );
+        ProducerListNode* Node    = Token.CurrentProducer->GetNext();
+        bool              Wrapped = Node == nullptr;
         if ( Node == nullptr ) {
             Node = Head;
         }
-        while ( Node != Token.CurrentProducer ) {
-            std::size_t Dequeued = Node->ProducerDequeueBulk( std::next( ItemFirst, Count ), MaxCount - Count );
-            Count += Dequeued;
-            if ( Dequeued != 0 ) {
+        while ( Node != nullptr && Node != Token.CurrentProducer ) {
+            std::size_t Consumed = Node->ProducerConsumeBulk( Func, MaxCount - Count );
+            Count += Consumed;
+            if ( Consumed != 0 ) {
                 Token.CurrentProducer = Node;
-                Token.ItemsConsumed   = Dequeued;
+                Token.ItemsConsumed   = static_cast<std::uint32_t>( Consumed );
+                Token.Quota           = RotationQuotaFor( Node );
             }
             if ( Count == MaxCount ) {
                 break;
             }
-            Node = Node->Next;
-            if ( Node == nullptr ) {
-                Node = Head;
+            Node = Node->GetNext();
+            if ( Node == nullptr && !Wrapped ) {
+                Wrapped = true;
+                Node    = Head;
             }
         }
 
@@ -1524,7 +2518,13 @@ public:
 
     template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
     std::size_t TryDequeueBulkFromProducer( const ProducerToken& Token, Iterator ItemFirst, std::size_t MaxCount ) {
-        return Token.ProducerNode->ProducerDequeueBulk( ItemFirst, MaxCount );
+        return TryConsumeBulkFromProducer( Token, details::MoveToIterator<T>( ItemFirst ), MaxCount );
+    }
+
+    template <class Function>
+    HAKLE_REQUIRES( std::invocable<Function&, T&> || std::invocable<Function&, T*, std::size_t> )
+    std::size_t TryConsumeBulkFromProducer( const ProducerToken& Token, Function&& Func, std::size_t MaxCount ) {
+        return Token.ProducerNode->ProducerConsumeBulk( Func, MaxCount );
     }
 
     struct ProducerToken {
@@ -1539,8 +2539,11 @@ public:
 
         ~ProducerToken() {
             if ( ProducerNode != nullptr ) {
-                ProducerNode->Token = nullptr;
-                ProducerNode->Inactive.store( true, std::memory_order_release );
+                // read before the node is released, a reclaimer may unlink it right after
+                ConcurrentQueue* Parent = ProducerNode->Parent;
+                ProducerNode->Token     = nullptr;
+                Parent->ReleaseProducerListNode( ProducerNode );
+                HAKLE_CONSTEXPR_IF( ReclaimInactiveProducers ) { Parent->ProducerTokenReleased(); }
             }
         }
 
@@ -1575,8 +2578,8 @@ public:
         // TODO: memory_order
         explicit ConsumerToken( ConcurrentQueue& queue ) noexcept : InitialOffset( queue.NextExplicitConsumerId.fetch_add( 1, std::memory_order_relaxed ) ) {}
         ConsumerToken( ConsumerToken&& Other ) noexcept
-            : InitialOffset( Other.InitialOffset ), LastKnownGlobalOffset( Other.LastKnownGlobalOffset ), ItemsConsumed( Other.ItemsConsumed ), CurrentProducer( Other.CurrentProducer ),
-              DesiredProducer( Other.DesiredProducer ) {}
+            : InitialOffset( Other.InitialOffset ), LastKnownGlobalOffset( Other.LastKnownGlobalOffset ), ItemsConsumed( Other.ItemsConsumed ), Quota( Other.Quota ),
+              ListGeneration( Other.ListGeneration ), CurrentProducer( Other.CurrentProducer ), DesiredProducer( Other.DesiredProducer ) {}
 
         ConsumerToken& operator=( ConsumerToken&& Other ) noexcept {
             swap( Other );
@@ -1588,8 +2591,10 @@ public:
             swap( InitialOffset, Other.InitialOffset );
             swap( DesiredProducer, Other.DesiredProducer );
             swap( LastKnownGlobalOffset, Other.LastKnownGlobalOffset );
+            swap( ItemsConsumed, Other.ItemsConsumed );
+            swap( Quota, Other.Quota );
+            swap( ListGeneration, Other.ListGeneration );
             swap( CurrentProducer, Other.CurrentProducer );
-            swap( DesiredProducer, Other.DesiredProducer );
         }
 
         ConsumerToken( const ConsumerToken& )            = delete;
@@ -1599,6 +2604,8 @@ public:
         std::uint32_t     InitialOffset{};
         std::uint32_t     LastKnownGlobalOffset{ static_cast<std::uint32_t>( -1 ) };
         std::uint32_t     ItemsConsumed{};
+        std::uint32_t     Quota{ static_cast<std::uint32_t>( ConsumerRotationQuota ) };  // items to take from CurrentProducer before rotating
+        std::uint32_t     ListGeneration{};  // see RevalidateConsumerToken
         ProducerListNode* CurrentProducer{};
         ProducerListNode* DesiredProducer{};
     };
@@ -1607,40 +2614,107 @@ private:
     template <AllocMode Alloc, class... Args>
     HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
     constexpr bool InnerEnqueueWithToken( const ProducerToken& Token, Args&&... args ) {
-        return Token.ProducerNode->template ProducerEnqueue<Alloc>( std::forward<Args>( args )... );
+        if ( !WithCapacity( 1, [ & ]() { return Token.ProducerNode->template ProducerEnqueue<Alloc>( std::forward<Args>( args )... ); } ) ) {
+            return false;
+        }
+        MarkNonEmpty( Token.ProducerNode );
+        return true;
     }
 
     template <AllocMode Alloc, class... Args>
     HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
     constexpr bool InnerEnqueue( Args&&... args ) {
-        ImplicitProducer* producer = GetOrAddImplicitProducer();
-        return producer == nullptr ? false : producer->template Enqueue<Alloc>( std::forward<Args>( args )... );
+        ProducerListNode* Node = GetOrAddImplicitProducer();
+        if ( Node == nullptr || !WithCapacity( 1, [ & ]() {
+                 HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                     if ( Node->ShouldSpill( 1 ) ) {
+                         return Node->template SpillEnqueue<Alloc>( std::forward<Args>( args )... );
+                     }
+                 }
+                 return Node->GetImplicitProducer()->template Enqueue<Alloc>( std::forward<Args>( args )... );
+             } ) ) {
+            return false;
+        }
+        MarkNonEmpty( Node );
+        return true;
     }
 
     template <AllocMode Alloc, HAKLE_CONCEPT( std::input_iterator ) Iterator>
     HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
     constexpr bool InnerEnqueueBulk( const ProducerToken& Token, Iterator ItermFirst, std::size_t Count ) {
-        return Token.ProducerNode->template ProducerEnqueueBulk<Alloc>( ItermFirst, Count );
+        if ( !WithCapacity( Count, [ & ]() { return Token.ProducerNode->template ProducerEnqueueBulk<Alloc>( ItermFirst, Count ); } ) ) {
+            return false;
+        }
+        MarkNonEmpty( Token.ProducerNode );
+        return true;
+    }
+
+    template <AllocMode Alloc>
+    constexpr bool InnerReserve( const ProducerToken& Token, std::size_t Count, Reservation& OutReservation ) {
+        // reserved slots are in memory, they must not overtake what is waiting on disk
+        HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+            if ( Token.ProducerNode->ShouldSpill( Count ) ) {
+                return false;
+            }
+        }
+        return WithCapacity( Count, [ & ]() { return Token.ProducerNode->GetExplicitProducer()->template Reserve<Alloc>( Count, OutReservation ); } );
     }
 
     template <AllocMode Alloc, HAKLE_CONCEPT( std::input_iterator ) Iterator>
     HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
     constexpr bool InnerEnqueueBulk( Iterator ItermFirst, std::size_t Count ) {
-        ImplicitProducer* producer = GetOrAddImplicitProducer();
-        return producer == nullptr ? false : producer->template EnqueueBulk<Alloc>( ItermFirst, Count );
+        ProducerListNode* Node = GetOrAddImplicitProducer();
+        if ( Node == nullptr || !WithCapacity( Count, [ & ]() {
+                 HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                     if ( Node->ShouldSpill( Count ) ) {
+                         return Node->template SpillEnqueueBulk<Alloc>( ItermFirst, Count );
+                     }
+                 }
+                 return Node->GetImplicitProducer()->template EnqueueBulk<Alloc>( ItermFirst, Count );
+             } ) ) {
+            return false;
+        }
+        MarkNonEmpty( Node );
+        return true;
     }
 
-    enum class ProducerType { Explicit, Implicit };
+#if defined( __linux__ )
+    using SpillType = std::conditional_t<SpillToDisk, SpillStore<T, SpillSegmentSize>, details::NullSpill>;
+#else
+    using SpillType = details::NullSpill;
+#endif
 
-    struct ProducerListNode {
-        ProducerListNode* Next{ nullptr };
-        std::atomic<bool> Inactive{ false };
-        BaseProducer*     Producer{};
-        ProducerToken*    Token{ nullptr };
-        ConcurrentQueue*  Parent{ nullptr };
-        ProducerType      Type;
+    // FreeListNode links the node into InactiveExplicitNodes / InactiveImplicitNodes while it waits for a new owner
+    struct ProducerListNode : FreeListNode<ProducerListNode> {
+        std::atomic<ProducerListNode*> Next{ nullptr };  // only rewritten by the reclaimer once linked
+        std::atomic<bool>              Inactive{ false };
+        BaseProducer*                  Producer{};  // null while the node waits in FreeNodes
+        ProducerToken*                 Token{ nullptr };
+        ConcurrentQueue*               Parent{ nullptr };
+        ProducerType                   Type;
+
+        // implicit producers only, fires when the owning thread exits
+        details::ThreadExitListener ExitListener{};
+
+        typename NonEmptyProducerIndex<ProducerListNode, AllocatorType>::Handle IndexHandle{};
+        std::uint32_t                                                           RegistrySlot{ 0 };
+
+        // elements past SpillBlockBudget, kept across owners like the sub-queue itself
+        [[no_unique_address]] SpillType Spill{};
+
+        // unlinked nodes, chained in RetiredNodes until RetireEpoch is quiescent, then in FreeNodes
+        ProducerListNode* RetiredNext{ nullptr };
+        std::uint64_t     RetireEpoch{ 0 };
+        bool              Unlinking{ false };  // only touched by the reclaimer
+
+        constexpr ProducerListNode( BaseProducer* InProducer, ProducerType InType, ConcurrentQueue* InParent ) noexcept : Producer( InProducer ), Parent( InParent ), Type( InType ) {
+            // the queue frees its nodes, the free lists only borrow them
+            this->HasOwner        = true;
+            ExitListener.Callback = &ImplicitProducerThreadExited;
+            ExitListener.UserData = this;
+        }
 
-        constexpr ProducerListNode( BaseProducer* InProducer, ProducerType InType, ConcurrentQueue* InParent ) noexcept : Producer( InProducer ), Parent( InParent ), Type( InType ) {}
+        HAKLE_NODISCARD constexpr ProducerListNode* GetNext() const noexcept { return Next.load( std::memory_order_acquire ); }
 
         constexpr ExplicitProducer* GetExplicitProducer() const noexcept { return static_cast<ExplicitProducer*>( Producer ); }
         constexpr ImplicitProducer* GetImplicitProducer() const noexcept { return static_cast<ImplicitProducer*>( Producer ); }
@@ -1648,6 +2722,11 @@ private:
         template <AllocMode Alloc, class... Args>
         HAKLE_REQUIRES( std::is_constructible_v<T, Args...> )
         constexpr bool ProducerEnqueue( Args&&... args ) {
+            HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                if ( ShouldSpill( 1 ) ) {
+                    return SpillEnqueue<Alloc>( std::forward<Args>( args )... );
+                }
+            }
             if ( Type == ProducerType::Explicit ) {
                 return GetExplicitProducer()->template Enqueue<Alloc>( std::forward<Args>( args )... );
             }
@@ -1659,6 +2738,11 @@ private:
         template <AllocMode Alloc, HAKLE_CONCEPT( std::input_iterator ) Iterator>
         HAKLE_REQUIRES( requires( Iterator Item ) { T( *Item ); } )
         constexpr bool ProducerEnqueueBulk( Iterator ItermFirst, std::size_t Count ) {
+            HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                if ( ShouldSpill( Count ) ) {
+                    return SpillEnqueueBulk<Alloc>( ItermFirst, Count );
+                }
+            }
             if ( Type == ProducerType::Explicit ) {
                 return GetExplicitProducer()->template EnqueueBulk<Alloc>( ItermFirst, Count );
             }
@@ -1667,46 +2751,114 @@ private:
             }
         }
 
+        // an element that was claimed is gone even if moving it out or Func throws, so the capacity it held is
+        // given back on unwind as well
+        struct CapacityGuard {
+            ConcurrentQueue* Queue;
+            std::size_t      Claimed;
+
+            ~CapacityGuard() { Queue->ReleaseCapacity( Claimed ); }
+        };
+
         template <class U>
         constexpr bool ProducerDequeue( U& Element ) HAKLE_REQUIRES( std::assignable_from<decltype( Element ), T&&> ) {
-            if ( Type == ProducerType::Explicit ) {
-                return GetExplicitProducer()->Dequeue( Element );
+            CapacityGuard        Guard{ Parent, 1 };
+            details::SojournSink Sojourn = LocalSojournSink();
+            bool                 Result  = Type == ProducerType::Explicit ? GetExplicitProducer()->Dequeue( Element, &Sojourn ) : GetImplicitProducer()->Dequeue( Element, &Sojourn );
+            HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                if ( !Result ) {
+                    auto Take = [ &Element ]( T& Value ) { Element = std::move( Value ); };
+                    Result    = Spill.Consume( Take, 1, [ this ]() { return GetMemorySize() == 0; } ) != 0;
+                }
             }
-            else {
-                return GetImplicitProducer()->Dequeue( Element );
+            if ( !Result ) {
+                Guard.Claimed = 0;
             }
+            return Result;
         }
 
-        template <HAKLE_CONCEPT( std::output_iterator<T&&> ) Iterator>
-        constexpr std::size_t ProducerDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
-            if ( Type == ProducerType::Explicit ) {
-                return GetExplicitProducer()->DequeueBulk( ItemFirst, MaxCount );
-            }
-            else {
-                return GetImplicitProducer()->DequeueBulk( ItemFirst, MaxCount );
+        template <class Function>
+        constexpr std::size_t ProducerConsumeBulk( Function& Func, std::size_t MaxCount ) {
+            CapacityGuard        Guard{ Parent, 0 };
+            details::SojournSink Sojourn = LocalSojournSink();
+            std::size_t          Count   = Type == ProducerType::Explicit ? GetExplicitProducer()->ConsumeBulk( Func, MaxCount, &Sojourn, &Guard.Claimed )
+                                                                          : GetImplicitProducer()->ConsumeBulk( Func, MaxCount, &Sojourn, &Guard.Claimed );
+            HAKLE_CONSTEXPR_IF( SpillToDisk ) {
+                if ( Count < MaxCount ) {
+                    Count += Spill.Consume( Func, MaxCount - Count, [ this ]() { return GetMemorySize() == 0; }, &Guard.Claimed );
+                }
             }
+            return Count;
+        }
+
+        // resolves to the calling consumer's histogram on the first claimed element; an empty sink records nothing
+        details::SojournSink LocalSojournSink() const noexcept {
+            HAKLE_CONSTEXPR_IF( SojournTiming ) { return details::SojournSink{ &Parent->SojournHistograms, Parent->QueueId }; }
+            return {};
+        }
+
+        [[nodiscard]] constexpr std::size_t GetProducerSize() const noexcept {
+            HAKLE_CONSTEXPR_IF( SpillToDisk ) { return GetMemorySize() + Spill.Size(); }
+            return GetMemorySize();
         }
 
-        [[nodiscard]] constexpr std::size_t GetProducerSize() const noexcept { return Type == ProducerType::Explicit ? GetExplicitProducer()->Size() : GetImplicitProducer()->Size(); }
+        [[nodiscard]] constexpr std::size_t GetMemorySize() const noexcept { return Type == ProducerType::Explicit ? GetExplicitProducer()->Size() : GetImplicitProducer()->Size(); }
+
+        // producer side. once over budget everything goes to disk until consumers have read it all back,
+        // so the producer's elements stay in order; consumers only read the spill files once memory is empty
+        [[nodiscard]] constexpr bool ShouldSpill( std::size_t Count ) const noexcept { return !Spill.Drained() || GetMemorySize() + Count > SpillBlockBudget * BlockSize; }
+
+        template <AllocMode Alloc, class... Args>
+        bool SpillEnqueue( Args&&... args ) {
+            const T Value( std::forward<Args>( args )... );
+            return Spill.Append( &Value, 1, TraitsSpillDirectory<Traits>::value, Alloc == AllocMode::CanAlloc );
+        }
+
+        template <AllocMode Alloc, class Iterator>
+        bool SpillEnqueueBulk( Iterator ItermFirst, std::size_t Count ) {
+            return Spill.Append( ItermFirst, Count, TraitsSpillDirectory<Traits>::value, Alloc == AllocMode::CanAlloc );
+        }
 
         HAKLE_CPP20_CONSTEXPR ~ProducerListNode() = default;
     };
 
+    using InactiveNodeList = FreeList<ProducerListNode, ProducerListNodeAllocatorType>;
+
+    // O(1): an inactive node of the same type is popped from its free list, otherwise a new one is added
     constexpr ProducerListNode* GetProducerListNode( ProducerType Type ) noexcept {
-        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_relaxed ); Node != nullptr; Node = Node->Next ) {
-            if ( Node->Inactive.load( std::memory_order_relaxed ) && Node->Type == Type ) {
-                bool expected = true;
-                if ( Node->Inactive.compare_exchange_strong( expected, false, std::memory_order_release, std::memory_order_relaxed ) ) {
-                    return Node;
-                }
-            }
+        // the pop acquires what the previous owner published before ReleaseProducerListNode
+        ProducerListNode* Node = InactiveNodes( Type ).TryGet();
+        if ( Node != nullptr ) {
+            Node->Inactive.store( false, std::memory_order_relaxed );
+            return Node;
         }
 
         return AddProducer( CreateProducerListNode( Type ) );
     }
 
+    // hands Node to the next GetProducerListNode of its type
+    constexpr void ReleaseProducerListNode( ProducerListNode* Node ) noexcept {
+        Node->Inactive.store( true, std::memory_order_relaxed );
+        InactiveNodes( Node->Type ).Add( Node );
+    }
+
+    HAKLE_NODISCARD constexpr InactiveNodeList& InactiveNodes( ProducerType Type ) noexcept { return Type == ProducerType::Explicit ? InactiveExplicitNodes : InactiveImplicitNodes; }
+
     constexpr void ReclaimProducerLists() noexcept {
-        ForEachProducer( [ this ]( ProducerListNode* Node ) { Node->Parent = this; } );
+        ForEachProducer( [ this ]( ProducerListNode* Node ) {
+            Node->Parent = this;
+            if ( Node->Type == ProducerType::Explicit ) {
+                Node->GetExplicitProducer()->RebindBlockManager( ExplicitManager );
+            }
+            else {
+                Node->GetImplicitProducer()->RebindBlockManager( ImplicitManager );
+            }
+        } );
+        // retired producers still hold blocks until they are freed
+        for ( ProducerListNode* Node = RetiredNodes; Node != nullptr; Node = Node->RetiredNext ) {
+            Node->Parent = this;
+            Node->GetExplicitProducer()->RebindBlockManager( ExplicitManager );
+        }
     }
 
     constexpr ProducerListNode* AddProducer( ProducerListNode* Node ) {
@@ -1716,9 +2868,26 @@ private:
 
         ProducerCount.fetch_add( 1, std::memory_order_relaxed );
 
+        // once the node is in the registry the reclaimer may move it to another slot, so it goes in last
+        // and RegistrySlot is not read again here
+        if ( Node->IndexHandle.Owner != nullptr ) {
+            // a recycled node keeps its index slot and takes the registry slot PopFreeNode gave it
+            NonEmptyIndex.Attach( Node, Node->IndexHandle );
+            Registry.Set( Node->RegistrySlot, Node );
+        }
+        else if ( !NonEmptyIndex.Register( Node, Node->IndexHandle ) ) {
+            DeleteProducerListNode( Node );
+            return nullptr;
+        }
+        else if ( !Registry.Add( Node, Node->RegistrySlot ) ) {
+            NonEmptyIndex.Detach( Node->IndexHandle );
+            DeleteProducerListNode( Node );
+            return nullptr;
+        }
+
         ProducerListNode* Head = ProducerListsHead.load( std::memory_order_relaxed );
         do {
-            Node->Next = Head;
+            Node->Next.store( Head, std::memory_order_relaxed );
         } while ( !ProducerListsHead.compare_exchange_weak( Head, Node, std::memory_order_release, std::memory_order_relaxed ) );
 
         return Node;
@@ -1727,6 +2896,13 @@ private:
     constexpr ProducerListNode* CreateProducerListNode( ProducerType Type ) {
         BaseProducer* producer = nullptr;
 
+        ProducerListNode* Recycled = nullptr;
+        HAKLE_CONSTEXPR_IF( ReclaimInactiveProducers ) {
+            if ( Type == ProducerType::Explicit ) {
+                Recycled = PopFreeNode();
+            }
+        }
+
         if ( Type == ProducerType::Explicit ) {
             producer = ExplicitProducerAllocatorTraits::Allocate( ExplicitProducerAllocator );
             ExplicitProducerAllocatorTraits::Construct( ExplicitProducerAllocator, static_cast<ExplicitProducer*>( producer ), InitialExplicitQueueSize, ExplicitManager, ValueAllocator );
@@ -1736,6 +2912,13 @@ private:
             ImplicitProducerAllocatorTraits::Construct( ImplicitProducerAllocator, static_cast<ImplicitProducer*>( producer ), InitialImplicitQueueSize, ImplicitManager, ValueAllocator );
         }
 
+        if ( Recycled != nullptr ) {
+            Recycled->Producer = producer;
+            Recycled->Parent   = this;
+            Recycled->Inactive.store( false, std::memory_order_relaxed );
+            return Recycled;
+        }
+
         ProducerListNode* node = ProducerListNodeAllocatorTraits::Allocate( ProducerListNodeAllocator );
         ProducerListNodeAllocatorTraits::Construct( ProducerListNodeAllocator, node, producer, Type, this );
 
@@ -1748,6 +2931,21 @@ private:
             return;
         }
 
+        if ( Node->Type == ProducerType::Implicit ) {
+            details::ThreadExitNotifier::Unsubscribe( &Node->ExitListener );
+        }
+
+        DeleteProducer( Node );
+        ProducerListNodeAllocatorTraits::Destroy( ProducerListNodeAllocator, Node );
+        ProducerListNodeAllocatorTraits::Deallocate( ProducerListNodeAllocator, Node );
+    }
+
+    // frees the sub-queue, its blocks go back to the block manager; the node itself stays
+    constexpr void DeleteProducer( ProducerListNode* Node ) {
+        if ( Node->Producer == nullptr ) {
+            return;
+        }
+
         ProducerCount.fetch_sub( 1, std::memory_order_relaxed );
 
         if ( Node->Type == ProducerType::Explicit ) {
@@ -1758,27 +2956,29 @@ private:
             ImplicitProducerAllocatorTraits::Destroy( ImplicitProducerAllocator, Node->GetImplicitProducer() );
             ImplicitProducerAllocatorTraits::Deallocate( ImplicitProducerAllocator, Node->GetImplicitProducer() );
         }
-
-        ProducerListNodeAllocatorTraits::Destroy( ProducerListNodeAllocator, Node );
-        ProducerListNodeAllocatorTraits::Deallocate( ProducerListNodeAllocator, Node );
+        Node->Producer = nullptr;
     }
 
-    constexpr void ForEachProducer( std::function<void( ProducerListNode* )> Func ) {
-        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_relaxed ); Node != nullptr; Node = Node->Next ) {
+    // visitors are taken as templates so the walk inlines into TryDequeue / TryDequeueBulk
+    template <class Function>
+    constexpr void ForEachProducer( Function&& Func ) {
+        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr; Node = Node->GetNext() ) {
             Func( Node );
         }
     }
 
-    constexpr void ForEachProducerWithBreak( std::function<bool( ProducerListNode* )> Func ) {
-        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_relaxed ); Node != nullptr; Node = Node->Next ) {
+    template <class Function>
+    constexpr void ForEachProducerWithBreak( Function&& Func ) {
+        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr; Node = Node->GetNext() ) {
             if ( !Func( Node ) ) {
                 return;
             }
         }
     }
 
-    constexpr bool ForEachProducerWithReturn( std::function<bool( ProducerListNode* )> Func ) {
-        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_relaxed ); Node != nullptr; Node = Node->Next ) {
+    template <class Function>
+    constexpr bool ForEachProducerWithReturn( Function&& Func ) {
+        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr; Node = Node->GetNext() ) {
             if ( Func( Node ) ) {
                 return true;
             }
@@ -1786,54 +2986,337 @@ private:
         return false;
     }
 
-    constexpr void ForEachProducerSafe( std::function<void( ProducerListNode* )> Func ) {
+    template <class Function>
+    constexpr void ForEachProducerSafe( Function&& Func ) {
         for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_relaxed ); Node != nullptr; ) {
-            ProducerListNode* Next = Node->Next;
+            ProducerListNode* Next = Node->GetNext();
             Func( Node );
             Node = Next;
         }
     }
 
+    // adaptive mode lets a consumer stay on a deep producer to work off its backlog, and leave a shallow one early
+    // instead of spinning on it; the quota then follows the depth, clamped to [ Quota / 4, Quota * 16 ]
+    HAKLE_NODISCARD constexpr std::uint32_t RotationQuotaFor( const ProducerListNode* Node ) const noexcept {
+        HAKLE_CONSTEXPR_IF( !AdaptiveRotationQuota ) { return static_cast<std::uint32_t>( ConsumerRotationQuota ); }
+        else {
+            constexpr std::size_t MinQuota = ConsumerRotationQuota / 4 == 0 ? 1 : ConsumerRotationQuota / 4;
+            constexpr std::size_t MaxQuota = ConsumerRotationQuota * 16;
+            return static_cast<std::uint32_t>( std::clamp( Node->GetProducerSize(), MinQuota, MaxQuota ) );
+        }
+    }
+
+    // first marked producer at or after a random slot that still holds elements, empty ones on the way are unmarked
+    constexpr ProducerListNode* SampleNonEmpty( std::size_t Start, std::size_t& OutSize ) {
+        ProducerListNode* Found = nullptr;
+        NonEmptyIndex.FindMarkedFrom( Start, [ this, &Found, &OutSize ]( ProducerListNode* Node ) -> bool {
+            OutSize = Node->GetProducerSize();
+            if ( OutSize > 0 ) {
+                Found = Node;
+                return true;
+            }
+            UnmarkProducer( Node );
+            return false;
+        } );
+        return Found;
+    }
+
+    // power of two choices: consumers start at different places, so they neither pile onto
+    // the producers near the head nor share the cache lines of one scan order
+    template <class U>
+    constexpr bool TryDequeueTwoChoices( U& Element ) {
+        std::size_t Registered = NonEmptyIndex.Size();
+        if ( Registered == 0 ) {
+            return false;
+        }
+
+        std::uint64_t     Random    = details::ThreadLocalRandom();
+        std::size_t       Start     = static_cast<std::size_t>( Random % Registered );
+        std::size_t       FirstSize = 0;
+        ProducerListNode* First     = SampleNonEmpty( Start, FirstSize );
+        if ( First == nullptr ) {
+            // the first sample wrapped around the whole registry
+            return false;
+        }
+
+        std::size_t       SecondSize = 0;
+        ProducerListNode* Second     = SampleNonEmpty( static_cast<std::size_t>( ( Random >> 32 ) % Registered ), SecondSize );
+        ProducerListNode* Best       = ( Second != nullptr && SecondSize > FirstSize ) ? Second : First;
+        if ( Best->ProducerDequeue( Element ) ) {
+            return true;
+        }
+
+        // lost the race for Best, fall back to a full pass from the first sample
+        return NonEmptyIndex.FindMarkedFrom( Start, [ this, &Element, Best ]( ProducerListNode* Node ) -> bool {
+            if ( Node == Best ) {
+                return false;
+            }
+            if ( Node->ProducerDequeue( Element ) ) {
+                return true;
+            }
+            UnmarkProducer( Node );
+            return false;
+        } );
+    }
+
+    // O(1): the token sits InitialOffset + GlobalExplicitConsumerOffset slots into the registry, counted over the
+    // live producers only; reclaim keeps those packed at the front of the registry, see PackRegistry
     constexpr bool UpdateProducerForConsumer( ConsumerToken& Token ) {
         ProducerListNode* Head = ProducerListsHead.load( std::memory_order_acquire );
-        if ( Token.DesiredProducer == nullptr && ProducerListsHead.load( std::memory_order_acquire ) == nullptr )
+        if ( Head == nullptr )
             return false;
-        std::uint32_t ProducerCount = this->ProducerCount.load( std::memory_order_relaxed );
-        std::uint32_t GlobalOffset  = GlobalExplicitConsumerOffset.load( std::memory_order_relaxed );
+        std::size_t   Live         = Registry.LiveSize();
+        std::uint32_t GlobalOffset = GlobalExplicitConsumerOffset.load( std::memory_order_relaxed );
+        Token.DesiredProducer      = Live != 0 ? Registry.At( ( std::size_t{ Token.InitialOffset } + GlobalOffset ) % Live ) : nullptr;
         if ( Token.DesiredProducer == nullptr ) {
-            std::uint32_t Offset  = Token.InitialOffset % ProducerCount;
+            // the slot is still being filled, or a new producer was added past slots reclaim has not packed yet
             Token.DesiredProducer = Head;
-            for ( std::uint32_t i = 0; i < Offset; ++i ) {
-                Token.DesiredProducer = Token.DesiredProducer->Next;
-                if ( Token.DesiredProducer == nullptr ) {
-                    Token.DesiredProducer = Head;
-                }
-            }
-        }
-
-        std::uint32_t Delta = ( GlobalOffset - Token.LastKnownGlobalOffset ) % ProducerCount;
-        for ( std::uint32_t i = 0; i < Delta; ++i ) {
-            Token.DesiredProducer = Token.DesiredProducer->Next;
-            if ( Token.DesiredProducer == nullptr ) {
-                Token.DesiredProducer = Head;
-            }
         }
 
         Token.LastKnownGlobalOffset = GlobalOffset;
         Token.CurrentProducer       = Token.DesiredProducer;
         Token.ItemsConsumed         = 0;
+        Token.Quota                 = RotationQuotaFor( Token.CurrentProducer );
 
         return true;
     }
 
-    ImplicitProducer* GetOrAddImplicitProducer() {
-        details::thread_id_t thread_id = details::thread_id();
-        ImplicitProducer*    producer  = nullptr;
-        HashTableStatus Result = ImplicitMap.GetOrAddByFunc( thread_id, producer, [ this, &producer ]() { return producer = GetProducerListNode( ProducerType::Implicit )->GetImplicitProducer(); } );
+    ProducerListNode* GetOrAddImplicitProducer() {
+        details::ImplicitProducerCache& Cache  = details::ImplicitProducerCache::Instance();
+        void*                           Cached = Cache.Find( QueueId );
+        if ( Cached != nullptr ) {
+            return static_cast<ProducerListNode*>( Cached );
+        }
+
+        ProducerListNode* Node = LookupImplicitProducer();
+        if ( Node != nullptr ) {
+            Cache.Insert( QueueId, Node );
+        }
+        return Node;
+    }
+
+    ProducerListNode* LookupImplicitProducer() {
+        details::thread_id_t ThreadId = details::thread_id();
+        ProducerListNode*    Node     = nullptr;
+        ProducerListNode*    Created  = nullptr;
+        HashTableStatus      Result   = ImplicitMap.GetOrAddByFunc( ThreadId, Node, [ this, &Created ]() { return Created = GetProducerListNode( ProducerType::Implicit ); } );
         if ( Result == HashTableStatus::FAILED ) {
+            if ( Created != nullptr ) {
+                ReleaseProducerListNode( Created );
+            }
             return nullptr;
         }
-        return producer;
+        if ( Result == HashTableStatus::ADD_SUCCESS ) {
+            details::ThreadExitNotifier::Subscribe( &Node->ExitListener );
+        }
+        return Node;
+    }
+
+    // runs Enqueue with Count slots of MaxCapacity reserved, the reservation is dropped if it fails
+    template <class Function>
+    constexpr bool WithCapacity( std::size_t Count, Function&& Enqueue ) {
+        HAKLE_CONSTEXPR_IF( MaxCapacity == UnlimitedSize ) { return Enqueue(); }
+        else {
+            std::size_t Old = UsedCapacity.fetch_add( Count, std::memory_order_relaxed );
+            if ( Count > MaxCapacity || Old > MaxCapacity - Count ) {
+                UsedCapacity.fetch_sub( Count, std::memory_order_relaxed );
+                return false;
+            }
+
+            bool Result = false;
+            HAKLE_TRY { Result = Enqueue(); }
+            HAKLE_CATCH( ... ) {
+                UsedCapacity.fetch_sub( Count, std::memory_order_relaxed );
+                HAKLE_RETHROW;
+            }
+            if ( !Result ) {
+                UsedCapacity.fetch_sub( Count, std::memory_order_relaxed );
+            }
+            return Result;
+        }
+    }
+
+    constexpr void ReleaseCapacity( std::size_t Count ) noexcept {
+        HAKLE_CONSTEXPR_IF( MaxCapacity != UnlimitedSize ) {
+            if ( Count != 0 ) {
+                UsedCapacity.fetch_sub( Count, std::memory_order_relaxed );
+            }
+        }
+    }
+
+    // consumers hold a ConsumerToken across calls, outside of any epoch; once a reclaim pass bumped
+    // ListGeneration its producers may be gone, so the token starts over from the head
+    constexpr void RevalidateConsumerToken( ConsumerToken& Token ) noexcept {
+        HAKLE_CONSTEXPR_IF( ReclaimInactiveProducers ) {
+            std::uint32_t Generation = ListGeneration.load( std::memory_order_relaxed );
+            if ( Token.ListGeneration != Generation ) {
+                Token.ListGeneration  = Generation;
+                Token.DesiredProducer = nullptr;
+                Token.CurrentProducer = nullptr;
+            }
+        }
+    }
+
+    void ProducerTokenReleased() {
+        if ( ( ReleasedTokens.fetch_add( 1, std::memory_order_relaxed ) + 1 ) % ProducerReclaimInterval == 0 ) {
+            CollectInactiveProducers();
+        }
+    }
+
+    // caller holds ReclaimMutex, so it is the only thread unlinking; producers only ever push at the head
+    void UnlinkInactiveProducers() {
+        // popping a node off the free list is what keeps it from being handed out again; ones that still
+        // hold elements go back, nobody can enqueue into them any more
+        std::size_t       Drained = 0;
+        ProducerListNode* Pending = nullptr;
+        while ( ProducerListNode* Node = InactiveExplicitNodes.TryGet() ) {
+            if ( Node->GetProducerSize() == 0 ) {
+                Node->Unlinking = true;
+                ++Drained;
+            }
+            else {
+                Node->RetiredNext = Pending;
+                Pending           = Node;
+            }
+        }
+        while ( Pending != nullptr ) {
+            ProducerListNode* Next = Pending->RetiredNext;
+            Pending->RetiredNext   = nullptr;
+            ReleaseProducerListNode( Pending );
+            Pending = Next;
+        }
+        if ( Drained == 0 ) {
+            return;
+        }
+
+        ProducerListNode* Unlinked = nullptr;
+        ProducerListNode* Prev     = nullptr;
+        for ( ProducerListNode* Node = ProducerListsHead.load( std::memory_order_acquire ); Node != nullptr && Drained > 0; ) {
+            ProducerListNode* Next = Node->GetNext();
+            if ( Node->Unlinking ) {
+                Node->Unlinking = false;
+                --Drained;
+                UnlinkProducer( Prev, Node, Next );
+                Node->RetiredNext = Unlinked;
+                Unlinked          = Node;
+            }
+            else {
+                Prev = Node;
+            }
+            Node = Next;
+        }
+
+        // tokens see the bump before anything unlinked here can be freed, see RevalidateConsumerToken
+        ListGeneration.fetch_add( 1, std::memory_order_seq_cst );
+        std::uint64_t Epoch = details::EpochDomain::Advance();
+        while ( Unlinked != nullptr ) {
+            ProducerListNode* Next = Unlinked->RetiredNext;
+            Unlinked->RetireEpoch  = Epoch;
+            Unlinked->RetiredNext  = RetiredNodes;
+            RetiredNodes           = Unlinked;
+            Unlinked               = Next;
+        }
+        PackRegistry();
+    }
+
+    // caller holds ReclaimMutex. moves the highest live producers down into the slots of retired and free nodes,
+    // which take the vacated slots in exchange, so the live producers stay packed at the front of the registry
+    // and UpdateProducerForConsumer can count over them. a moved producer is briefly in both slots, which only
+    // means a token positioned right then may land on it twice
+    void PackRegistry() noexcept {
+        std::size_t Top = Registry.Size();
+        for ( ProducerListNode* Nodes : { RetiredNodes, FreeNodes } ) {
+            for ( ProducerListNode* Vacant = Nodes; Vacant != nullptr; Vacant = Vacant->RetiredNext ) {
+                const std::uint32_t Hole  = Vacant->RegistrySlot;
+                ProducerListNode*   Moved = nullptr;
+                // only empty slots are skipped, so a lower hole seen later still finds every candidate above it
+                while ( Moved == nullptr && Top > std::size_t{ Hole } + 1 ) {
+                    Moved = Registry.At( --Top );
+                }
+                if ( Moved == nullptr ) {
+                    continue;
+                }
+                Registry.Set( Hole, Moved );
+                Moved->RegistrySlot = Hole;
+                Registry.Set( static_cast<std::uint32_t>( Top ), nullptr );
+                Vacant->RegistrySlot = static_cast<std::uint32_t>( Top );
+            }
+        }
+    }
+
+    void UnlinkProducer( ProducerListNode* Prev, ProducerListNode* Node, ProducerListNode* Next ) noexcept {
+        NonEmptyIndex.Detach( Node->IndexHandle );
+        Registry.Set( Node->RegistrySlot, nullptr );
+        if ( Prev == nullptr ) {
+            ProducerListNode* Expected = Node;
+            if ( ProducerListsHead.compare_exchange_strong( Expected, Next, std::memory_order_release, std::memory_order_relaxed ) ) {
+                return;
+            }
+            // new producers were pushed in front of Node
+            for ( Prev = Expected; Prev->GetNext() != Node; Prev = Prev->GetNext() ) {
+            }
+        }
+        // Node keeps its Next, so a consumer standing on it still walks back into the list
+        Prev->Next.store( Next, std::memory_order_release );
+    }
+
+    std::size_t FreeRetiredProducers() {
+        std::uint64_t      MinPinned = details::EpochDomain::MinPinnedEpoch();
+        std::size_t        Freed     = 0;
+        ProducerListNode** Link      = &RetiredNodes;
+        while ( *Link != nullptr ) {
+            ProducerListNode* Node = *Link;
+            if ( Node->RetireEpoch > MinPinned ) {
+                Link = &Node->RetiredNext;
+                continue;
+            }
+            *Link = Node->RetiredNext;
+            DeleteProducer( Node );
+            Node->RetiredNext = FreeNodes;
+            FreeNodes         = Node;
+            ++Freed;
+        }
+        return Freed;
+    }
+
+    // the node and its NonEmptyIndex slot are kept for the next explicit producer, so neither grows past the peak
+    ProducerListNode* PopFreeNode() {
+        std::lock_guard<std::mutex> Lock( ReclaimMutex );
+        ProducerListNode*           Node = FreeNodes;
+        if ( Node != nullptr ) {
+            FreeNodes         = Node->RetiredNext;
+            Node->RetiredNext = nullptr;
+            Node->Token       = nullptr;
+            // refill the lowest vacant registry slot, right behind the packed live producers
+            for ( ProducerListNode* Nodes : { RetiredNodes, FreeNodes } ) {
+                for ( ProducerListNode* Vacant = Nodes; Vacant != nullptr; Vacant = Vacant->RetiredNext ) {
+                    if ( Vacant->RegistrySlot < Node->RegistrySlot ) {
+                        std::swap( Vacant->RegistrySlot, Node->RegistrySlot );
+                    }
+                }
+            }
+        }
+        return Node;
+    }
+
+    // called by producers after publishing; with ReadinessNotification, Mark leaves a seq_cst fence behind that
+    // orders the element before the armed check
+    constexpr void MarkNonEmpty( ProducerListNode* Node ) {
+        NonEmptyIndex.template Mark<ReadinessNotification>( Node->IndexHandle );
+        HAKLE_CONSTEXPR_IF( ReadinessNotification ) { Notifier.NotifyIfArmed(); }
+    }
+
+    // called by consumers that found Node empty
+    constexpr void UnmarkProducer( ProducerListNode* Node ) noexcept {
+        NonEmptyIndex.Unmark( Node->IndexHandle, [ Node ]() { return Node->GetProducerSize() == 0; } );
+    }
+
+    // called on the exiting thread: forget its map entry and let GetProducerListNode hand the
+    // producer to another thread, elements it left behind stay dequeueable
+    static void ImplicitProducerThreadExited( void* UserData ) {
+        ProducerListNode* Node = static_cast<ProducerListNode*>( UserData );
+        Node->Parent->ImplicitMap.Remove( details::thread_id() );
+        Node->Parent->ReleaseProducerListNode( Node );
     }
 
     std::atomic<ProducerListNode*> ProducerListsHead{};
@@ -1849,9 +3332,70 @@ private:
     [[no_unique_address]] AllocatorType                 ValueAllocator{};
     [[no_unique_address]] ProducerListNodeAllocatorType ProducerListNodeAllocator{};
 
-    HashTable<details::thread_id_t, ImplicitProducer*, InitialHashSize, details::thread_hash> ImplicitMap{};
+    using ImplicitMapType = HashTable<details::thread_id_t, ProducerListNode*, InitialHashSize, details::thread_hash>;
+    ImplicitMapType ImplicitMap{ details::invalid_thread_id, details::invalid_thread_id2 };
+
+    NonEmptyProducerIndex<ProducerListNode, AllocatorType> NonEmptyIndex{ ValueAllocator };
+    ProducerRegistry<ProducerListNode, AllocatorType>      Registry{ ValueAllocator };
+
+    // inactive nodes by type, waiting for GetProducerListNode
+    InactiveNodeList InactiveExplicitNodes{};
+    InactiveNodeList InactiveImplicitNodes{};
+
+    // elements enqueued but not yet dequeued, only maintained when MaxCapacity is set
+    std::atomic<std::size_t> UsedCapacity{ 0 };
+
+    // producer reclamation, only used with ReclaimInactiveProducers
+    using ReclaimGuard = std::conditional_t<ReclaimInactiveProducers, details::EpochGuard, details::NullGuard>;
+
+    std::mutex                 ReclaimMutex{};
+    ProducerListNode*          RetiredNodes{ nullptr };
+    ProducerListNode*          FreeNodes{ nullptr };
+    std::atomic<std::uint32_t> ListGeneration{ 0 };
+    std::atomic<std::uint32_t> ReleasedTokens{ 0 };
+
+    std::uint64_t QueueId{ details::NextQueueId() };
+
+    [[no_unique_address]] std::conditional_t<ReadinessNotification, ReadinessNotifier, details::NullNotifier> Notifier{};
+
+    [[no_unique_address]] std::conditional_t<SojournTiming, details::ConsumerHistograms, details::NullHistograms> SojournHistograms{};
+};
+
+template <class T, HAKLE_CONCEPT( IsAllocator ) Allocator>
+struct SingleConsumerTraits : ConcurrentQueueDefaultTraits<T, Allocator> {
+    static constexpr bool SingleConsumer = true;
+};
+
+// many producers, one consumer thread at a time
+template <class T, class Allocator = HakleAllocator<T>>
+using MpscQueue = ConcurrentQueue<T, Allocator, SingleConsumerTraits<T, Allocator>>;
+
+template <class T, HAKLE_CONCEPT( IsAllocator ) Allocator>
+struct SojournTimingTraits : ConcurrentQueueDefaultTraits<T, Allocator> {
+    using DefaultTraits = ConcurrentQueueDefaultTraits<T, Allocator>;
+
+    static constexpr bool SojournTiming = true;
+
+    using ExplicitBlockType = HakleTimestampedFlagsBlock<T, DefaultTraits::BlockSize>;
+    using ImplicitBlockType = HakleTimestampedCounterBlock<T, DefaultTraits::BlockSize>;
+
+    using ExplicitAllocatorType = typename HakeAllocatorTraits<Allocator>::template RebindAlloc<ExplicitBlockType>;
+    using ImplicitAllocatorType = typename HakeAllocatorTraits<Allocator>::template RebindAlloc<ImplicitBlockType>;
+
+    using ExplicitBlockManagerType = HakleTimestampedFlagsBlockManager<T, DefaultTraits::BlockSize, ExplicitAllocatorType>;
+    using ImplicitBlockManagerType = HakleTimestampedCounterBlockManager<T, DefaultTraits::BlockSize, ImplicitAllocatorType>;
+
+    static ExplicitBlockManagerType MakeDefaultExplicitBlockManager( const ExplicitAllocatorType& InAllocator ) { return ExplicitBlockManagerType( DefaultTraits::InitialBlockPoolSize, InAllocator ); }
+    static ImplicitBlockManagerType MakeDefaultImplicitBlockManager( const ImplicitAllocatorType& InAllocator ) { return ImplicitBlockManagerType( DefaultTraits::InitialBlockPoolSize, InAllocator ); }
+
+    static ExplicitBlockManagerType MakeExplicitBlockManager( const ExplicitAllocatorType& InAllocator, std::size_t BlockPoolSize ) { return ExplicitBlockManagerType( BlockPoolSize, InAllocator ); }
+    static ImplicitBlockManagerType MakeImplicitBlockManager( const ImplicitAllocatorType& InAllocator, std::size_t BlockPoolSize ) { return ImplicitBlockManagerType( BlockPoolSize, InAllocator ); }
 };
 
+// the default queue with enqueue-to-dequeue times, see GetSojournHistogram
+template <class T, class Allocator = HakleAllocator<T>>
+using TimedConcurrentQueue = ConcurrentQueue<T, Allocator, SojournTimingTraits<T, Allocator>>;
+
 #if HAKLE_CPP_VERSION <= 14
 template <class T, class Alloc>
 constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::BlockSize;
@@ -1867,6 +3411,51 @@ constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::InitialExplicitQue
 
 template <class T, class Alloc>
 constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::InitialImplicitQueueSize;
+
+template <class T, class Alloc>
+constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::MaxSubQueueSize;
+
+template <class T, class Alloc>
+constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::MaxCapacity;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::SingleConsumer;
+
+template <class T, class Alloc>
+constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::ConsumerRotationQuota;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::AdaptiveRotationQuota;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::RandomProducerSelection;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::ReclaimInactiveProducers;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::CacheLineIsolatedLayout;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::ReadinessNotification;
+
+template <class T, class Alloc>
+constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::SpillBlockBudget;
+
+template <class T, class Alloc>
+constexpr std::size_t ConcurrentQueueDefaultTraits<T, Alloc>::SpillSegmentSize;
+
+template <class T, class Alloc>
+constexpr const char* ConcurrentQueueDefaultTraits<T, Alloc>::SpillDirectory;
+
+template <class T, class Alloc>
+constexpr bool ConcurrentQueueDefaultTraits<T, Alloc>::SojournTiming;
+
+template <class T, class Alloc>
+constexpr bool SingleConsumerTraits<T, Alloc>::SingleConsumer;
+
+template <class T, class Alloc>
+constexpr bool SojournTimingTraits<T, Alloc>::SojournTiming;
 #endif
 
 }  // namespace hakle
@@ -104,7 +104,11 @@ private:
 public:
     using Entry = Pair<std::atomic<TKey>, std::atomic<TValue>>;
 
-    explicit constexpr HashTable( TKey InValidKey = TKey{}, const Allocator& InAllocator = Allocator{} ) : PairAllocatorPair( ValueInitTag{}, InAllocator ), INVALID_KEY( InValidKey ) {
+    explicit constexpr HashTable( TKey InValidKey = TKey{}, const Allocator& InAllocator = Allocator{} ) : HashTable( InValidKey, InValidKey, InAllocator ) {}
+
+    // InTombstoneKey marks removed entries, it must differ from InValidKey for Remove to be usable
+    explicit constexpr HashTable( TKey InValidKey, TKey InTombstoneKey, const Allocator& InAllocator = Allocator{} )
+        : PairAllocatorPair( ValueInitTag{}, InAllocator ), INVALID_KEY( InValidKey ), TOMBSTONE_KEY( InTombstoneKey ) {
 #ifndef HAKLE_USE_CONCEPT
         assert( std::atomic<TValue>{}.is_lock_free() );
 #endif
@@ -123,6 +127,7 @@ public:
         using std::swap;
         swap( Hash, Other.Hash );
         swap( INVALID_KEY, Other.INVALID_KEY );
+        swap( TOMBSTONE_KEY, Other.TOMBSTONE_KEY );
     }
 
     constexpr HashTable& operator=( const HashTable& Other ) = delete;
@@ -219,6 +224,35 @@ public:
         return HashTableStatus::ADD_SUCCESS;
     }
 
+    // Replace Key with the tombstone in every table, a later add may reuse the slot.
+    // NOTE: no other thread may operate on the same key concurrently.
+    constexpr bool Remove( const TKey& Key ) noexcept {
+        if ( TOMBSTONE_KEY == INVALID_KEY ) {
+            return false;
+        }
+
+        bool        Removed = false;
+        std::size_t HashId  = Hash( Key );
+        for ( HashNode* CurrentHash = MainHash().load( std::memory_order_acquire ); CurrentHash != nullptr; CurrentHash = CurrentHash->Prev ) {
+            std::size_t Index = HashId;
+            while ( true ) {
+                Index &= CurrentHash->Capacity - 1;
+
+                TKey CurrentKey = CurrentHash->Entries[ Index ].First.load( std::memory_order_relaxed );
+                if ( CurrentKey == Key ) {
+                    Removed |= CurrentHash->Entries[ Index ].First.compare_exchange_strong( CurrentKey, TOMBSTONE_KEY, std::memory_order_release, std::memory_order_relaxed );
+                    break;
+                }
+                if ( CurrentKey == INVALID_KEY ) {
+                    break;
+                }
+                ++Index;
+            }
+        }
+        return Removed;
+    }
+
+    // tombstones still occupy their slots and are counted here
     HAKLE_NODISCARD constexpr std::size_t GetSize() const noexcept { return EntriesCount.load( std::memory_order_relaxed ); }
 
 private:
@@ -303,7 +337,7 @@ private:
                 else {
                     std::size_t NewCapacity = CurrentMainHash->Capacity << 1;
                     while ( NewCount >= NewCapacity >> 1 ) {
-                        NewCount <<= 1;
+                        NewCapacity <<= 1;
                     }
                     HashNode* NewHash = CreateNewHashNode( NewCapacity );
                     if ( NewHash == nullptr ) {
@@ -325,9 +359,13 @@ private:
                     Index &= CurrentMainHash->Capacity - 1;
 
                     TKey CurrentKey = CurrentMainHash->Entries[ Index ].First.load( std::memory_order_relaxed );
-                    if ( CurrentKey == INVALID_KEY ) {
-                        TKey Empty = INVALID_KEY;
-                        if ( CurrentMainHash->Entries[ Index ].First.compare_exchange_strong( Empty, Key, std::memory_order_acq_rel, std::memory_order_relaxed ) ) {
+                    if ( CurrentKey == INVALID_KEY || ( CurrentKey == TOMBSTONE_KEY && TOMBSTONE_KEY != INVALID_KEY ) ) {
+                        TKey Expected = CurrentKey;
+                        if ( CurrentMainHash->Entries[ Index ].First.compare_exchange_strong( Expected, Key, std::memory_order_acq_rel, std::memory_order_relaxed ) ) {
+                            if ( CurrentKey != INVALID_KEY ) {
+                                // a tombstone slot is already counted
+                                EntriesCount.fetch_sub( 1, std::memory_order_relaxed );
+                            }
                             CurrentMainHash->Entries[ Index ].Second.store( InValue, std::memory_order_release );
                             break;
                         }
@@ -349,6 +387,7 @@ private:
     // TODO: use compress pair
     HashType Hash{};
     TKey     INVALID_KEY{};
+    TKey     TOMBSTONE_KEY{};
 
     constexpr PairAllocatorType& PairAllocator() noexcept { return PairAllocatorPair.Second(); }
     constexpr NodeAllocatorType& NodeAllocator() noexcept { return NodeAllocatorPair.Second(); }
@@ -0,0 +1,145 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/common.h"
+#include "common/utility.h"
+
+namespace hakle {
+
+// what SojournTiming stamps elements with: nanoseconds on the monotonic clock, comparable across threads
+struct SojournClock {
+    static std::uint64_t Now() noexcept {
+        return static_cast<std::uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+    }
+};
+
+// Log-linear histogram of std::uint64_t values: below SubBucketCount every value has its own bucket, above that
+// each power of two is split into SubBucketCount equal buckets, so a bucket is never wider than 1 / SubBucketCount
+// of the values in it. Fixed size, no allocation.
+// Record and Merge are for one writing thread (relaxed load + store, no read-modify-write); any thread may read
+// at the same time and then sees a slightly stale but never torn picture.
+class LogLinearHistogram {
+public:
+    static constexpr std::size_t SubBucketBits  = 4;
+    static constexpr std::size_t SubBucketCount = std::size_t{ 1 } << SubBucketBits;
+    static constexpr std::size_t BucketCount    = ( 64 - SubBucketBits + 1 ) * SubBucketCount;
+
+    LogLinearHistogram() = default;
+    LogLinearHistogram( const LogLinearHistogram& Other ) noexcept { Merge( Other ); }
+    LogLinearHistogram& operator=( const LogLinearHistogram& Other ) noexcept {
+        if ( this != &Other ) {
+            Clear();
+            Merge( Other );
+        }
+        return *this;
+    }
+
+    HAKLE_NODISCARD static constexpr std::size_t BucketFor( std::uint64_t Value ) noexcept {
+        if ( Value < SubBucketCount ) {
+            return static_cast<std::size_t>( Value );
+        }
+        std::size_t Shift = BitWidth( Value ) - 1 - SubBucketBits;
+        return ( Shift + 1 ) * SubBucketCount + static_cast<std::size_t>( ( Value >> Shift ) - SubBucketCount );
+    }
+
+    // smallest and largest value that lands in Bucket
+    HAKLE_NODISCARD static constexpr std::uint64_t BucketLowerBound( std::size_t Bucket ) noexcept {
+        std::size_t Group = Bucket / SubBucketCount;
+        std::size_t Sub   = Bucket % SubBucketCount;
+        return Group == 0 ? Sub : static_cast<std::uint64_t>( SubBucketCount + Sub ) << ( Group - 1 );
+    }
+
+    HAKLE_NODISCARD static constexpr std::uint64_t BucketUpperBound( std::size_t Bucket ) noexcept {
+        std::size_t Group = Bucket / SubBucketCount;
+        return BucketLowerBound( Bucket ) + ( Group == 0 ? 0 : ( std::uint64_t{ 1 } << ( Group - 1 ) ) - 1 );
+    }
+
+    void Record( std::uint64_t Value, std::uint64_t Count = 1 ) noexcept {
+        Add( Counts[ BucketFor( Value ) ], Count );
+        Add( TotalCount, Count );
+        Add( TotalSum, Value * Count );
+        if ( Value > MaxValue.load( std::memory_order_relaxed ) ) {
+            MaxValue.store( Value, std::memory_order_relaxed );
+        }
+    }
+
+    // adds everything Other holds, Other may be written to meanwhile
+    void Merge( const LogLinearHistogram& Other ) noexcept {
+        for ( std::size_t i = 0; i < BucketCount; ++i ) {
+            if ( std::uint64_t Count = Other.Counts[ i ].load( std::memory_order_relaxed ); Count != 0 ) {
+                Add( Counts[ i ], Count );
+            }
+        }
+        Add( TotalCount, Other.TotalCount.load( std::memory_order_relaxed ) );
+        Add( TotalSum, Other.TotalSum.load( std::memory_order_relaxed ) );
+        if ( std::uint64_t OtherMax = Other.MaxValue.load( std::memory_order_relaxed ); OtherMax > MaxValue.load( std::memory_order_relaxed ) ) {
+            MaxValue.store( OtherMax, std::memory_order_relaxed );
+        }
+    }
+
+    void Clear() noexcept {
+        for ( auto& Count : Counts ) {
+            Count.store( 0, std::memory_order_relaxed );
+        }
+        TotalCount.store( 0, std::memory_order_relaxed );
+        TotalSum.store( 0, std::memory_order_relaxed );
+        MaxValue.store( 0, std::memory_order_relaxed );
+    }
+
+    HAKLE_NODISCARD std::uint64_t Count() const noexcept { return TotalCount.load( std::memory_order_relaxed ); }
+    HAKLE_NODISCARD std::uint64_t Sum() const noexcept { return TotalSum.load( std::memory_order_relaxed ); }
+    HAKLE_NODISCARD std::uint64_t Max() const noexcept { return MaxValue.load( std::memory_order_relaxed ); }
+    HAKLE_NODISCARD std::uint64_t CountAt( std::size_t Bucket ) const noexcept { return Counts[ Bucket ].load( std::memory_order_relaxed ); }
+
+    HAKLE_NODISCARD double Mean() const noexcept {
+        std::uint64_t Count = TotalCount.load( std::memory_order_relaxed );
+        return Count == 0 ? 0.0 : static_cast<double>( TotalSum.load( std::memory_order_relaxed ) ) / static_cast<double>( Count );
+    }
+
+    // upper bound of the bucket holding the Quantile-th value (0.5 median, 0.99 p99), capped at Max; 0 when empty
+    HAKLE_NODISCARD std::uint64_t ValueAtQuantile( double Quantile ) const noexcept {
+        std::uint64_t Total = 0;
+        for ( const auto& Count : Counts ) {
+            Total += Count.load( std::memory_order_relaxed );
+        }
+        if ( Total == 0 ) {
+            return 0;
+        }
+        Quantile           = Quantile < 0.0 ? 0.0 : ( Quantile > 1.0 ? 1.0 : Quantile );
+        std::uint64_t Rank = static_cast<std::uint64_t>( Quantile * static_cast<double>( Total ) + 0.5 );
+        Rank               = Rank == 0 ? 1 : ( Rank > Total ? Total : Rank );
+
+        std::uint64_t Seen = 0;
+        for ( std::size_t i = 0; i < BucketCount; ++i ) {
+            Seen += Counts[ i ].load( std::memory_order_relaxed );
+            if ( Seen >= Rank ) {
+                std::uint64_t Upper   = BucketUpperBound( i );
+                std::uint64_t Largest = MaxValue.load( std::memory_order_relaxed );
+                return Upper < Largest ? Upper : Largest;
+            }
+        }
+        return MaxValue.load( std::memory_order_relaxed );
+    }
+
+private:
+    static void Add( std::atomic<std::uint64_t>& Target, std::uint64_t Delta ) noexcept { Target.store( Target.load( std::memory_order_relaxed ) + Delta, std::memory_order_relaxed ); }
+
+    std::array<std::atomic<std::uint64_t>, BucketCount> Counts{};
+    std::atomic<std::uint64_t>                          TotalCount{ 0 };
+    std::atomic<std::uint64_t>                          TotalSum{ 0 };
+    std::atomic<std::uint64_t>                          MaxValue{ 0 };
+};
+
+}  // namespace hakle
+
+#endif  // LATENCYHISTOGRAM_H
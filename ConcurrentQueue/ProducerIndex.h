@@ -0,0 +1,373 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef PRODUCERINDEX_H
+#define PRODUCERINDEX_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "ConcurrentQueue/HashTable.h"
+#include "common/allocator.h"
+#include "common/common.h"
+
+namespace hakle {
+
+// Registry of producers plus a two level bitmap of the ones that may hold elements.
+// A producer sets its bit after publishing, a consumer clears it once the producer is found empty,
+// so a scan costs O(non-empty producers) instead of O(producers).
+// Bits are conservative: a set bit may point to an empty producer, but a producer holding elements
+// is never left without its bit.
+template <class Node, HAKLE_CONCEPT( IsAllocator ) ALLOCATOR_TYPE = HakleAllocator<Node>>
+class NonEmptyProducerIndex {
+public:
+    constexpr static std::size_t WordBits        = 64;
+    constexpr static std::size_t WordsPerSegment = 8;
+    constexpr static std::size_t SegmentSize     = WordBits * WordsPerSegment;
+
+    struct Segment {
+        std::atomic<std::uint64_t> Summary{ 0 };  // bit i: Words[ i ] may be non-zero
+        std::atomic<std::uint64_t> Words[ WordsPerSegment ]{};
+        std::atomic<Node*>         Slots[ SegmentSize ]{};
+        std::atomic<Segment*>      Next{ nullptr };
+    };
+
+    // where a registered node lives, kept by the node so marking is O(1)
+    struct Handle {
+        Segment*      Owner{ nullptr };
+        std::uint32_t Word{ 0 };
+        std::uint64_t Bit{ 0 };
+    };
+
+    using SegmentAllocatorType   = typename HakeAllocatorTraits<ALLOCATOR_TYPE>::template RebindAlloc<Segment>;
+    using SegmentAllocatorTraits = typename HakeAllocatorTraits<ALLOCATOR_TYPE>::template RebindTraits<Segment>;
+
+    constexpr explicit NonEmptyProducerIndex( const ALLOCATOR_TYPE& InAllocator = ALLOCATOR_TYPE{} ) : SegmentAllocator( InAllocator ) {}
+    HAKLE_CPP20_CONSTEXPR ~NonEmptyProducerIndex() { Clear(); }
+
+    NonEmptyProducerIndex( const NonEmptyProducerIndex& )            = delete;
+    NonEmptyProducerIndex& operator=( const NonEmptyProducerIndex& ) = delete;
+
+    // NOTE: not thread safe, the owner synchronizes moves
+    constexpr void swap( NonEmptyProducerIndex& Other ) noexcept {
+        core::SwapRelaxed( Head, Other.Head );
+        core::SwapRelaxed( Count, Other.Count );
+        using std::swap;
+        swap( SegmentAllocator, Other.SegmentAllocator );
+    }
+
+    // NOTE: not thread safe, nodes registered so far must no longer be marked
+    constexpr void Clear() noexcept {
+        Segment* Current = Head.load( std::memory_order_relaxed );
+        while ( Current != nullptr ) {
+            Segment* Next = Current->Next.load( std::memory_order_relaxed );
+            SegmentAllocatorTraits::Destroy( SegmentAllocator, Current );
+            SegmentAllocatorTraits::Deallocate( SegmentAllocator, Current );
+            Current = Next;
+        }
+        Head.store( nullptr, std::memory_order_relaxed );
+        Count.store( 0, std::memory_order_relaxed );
+    }
+
+    // returns false when a segment cannot be allocated
+    constexpr bool Register( Node* InNode, Handle& OutHandle ) {
+        std::size_t Slot    = Count.fetch_add( 1, std::memory_order_relaxed );
+        Segment*    Current = GetOrCreateSegment( Head );
+        for ( std::size_t i = Slot / SegmentSize; i > 0 && Current != nullptr; --i ) {
+            Current = GetOrCreateSegment( Current->Next );
+        }
+        if ( Current == nullptr ) {
+            return false;
+        }
+
+        std::size_t Offset = Slot % SegmentSize;
+        OutHandle          = Handle{ Current, static_cast<std::uint32_t>( Offset / WordBits ), std::uint64_t{ 1 } << ( Offset % WordBits ) };
+        Current->Slots[ Offset ].store( InNode, std::memory_order_release );
+        return true;
+    }
+
+    // empties the slot of a node that is being unlinked, the caller keeps the handle for Attach
+    constexpr void Detach( const Handle& InHandle ) noexcept {
+        InHandle.Owner->Words[ InHandle.Word ].fetch_and( ~InHandle.Bit, std::memory_order_relaxed );
+        InHandle.Owner->Slots[ SlotOf( InHandle ) ].store( nullptr, std::memory_order_release );
+    }
+
+    // puts a node back into a slot it got from Register and lost through Detach
+    constexpr void Attach( Node* InNode, const Handle& InHandle ) noexcept { InHandle.Owner->Slots[ SlotOf( InHandle ) ].store( InNode, std::memory_order_release ); }
+
+    // producer side, call after the element is published. Fenced also leaves a seq_cst fence behind when the
+    // bit has to be set, for callers that read more flags right after marking
+    template <bool Fenced = false>
+    constexpr void Mark( const Handle& InHandle ) noexcept {
+        std::atomic<std::uint64_t>& Word = InHandle.Owner->Words[ InHandle.Word ];
+        if ( ( Word.load( std::memory_order_relaxed ) & InHandle.Bit ) != 0 ) {
+            // the bit looks set, but a consumer may be clearing it right now. Pairs with the fence in Unmark:
+            // either we see the bit cleared, or the consumer sees our element
+            std::atomic_thread_fence( std::memory_order_seq_cst );
+            if ( ( Word.load( std::memory_order_relaxed ) & InHandle.Bit ) != 0 ) {
+                return;
+            }
+        }
+        else {
+            HAKLE_CONSTEXPR_IF( Fenced ) { std::atomic_thread_fence( std::memory_order_seq_cst ); }
+        }
+
+        // no fence needed here: an Unmark ordered after this read-modify-write reads our bit and with it the element
+        Word.fetch_or( InHandle.Bit, std::memory_order_seq_cst );
+
+        std::uint64_t SummaryBit = std::uint64_t{ 1 } << InHandle.Word;
+        if ( ( InHandle.Owner->Summary.load( std::memory_order_seq_cst ) & SummaryBit ) == 0 ) {
+            InHandle.Owner->Summary.fetch_or( SummaryBit, std::memory_order_seq_cst );
+        }
+    }
+
+    // consumer side, IsEmpty is re-evaluated after the bit is gone so a racing enqueue is not lost
+    template <class Function>
+    constexpr void Unmark( const Handle& InHandle, Function&& IsEmpty ) noexcept {
+        InHandle.Owner->Words[ InHandle.Word ].fetch_and( ~InHandle.Bit, std::memory_order_seq_cst );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( !IsEmpty() ) {
+            Mark( InHandle );
+        }
+    }
+
+    // visits marked nodes until Func returns true, returns whether it did
+    template <class Function>
+    constexpr bool FindMarked( Function&& Func ) {
+        return ScanMarked( 0, SIZE_MAX, Func );
+    }
+
+    // same as FindMarked, but starts at slot Start and wraps around, so callers picking a random start
+    // spread their probes over the whole registry instead of all hitting the first segment
+    template <class Function>
+    constexpr bool FindMarkedFrom( std::size_t Start, Function&& Func ) {
+        return ScanMarked( Start, SIZE_MAX, Func ) || ( Start != 0 && ScanMarked( 0, Start, Func ) );
+    }
+
+    // number of slots handed out so far, the trailing ones may not be stored yet
+    HAKLE_NODISCARD constexpr std::size_t Size() const noexcept { return Count.load( std::memory_order_relaxed ); }
+
+private:
+    constexpr Segment* GetOrCreateSegment( std::atomic<Segment*>& Link ) {
+        Segment* Current = Link.load( std::memory_order_acquire );
+        if ( Current != nullptr ) {
+            return Current;
+        }
+
+        Segment* NewSegment = SegmentAllocatorTraits::Allocate( SegmentAllocator );
+        if ( NewSegment == nullptr ) {
+            return nullptr;
+        }
+        SegmentAllocatorTraits::Construct( SegmentAllocator, NewSegment );
+        if ( Link.compare_exchange_strong( Current, NewSegment, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+            return NewSegment;
+        }
+
+        // someone else linked a segment first
+        SegmentAllocatorTraits::Destroy( SegmentAllocator, NewSegment );
+        SegmentAllocatorTraits::Deallocate( SegmentAllocator, NewSegment );
+        return Current;
+    }
+
+    HAKLE_NODISCARD static constexpr std::size_t SlotOf( const Handle& InHandle ) noexcept {
+        return InHandle.Word * WordBits + static_cast<std::size_t>( std::countr_zero( InHandle.Bit ) );
+    }
+
+    // visits marked nodes in slots [ Begin, End )
+    template <class Function>
+    constexpr bool ScanMarked( std::size_t Begin, std::size_t End, Function& Func ) {
+        std::size_t SegmentBase = 0;
+        for ( Segment* Current = Head.load( std::memory_order_acquire ); Current != nullptr && SegmentBase < End;
+              Current          = Current->Next.load( std::memory_order_acquire ), SegmentBase += SegmentSize ) {
+            if ( SegmentBase + SegmentSize <= Begin ) {
+                continue;
+            }
+
+            std::uint64_t Summary = Current->Summary.load( std::memory_order_acquire );
+            while ( Summary != 0 ) {
+                std::uint32_t WordIndex = static_cast<std::uint32_t>( std::countr_zero( Summary ) );
+                Summary &= Summary - 1;
+
+                std::uint64_t Word = Current->Words[ WordIndex ].load( std::memory_order_acquire );
+                if ( Word == 0 ) {
+                    ClearSummaryBit( *Current, WordIndex );
+                    continue;
+                }
+                Word &= RangeMask( SegmentBase + WordIndex * WordBits, Begin, End );
+                while ( Word != 0 ) {
+                    std::size_t Offset = WordIndex * WordBits + static_cast<std::size_t>( std::countr_zero( Word ) );
+                    Word &= Word - 1;
+
+                    Node* Marked = Current->Slots[ Offset ].load( std::memory_order_acquire );
+                    if ( Marked != nullptr && Func( Marked ) ) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
+    // bits of the word starting at slot WordBase that fall into [ Begin, End )
+    HAKLE_NODISCARD static constexpr std::uint64_t RangeMask( std::size_t WordBase, std::size_t Begin, std::size_t End ) noexcept {
+        std::uint64_t Mask = ~std::uint64_t{ 0 };
+        if ( Begin > WordBase ) {
+            Mask = Begin - WordBase >= WordBits ? 0 : Mask << ( Begin - WordBase );
+        }
+        if ( End < WordBase + WordBits ) {
+            Mask &= End <= WordBase ? 0 : ~std::uint64_t{ 0 } >> ( WordBits - ( End - WordBase ) );
+        }
+        return Mask;
+    }
+
+    constexpr void ClearSummaryBit( Segment& InSegment, std::uint32_t WordIndex ) noexcept {
+        std::uint64_t SummaryBit = std::uint64_t{ 1 } << WordIndex;
+        InSegment.Summary.fetch_and( ~SummaryBit, std::memory_order_seq_cst );
+        // a producer may have set a word bit after we read the word but before the summary was cleared
+        if ( InSegment.Words[ WordIndex ].load( std::memory_order_seq_cst ) != 0 ) {
+            InSegment.Summary.fetch_or( SummaryBit, std::memory_order_seq_cst );
+        }
+    }
+
+    std::atomic<Segment*>    Head{ nullptr };
+    std::atomic<std::size_t> Count{ 0 };
+
+    [[no_unique_address]] SegmentAllocatorType SegmentAllocator{};
+};
+
+// Producers by slot, in registration order. Segment k holds FirstSegmentSize << k slots and is published once
+// with a release store; segments never move, so any slot is reached in O(1) without a lock.
+// A slot is null while its node is being registered or after the owner cleared it. LiveSize counts the non-null
+// slots, so an owner that keeps its live nodes packed at the front can position over them in O(1).
+template <class Node, HAKLE_CONCEPT( IsAllocator ) ALLOCATOR_TYPE = HakleAllocator<Node>>
+class ProducerRegistry {
+public:
+    constexpr static std::size_t FirstSegmentBits = 5;
+    constexpr static std::size_t FirstSegmentSize = std::size_t{ 1 } << FirstSegmentBits;
+    // enough segments for every slot a std::uint32_t can name
+    constexpr static std::size_t MaxSegments = 32 - FirstSegmentBits;
+
+    using SlotType            = std::atomic<Node*>;
+    using SlotAllocatorType   = typename HakeAllocatorTraits<ALLOCATOR_TYPE>::template RebindAlloc<SlotType>;
+    using SlotAllocatorTraits = typename HakeAllocatorTraits<ALLOCATOR_TYPE>::template RebindTraits<SlotType>;
+
+    constexpr explicit ProducerRegistry( const ALLOCATOR_TYPE& InAllocator = ALLOCATOR_TYPE{} ) : SlotAllocator( InAllocator ) {}
+    HAKLE_CPP20_CONSTEXPR ~ProducerRegistry() { Clear(); }
+
+    ProducerRegistry( const ProducerRegistry& )            = delete;
+    ProducerRegistry& operator=( const ProducerRegistry& ) = delete;
+
+    // NOTE: not thread safe, the owner synchronizes moves
+    constexpr void swap( ProducerRegistry& Other ) noexcept {
+        for ( std::size_t i = 0; i < MaxSegments; ++i ) {
+            core::SwapRelaxed( Segments[ i ], Other.Segments[ i ] );
+        }
+        core::SwapRelaxed( Count, Other.Count );
+        core::SwapRelaxed( Live, Other.Live );
+        using std::swap;
+        swap( SlotAllocator, Other.SlotAllocator );
+    }
+
+    // NOTE: not thread safe
+    constexpr void Clear() noexcept {
+        for ( std::size_t i = 0; i < MaxSegments; ++i ) {
+            SlotType* Current = Segments[ i ].load( std::memory_order_relaxed );
+            if ( Current != nullptr ) {
+                SlotAllocatorTraits::Destroy( SlotAllocator, Current, SegmentSize( i ) );
+                SlotAllocatorTraits::Deallocate( SlotAllocator, Current, SegmentSize( i ) );
+                Segments[ i ].store( nullptr, std::memory_order_relaxed );
+            }
+        }
+        Count.store( 0, std::memory_order_relaxed );
+        Live.store( 0, std::memory_order_relaxed );
+    }
+
+    // returns false when the registry is full or a segment cannot be allocated
+    constexpr bool Add( Node* InNode, std::uint32_t& OutSlot ) {
+        std::size_t Slot = Count.fetch_add( 1, std::memory_order_relaxed );
+        if ( Slot >= std::numeric_limits<std::uint32_t>::max() ) {
+            return false;
+        }
+
+        std::size_t SegmentIndex = SegmentOf( Slot );
+        SlotType*   Current      = GetOrCreateSegment( SegmentIndex );
+        if ( Current == nullptr ) {
+            return false;
+        }
+        OutSlot = static_cast<std::uint32_t>( Slot );
+        Current[ OffsetOf( Slot, SegmentIndex ) ].store( InNode, std::memory_order_release );
+        Live.fetch_add( 1, std::memory_order_relaxed );
+        return true;
+    }
+
+    // rewrites a slot handed out by Add, e.g. to empty it while its node is unlinked
+    constexpr void Set( std::uint32_t Slot, Node* InNode ) noexcept {
+        std::size_t SegmentIndex = SegmentOf( Slot );
+        Node*       Old          = Segments[ SegmentIndex ].load( std::memory_order_relaxed )[ OffsetOf( Slot, SegmentIndex ) ].exchange( InNode, std::memory_order_acq_rel );
+        if ( ( Old == nullptr ) != ( InNode == nullptr ) ) {
+            Live.fetch_add( InNode != nullptr ? std::size_t{ 1 } : ~std::size_t{ 0 }, std::memory_order_relaxed );
+        }
+    }
+
+    HAKLE_NODISCARD constexpr Node* At( std::size_t Slot ) const noexcept {
+        std::size_t SegmentIndex = SegmentOf( Slot );
+        SlotType*   Current      = SegmentIndex < MaxSegments ? Segments[ SegmentIndex ].load( std::memory_order_acquire ) : nullptr;
+        return Current == nullptr ? nullptr : Current[ OffsetOf( Slot, SegmentIndex ) ].load( std::memory_order_acquire );
+    }
+
+    // number of slots handed out so far, the trailing ones may not be stored yet
+    HAKLE_NODISCARD constexpr std::size_t Size() const noexcept {
+        std::size_t Result = Count.load( std::memory_order_relaxed );
+        return Result < std::numeric_limits<std::uint32_t>::max() ? Result : std::numeric_limits<std::uint32_t>::max();
+    }
+
+    // number of non-null slots, slots being stored or cleared right now may or may not be counted
+    HAKLE_NODISCARD constexpr std::size_t LiveSize() const noexcept { return Live.load( std::memory_order_relaxed ); }
+
+private:
+    HAKLE_NODISCARD static constexpr std::size_t SegmentSize( std::size_t SegmentIndex ) noexcept { return FirstSegmentSize << SegmentIndex; }
+    HAKLE_NODISCARD static constexpr std::size_t SegmentOf( std::size_t Slot ) noexcept {
+        return static_cast<std::size_t>( std::bit_width( Slot + FirstSegmentSize ) ) - 1 - FirstSegmentBits;
+    }
+    HAKLE_NODISCARD static constexpr std::size_t OffsetOf( std::size_t Slot, std::size_t SegmentIndex ) noexcept { return Slot + FirstSegmentSize - SegmentSize( SegmentIndex ); }
+
+    constexpr SlotType* GetOrCreateSegment( std::size_t SegmentIndex ) {
+        std::atomic<SlotType*>& Link    = Segments[ SegmentIndex ];
+        SlotType*               Current = Link.load( std::memory_order_acquire );
+        if ( Current != nullptr ) {
+            return Current;
+        }
+
+        std::size_t Size       = SegmentSize( SegmentIndex );
+        SlotType*   NewSegment = SlotAllocatorTraits::Allocate( SlotAllocator, Size );
+        if ( NewSegment == nullptr ) {
+            return nullptr;
+        }
+        for ( std::size_t i = 0; i < Size; ++i ) {
+            SlotAllocatorTraits::Construct( SlotAllocator, NewSegment + i, nullptr );
+        }
+        if ( Link.compare_exchange_strong( Current, NewSegment, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+            return NewSegment;
+        }
+
+        // someone else published the segment first
+        SlotAllocatorTraits::Destroy( SlotAllocator, NewSegment, Size );
+        SlotAllocatorTraits::Deallocate( SlotAllocator, NewSegment, Size );
+        return Current;
+    }
+
+    std::atomic<SlotType*>   Segments[ MaxSegments ]{};
+    std::atomic<std::size_t> Count{ 0 };
+    std::atomic<std::size_t> Live{ 0 };
+
+    [[no_unique_address]] SlotAllocatorType SlotAllocator{};
+};
+
+}  // namespace hakle
+
+#endif  // PRODUCERINDEX_H
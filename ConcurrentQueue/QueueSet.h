@@ -0,0 +1,153 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef QUEUESET_H
+#define QUEUESET_H
+
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+
+#include "ConcurrentQueue/ConcurrentQueue.h"
+#include "ReaderWriterQueue/readerwriterqueue.h"
+#include "common/common.h"
+
+namespace hakle {
+
+// Lets a consumer block on several ConcurrentQueues at once, e.g. control / data / bulk lanes.
+// Every member's readiness notifier is bound to the set: the first element a sleeping member receives marks it
+// ready and posts one permit on a shared semaphore, so Wait neither polls nor needs a thread per queue, and it
+// tells the caller which member to serve. Lower indices win when several members are ready.
+// Members need ReadinessNotification in their traits, may hold different element types, and take the queue's
+// notifier slot, so a queue belongs to at most one set. NOTE: Add is not thread safe, add members before waiting
+class QueueSet {
+public:
+    static constexpr std::size_t MaxMembers = 64;
+    static constexpr std::size_t NoMember   = std::numeric_limits<std::size_t>::max();
+
+    QueueSet() : Sem( std::make_unique<LightWeightSemaphore>() ) {}
+
+    ~QueueSet() {
+        for ( std::size_t Index = 0; Index < Count; ++Index ) {
+            Members[ Index ].Ops->Unbind( Members[ Index ].Queue );
+        }
+    }
+
+    // members point back at the set
+    QueueSet( const QueueSet& )            = delete;
+    QueueSet& operator=( const QueueSet& ) = delete;
+
+    // returns the member's index, which is what Wait hands back, or NoMember when the set already holds
+    // MaxMembers queues; InQueue's notifier is left alone then
+    template <class Queue>
+    std::size_t Add( Queue& InQueue ) {
+        static_assert( Queue::ReadinessNotification, "QueueSet members need ReadinessNotification in their traits" );
+        if HAKLE_UNLIKELY ( Count >= MaxMembers ) {
+            return NoMember;
+        }
+        Member& NewMember = Members[ Count ];
+        NewMember.Owner   = this;
+        NewMember.Index   = Count;
+        NewMember.Queue   = &InQueue;
+        NewMember.Ops     = &OpsFor<Queue>;
+        InQueue.SetNotifier( &QueueSet::MemberReady, &NewMember );
+        return Count++;
+    }
+
+    HAKLE_NODISCARD std::size_t Size() const noexcept { return Count; }
+
+    // blocks until a member may hold elements and returns its index, or NoMember on timeout.
+    // the caller should dequeue from that member until it comes back empty before waiting again;
+    // a returned member can occasionally turn out empty when another consumer got there first.
+    // Timeout is in milliseconds, a negative timeout waits forever
+    std::size_t Wait( std::int64_t Timeout = -1 ) {
+        // a permit can turn out stale (its member was taken by someone else), so every trip round the loop
+        // only waits for what is left of the timeout
+        const auto Deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( Timeout < 0 ? 0 : Timeout );
+        for ( ;; ) {
+            std::size_t Index = TakeReady();
+            if ( Index != NoMember ) {
+                return Index;
+            }
+            // arm every member that is awake, one that still holds elements is served right away;
+            // a member that is still armed has received nothing since it was last armed
+            for ( Index = 0; Index < Count; ++Index ) {
+                const Member& Current = Members[ Index ];
+                if ( !Current.Ops->IsArmed( Current.Queue ) && !Current.Ops->Arm( Current.Queue ) ) {
+                    return Index;
+                }
+            }
+            std::int64_t Remaining = -1;
+            if ( Timeout >= 0 ) {
+                Remaining = std::chrono::ceil<std::chrono::milliseconds>( Deadline - std::chrono::steady_clock::now() ).count();
+                Remaining = Remaining < 0 ? 0 : Remaining;
+            }
+            if ( !Sem->Wait( Remaining ) ) {
+                return TakeReady();
+            }
+        }
+    }
+
+    template <class Rep, class Period>
+    std::size_t Wait( const std::chrono::duration<Rep, Period>& Timeout ) {
+        if ( Timeout < Timeout.zero() ) {
+            return Wait( -1 );
+        }
+        return Wait( static_cast<std::int64_t>( std::chrono::ceil<std::chrono::milliseconds>( Timeout ).count() ) );
+    }
+
+    std::size_t TryWait() { return Wait( 0 ); }
+
+private:
+    // type-erased view of one ConcurrentQueue instantiation
+    struct MemberOps {
+        bool ( *Arm )( void* Queue );
+        bool ( *IsArmed )( const void* Queue );
+        void ( *Unbind )( void* Queue );
+    };
+
+    template <class Queue>
+    static constexpr MemberOps OpsFor{ []( void* InQueue ) { return static_cast<Queue*>( InQueue )->ArmNotifier(); },
+                                       []( const void* InQueue ) { return static_cast<const Queue*>( InQueue )->IsNotifierArmed(); },
+                                       []( void* InQueue ) { static_cast<Queue*>( InQueue )->SetNotifier( nullptr, nullptr ); } };
+
+    struct Member {
+        QueueSet*        Owner{ nullptr };
+        std::size_t      Index{ 0 };
+        void*            Queue{ nullptr };
+        const MemberOps* Ops{ nullptr };
+    };
+
+    // runs on the producer that woke the member
+    static void MemberReady( void* UserData ) {
+        Member* Ready = static_cast<Member*>( UserData );
+        Ready->Owner->ReadyMask.fetch_or( std::uint64_t{ 1 } << Ready->Index, std::memory_order_release );
+        Ready->Owner->Sem->Signal();
+    }
+
+    // claims the lowest ready member, a permit left behind only costs a spurious trip round Wait
+    std::size_t TakeReady() noexcept {
+        std::uint64_t Mask = ReadyMask.load( std::memory_order_relaxed );
+        while ( Mask != 0 ) {
+            std::uint64_t Lowest = Mask & ( ~Mask + 1 );
+            if ( ReadyMask.compare_exchange_weak( Mask, Mask & ~Lowest, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+                return static_cast<std::size_t>( std::countr_zero( Lowest ) );
+            }
+        }
+        return NoMember;
+    }
+
+    Member                                Members[ MaxMembers ]{};
+    std::size_t                           Count{ 0 };
+    std::atomic<std::uint64_t>            ReadyMask{ 0 };
+    std::unique_ptr<LightWeightSemaphore> Sem;
+};
+
+}  // namespace hakle
+
+#endif  // QUEUESET_H
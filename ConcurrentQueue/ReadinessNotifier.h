@@ -0,0 +1,144 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef READINESSNOTIFIER_H
+#define READINESSNOTIFIER_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+#if defined( __linux__ )
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#include "common/common.h"
+
+namespace hakle {
+
+// Tells a sleeping consumer that its queue went from empty to non-empty.
+// The consumer arms the notifier once it has drained the queue; the first producer to publish after that
+// disarms it and runs the callback, every later enqueue sees it disarmed and costs one relaxed load.
+// So a burst is coalesced into a single callback, and nothing fires while the consumer is awake.
+class ReadinessNotifier {
+public:
+    using CallbackType = void ( * )( void* UserData );
+
+    ReadinessNotifier() = default;
+
+    ReadinessNotifier( const ReadinessNotifier& )            = delete;
+    ReadinessNotifier& operator=( const ReadinessNotifier& ) = delete;
+
+    // NOTE: not thread safe, bind before the queue is shared
+    void Bind( CallbackType InCallback, void* InUserData ) noexcept {
+        Callback = InCallback;
+        UserData = InUserData;
+    }
+
+    // producer side, the element must be published and followed by a seq_cst fence
+    void NotifyIfArmed() {
+        if ( Armed.load( std::memory_order_relaxed ) && Armed.exchange( false, std::memory_order_acq_rel ) && Callback != nullptr ) {
+            Callback( UserData );
+        }
+    }
+
+    // consumer side, true means it is safe to sleep: the callback has fired or will fire on the next enqueue.
+    // false means elements showed up while arming, the consumer should keep dequeuing
+    template <class IsEmptyFunc>
+    bool Arm( IsEmptyFunc&& IsEmpty ) {
+        Armed.store( true, std::memory_order_relaxed );
+        // pairs with the fence after publishing: either the producer sees us armed, or we see its element
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( std::forward<IsEmptyFunc>( IsEmpty )() ) {
+            return true;
+        }
+        // take the arm back, unless a producer already took it and is notifying us anyway
+        return !Armed.exchange( false, std::memory_order_acq_rel );
+    }
+
+    HAKLE_NODISCARD bool IsArmed() const noexcept { return Armed.load( std::memory_order_relaxed ); }
+
+    // NOTE: not thread safe, only for moves
+    void swap( ReadinessNotifier& Other ) noexcept {
+        bool OtherArmed = Other.Armed.load( std::memory_order_relaxed );
+        Other.Armed.store( Armed.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        Armed.store( OtherArmed, std::memory_order_relaxed );
+        std::swap( Callback, Other.Callback );
+        std::swap( UserData, Other.UserData );
+    }
+
+private:
+    std::atomic<bool> Armed{ false };
+    CallbackType      Callback{ nullptr };
+    void*             UserData{ nullptr };
+};
+
+#if defined( __linux__ )
+// non-blocking eventfd for epoll / poll reactors, bind it with
+// Queue.SetNotifier( &EventFdNotifier::Signal, &Notifier ) and watch Fd() for EPOLLIN
+class EventFdNotifier {
+public:
+    EventFdNotifier() : Descriptor( ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) {
+        if ( Descriptor < 0 ) {
+            throw std::system_error( errno, std::generic_category(), "eventfd" );
+        }
+    }
+
+    ~EventFdNotifier() {
+        if ( Descriptor >= 0 ) {
+            ::close( Descriptor );
+        }
+    }
+
+    EventFdNotifier( EventFdNotifier&& Other ) noexcept : Descriptor( std::exchange( Other.Descriptor, -1 ) ), Writes( Other.Writes.load( std::memory_order_relaxed ) ) {}
+    EventFdNotifier& operator=( EventFdNotifier&& Other ) noexcept {
+        if ( this != &Other ) {
+            if ( Descriptor >= 0 ) {
+                ::close( Descriptor );
+            }
+            Descriptor = std::exchange( Other.Descriptor, -1 );
+            Writes.store( Other.Writes.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        }
+        return *this;
+    }
+
+    EventFdNotifier( const EventFdNotifier& )            = delete;
+    EventFdNotifier& operator=( const EventFdNotifier& ) = delete;
+
+    HAKLE_NODISCARD int Fd() const noexcept { return Descriptor; }
+
+    // ReadinessNotifier callback, UserData is the EventFdNotifier
+    static void Signal( void* UserData ) noexcept { static_cast<EventFdNotifier*>( UserData )->Write(); }
+
+    void Write() noexcept {
+        const std::uint64_t One = 1;
+        // EAGAIN only happens when the counter is about to overflow, and then the fd is readable anyway
+        [[maybe_unused]] ssize_t Result = ::write( Descriptor, &One, sizeof( One ) );
+        Writes.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    // resets the counter after the fd was reported readable, returns how many signals it held (0 if none)
+    std::uint64_t Acknowledge() noexcept {
+        std::uint64_t Count = 0;
+        if ( ::read( Descriptor, &Count, sizeof( Count ) ) != static_cast<ssize_t>( sizeof( Count ) ) ) {
+            return 0;
+        }
+        return Count;
+    }
+
+    // write(2) calls so far, for measuring how well signals coalesce
+    HAKLE_NODISCARD std::uint64_t WriteCount() const noexcept { return Writes.load( std::memory_order_relaxed ); }
+
+private:
+    int                        Descriptor{ -1 };
+    std::atomic<std::uint64_t> Writes{ 0 };
+};
+#endif
+
+}  // namespace hakle
+
+#endif  // READINESSNOTIFIER_H
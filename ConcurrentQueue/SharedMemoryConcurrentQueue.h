@@ -0,0 +1,524 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef SHAREDMEMORYCONCURRENTQUEUE_H
+#define SHAREDMEMORYCONCURRENTQUEUE_H
+
+#include "common/common.h"
+
+#if defined( __linux__ )
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ConcurrentQueue/Block.h"
+#include "ConcurrentQueue/BlockManager.h"
+
+namespace hakle {
+
+// where a U lives in a shared region, counted from the start of the mapping. every process maps the region at
+// its own address, so this is what the region stores instead of a pointer; 0 is null since the header is there
+template <class U>
+struct OffsetPtr {
+    std::uint64_t Offset{ 0 };
+
+    static OffsetPtr From( std::byte* Base, U* Pointer ) noexcept { return OffsetPtr{ Pointer != nullptr ? static_cast<std::uint64_t>( reinterpret_cast<std::byte*>( Pointer ) - Base ) : 0 }; }
+
+    HAKLE_NODISCARD U* Get( std::byte* Base ) const noexcept { return Offset != 0 ? reinterpret_cast<U*>( Base + Offset ) : nullptr; }
+    HAKLE_NODISCARD explicit operator bool() const noexcept { return Offset != 0; }
+};
+
+// MPMC queue for producers and consumers in different processes on the same host.
+// Everything lives in one memfd_create / shm_open region: the header with the block free list, the producer
+// registry with every producer's block index ring, and the HakleBlocks, all linked by offsets.
+// Like the implicit producers of ConcurrentQueue, a producer takes every block it fills from the shared free list and
+// the consumer that empties a block gives it back, so drained blocks go to whichever producer needs them next.
+// The region is sized once, at creation.
+// NOTE: T must be trivially copyable and must not hold pointers, and every process must use the same T, BLOCK_SIZE
+// and Policy (Open checks the sizes). a process that dies holding a ProducerToken keeps its registry slot and the
+// block it was filling, its full blocks still go back once they are drained
+template <class T, std::size_t BLOCK_SIZE = 32, HAKLE_CONCEPT( IsPolicy ) Policy = CounterCheckPolicy<BLOCK_SIZE>>
+class SharedMemoryConcurrentQueue {
+public:
+    using ValueType = T;
+    using BlockType = HakleBlock<T, BLOCK_SIZE, Policy>;
+
+    static constexpr std::size_t BlockSize = BLOCK_SIZE;
+
+    static_assert( std::is_trivially_copyable<T>::value, "elements are copied through shared memory byte for byte" );
+    static_assert( BLOCK_SIZE > 1 && ( BLOCK_SIZE & ( BLOCK_SIZE - 1 ) ) == 0, "BLOCK_SIZE must be a power of 2" );
+    static_assert( Policy::HasMeaningfulSetResult, "the consumer that empties a block must know it, to give the block back" );
+    static_assert( std::atomic<std::uint64_t>::is_always_lock_free && std::atomic<std::uint32_t>::is_always_lock_free && std::atomic<OffsetPtr<BlockType>>::is_always_lock_free,
+                   "shared atomics must be lock free" );
+
+    // fixed when the region is created
+    struct Geometry {
+        std::uint32_t BlockCount{ 256 };
+        std::uint32_t MaxProducers{ 16 };
+        // blocks one producer can have in flight, a power of 2
+        std::uint32_t ProducerBlocks{ 64 };
+    };
+
+private:
+    static constexpr std::uint64_t Magic   = 0x5148534d454c4b48;  // "HKLEMSHQ"
+    static constexpr std::uint32_t Version = 2;
+    // not HAKLE_CACHE_LINE_SIZE, which may differ between the compilers of two processes sharing the region
+    static constexpr std::size_t RegionAlign = 64;
+
+    static_assert( alignof( BlockType ) <= RegionAlign, "blocks are placed at RegionAlign" );
+
+    enum SlotState : std::uint32_t { Unused = 0, Active, Detached };
+
+    using RingEntry = std::atomic<OffsetPtr<BlockType>>;
+
+    // one producer. followed in the region by ProducerBlocks RingEntry, entry n % ProducerBlocks holds the block of
+    // elements [ n * BLOCK_SIZE, ( n + 1 ) * BLOCK_SIZE ) until the consumer that empties it clears the entry
+    struct alignas( RegionAlign ) ProducerSlot {
+        std::atomic<std::uint64_t>                        HeadIndex{ 0 };
+        alignas( RegionAlign ) std::atomic<std::uint64_t> TailIndex{ 0 };
+        std::atomic<std::uint32_t>                        State{ Unused };
+    };
+
+    struct alignas( RegionAlign ) Header {
+        std::atomic<std::uint64_t> Ready{ 0 };  // Magic once the creator is done
+        std::uint32_t              RegionVersion{ Version };
+        std::uint32_t              ElementSize{ sizeof( T ) };
+        std::uint32_t              BlockBytes{ sizeof( BlockType ) };
+        std::uint32_t              BlockSizeValue{ BLOCK_SIZE };
+        Geometry                   Shape{};
+        std::uint64_t              RegionBytes{ 0 };
+        std::uint64_t              SlotStride{ 0 };
+
+        OffsetPtr<ProducerSlot>               Slots{};
+        OffsetPtr<std::atomic<std::uint32_t>> FreeLinks{};  // FreeLinks[ i ] is the block number after block i + 1
+        OffsetPtr<BlockType>                  Blocks{};
+
+        // tag << 32 | block number, block numbers start at 1; the tag keeps a stale pop from succeeding
+        alignas( RegionAlign ) std::atomic<std::uint64_t> FreeHead{ 0 };
+        std::atomic<std::uint32_t> SlotCount{ 0 };
+    };
+
+    struct Placement {
+        std::uint64_t Slots;
+        std::uint64_t SlotStride;
+        std::uint64_t FreeLinks;
+        std::uint64_t Blocks;
+        std::uint64_t Total;
+    };
+
+    static constexpr std::uint64_t AlignUp( std::uint64_t Value ) noexcept { return ( Value + RegionAlign - 1 ) & ~static_cast<std::uint64_t>( RegionAlign - 1 ); }
+
+    static constexpr Placement Place( const Geometry& Shape ) noexcept {
+        Placement Result{};
+        Result.Slots      = AlignUp( sizeof( Header ) );
+        Result.SlotStride = AlignUp( sizeof( ProducerSlot ) + std::uint64_t{ Shape.ProducerBlocks } * sizeof( RingEntry ) );
+        Result.FreeLinks  = Result.Slots + Result.SlotStride * Shape.MaxProducers;
+        Result.Blocks     = AlignUp( Result.FreeLinks + std::uint64_t{ Shape.BlockCount } * sizeof( std::atomic<std::uint32_t> ) );
+        Result.Total      = Result.Blocks + std::uint64_t{ Shape.BlockCount } * sizeof( BlockType );
+        return Result;
+    }
+
+public:
+    class ProducerToken {
+    public:
+        ProducerToken() = default;
+        ~ProducerToken() {
+            if ( Slot != nullptr ) {
+                Slot->State.store( Detached, std::memory_order_release );
+            }
+        }
+
+        ProducerToken( ProducerToken&& Other ) noexcept : Slot( std::exchange( Other.Slot, nullptr ) ) {}
+        ProducerToken& operator=( ProducerToken&& Other ) noexcept {
+            std::swap( Slot, Other.Slot );
+            return *this;
+        }
+
+        ProducerToken( const ProducerToken& )            = delete;
+        ProducerToken& operator=( const ProducerToken& ) = delete;
+
+        HAKLE_NODISCARD bool Valid() const noexcept { return Slot != nullptr; }
+
+    private:
+        friend class SharedMemoryConcurrentQueue;
+        explicit ProducerToken( ProducerSlot* InSlot ) noexcept : Slot( InSlot ) {}
+
+        ProducerSlot* Slot{ nullptr };
+    };
+
+    // a new anonymous region, other processes get it through fork or by receiving Fd() over a unix socket
+    static SharedMemoryConcurrentQueue Create( const Geometry& Shape = Geometry{} ) {
+        SharedMemoryConcurrentQueue Queue( ::memfd_create( "hakle-queue", MFD_CLOEXEC ), "memfd_create" );
+        Queue.Initialize( Shape );
+        return Queue;
+    }
+
+    // a new region under a shm_open name, fails if the name is taken
+    static SharedMemoryConcurrentQueue Create( const char* Name, const Geometry& Shape = Geometry{} ) {
+        SharedMemoryConcurrentQueue Queue( ::shm_open( Name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600 ), "shm_open" );
+        HAKLE_TRY { Queue.Initialize( Shape ); }
+        HAKLE_CATCH( ... ) {
+            ::shm_unlink( Name );
+            HAKLE_RETHROW;
+        }
+        return Queue;
+    }
+
+    // maps a region made by Create, by name or by a descriptor for it; the queue keeps its own copy of Fd
+    static SharedMemoryConcurrentQueue Open( const char* Name ) {
+        SharedMemoryConcurrentQueue Queue( ::shm_open( Name, O_RDWR | O_CLOEXEC, 0 ), "shm_open" );
+        Queue.Attach();
+        return Queue;
+    }
+
+    static SharedMemoryConcurrentQueue Open( int Fd ) {
+        SharedMemoryConcurrentQueue Queue( ::fcntl( Fd, F_DUPFD_CLOEXEC, 0 ), "fcntl" );
+        Queue.Attach();
+        return Queue;
+    }
+
+    // the region lives on until every process has unmapped it
+    static void Unlink( const char* Name ) noexcept { ::shm_unlink( Name ); }
+
+    SharedMemoryConcurrentQueue( SharedMemoryConcurrentQueue&& Other ) noexcept { swap( Other ); }
+    SharedMemoryConcurrentQueue& operator=( SharedMemoryConcurrentQueue&& Other ) noexcept {
+        swap( Other );
+        return *this;
+    }
+
+    SharedMemoryConcurrentQueue( const SharedMemoryConcurrentQueue& )            = delete;
+    SharedMemoryConcurrentQueue& operator=( const SharedMemoryConcurrentQueue& ) = delete;
+
+    // NOTE: every ProducerToken of this mapping must be gone by now, the region itself stays for the others
+    ~SharedMemoryConcurrentQueue() {
+        if ( Base != nullptr ) {
+            ::munmap( Base, MappedBytes );
+        }
+        if ( Descriptor >= 0 ) {
+            ::close( Descriptor );
+        }
+    }
+
+    void swap( SharedMemoryConcurrentQueue& Other ) noexcept {
+        std::swap( Descriptor, Other.Descriptor );
+        std::swap( Base, Other.Base );
+        std::swap( MappedBytes, Other.MappedBytes );
+        std::swap( RegionHeader, Other.RegionHeader );
+        std::swap( Slots, Other.Slots );
+        std::swap( FreeLinks, Other.FreeLinks );
+        std::swap( Blocks, Other.Blocks );
+        std::swap( SlotStride, Other.SlotStride );
+        std::swap( RingMask, Other.RingMask );
+        std::uint32_t OtherRotation = Other.Rotation.load( std::memory_order_relaxed );
+        Other.Rotation.store( Rotation.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        Rotation.store( OtherRotation, std::memory_order_relaxed );
+    }
+
+    HAKLE_NODISCARD int             Fd() const noexcept { return Descriptor; }
+    HAKLE_NODISCARD const Geometry& GetGeometry() const noexcept { return RegionHeader->Shape; }
+
+    // reuses the slot of a dropped token when there is one, the token is invalid once all MaxProducers are taken
+    ProducerToken GetProducerToken() {
+        std::uint32_t Count = RegionHeader->SlotCount.load( std::memory_order_acquire );
+        for ( std::uint32_t i = 0; i < Count; ++i ) {
+            ProducerSlot& Slot     = SlotAt( i );
+            std::uint32_t Expected = Detached;
+            if ( Slot.State.load( std::memory_order_relaxed ) == Detached && Slot.State.compare_exchange_strong( Expected, Active, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+                return ProducerToken( &Slot );
+            }
+        }
+        while ( Count < RegionHeader->Shape.MaxProducers ) {
+            if ( RegionHeader->SlotCount.compare_exchange_weak( Count, Count + 1, std::memory_order_acq_rel, std::memory_order_acquire ) ) {
+                ProducerSlot& Slot = SlotAt( Count );
+                Slot.State.store( Active, std::memory_order_relaxed );
+                return ProducerToken( &Slot );
+            }
+        }
+        return ProducerToken{};
+    }
+
+    // false when the ring has no room for another block or the free list has none left
+    bool Enqueue( ProducerToken& Token, const T& Element ) { return EnqueueBulk( Token, &Element, 1 ); }
+
+    // all or nothing
+    template <class Iterator>
+    bool EnqueueBulk( ProducerToken& Token, Iterator ItemFirst, std::size_t Count ) {
+        assert( Token.Valid() );
+        ProducerSlot&       Slot    = *Token.Slot;
+        RingEntry*          Entries = EntriesOf( Slot );
+        const std::uint64_t Tail    = Slot.TailIndex.load( std::memory_order_relaxed );
+
+        // blocks starting in [ Tail, Tail + Count ), none of them can be seen by consumers yet
+        const std::uint64_t FirstNew = ( Tail + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+        const std::uint64_t End      = ( Tail + Count + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+        if ( End > FirstNew && End - FirstNew > RingMask + 1 ) {
+            return false;
+        }
+        // an entry still set holds a block that is not drained yet
+        for ( std::uint64_t n = FirstNew; n < End; ++n ) {
+            if ( Entries[ n & RingMask ].load( std::memory_order_relaxed ) ) {
+                return false;
+            }
+        }
+        if ( End > FirstNew && !TakeBlocks( Entries, FirstNew, End ) ) {
+            return false;
+        }
+
+        for ( std::uint64_t Index = Tail, Last = Tail + Count; Index != Last; ) {
+            BlockType*  Block = Entries[ ( Index / BLOCK_SIZE ) & RingMask ].load( std::memory_order_relaxed ).Get( Base );
+            std::size_t Inner = static_cast<std::size_t>( Index & ( BLOCK_SIZE - 1 ) );
+            std::size_t Step  = static_cast<std::size_t>( std::min<std::uint64_t>( Last - Index, BLOCK_SIZE - Inner ) );
+            for ( std::size_t i = 0; i < Step; ++i ) {
+                ::new ( static_cast<void*>( ( *Block )[ Inner + i ] ) ) T( *ItemFirst );
+                ++ItemFirst;
+            }
+            Index += Step;
+        }
+        Slot.TailIndex.store( Tail + Count, std::memory_order_release );
+        return true;
+    }
+
+    template <class U>
+    bool TryDequeue( U& Element ) {
+        return ConsumeFromAny( [ &Element ]( T& Value ) { Element = std::move( Value ); }, 1 ) != 0;
+    }
+
+    // from one producer at a time, returns the number of elements written to ItemFirst
+    template <class Iterator>
+    std::size_t TryDequeueBulk( Iterator ItemFirst, std::size_t MaxCount ) {
+        return ConsumeFromAny(
+            [ &ItemFirst ]( T& Value ) {
+                *ItemFirst = std::move( Value );
+                ++ItemFirst;
+            },
+            MaxCount );
+    }
+
+    // not exact under contention
+    HAKLE_NODISCARD std::size_t SizeApprox() const noexcept {
+        std::size_t   Size  = 0;
+        std::uint32_t Count = RegionHeader->SlotCount.load( std::memory_order_acquire );
+        for ( std::uint32_t i = 0; i < Count; ++i ) {
+            const ProducerSlot& Slot = SlotAt( i );
+            std::uint64_t       Tail = Slot.TailIndex.load( std::memory_order_relaxed );
+            std::uint64_t       Head = Slot.HeadIndex.load( std::memory_order_relaxed );
+            Size += Tail > Head ? static_cast<std::size_t>( Tail - Head ) : 0;
+        }
+        return Size;
+    }
+
+private:
+    SharedMemoryConcurrentQueue( int InDescriptor, const char* What ) : Descriptor( InDescriptor ) {
+        if ( Descriptor < 0 ) {
+            throw std::system_error( errno, std::generic_category(), What );
+        }
+    }
+
+    void Map( std::uint64_t Bytes ) {
+        void* Mapping = ::mmap( nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, Descriptor, 0 );
+        if ( Mapping == MAP_FAILED ) {
+            throw std::system_error( errno, std::generic_category(), "mmap" );
+        }
+        Base         = static_cast<std::byte*>( Mapping );
+        MappedBytes  = Bytes;
+        RegionHeader = reinterpret_cast<Header*>( Base );
+    }
+
+    void Initialize( const Geometry& Shape ) {
+        if ( Shape.BlockCount == 0 || Shape.MaxProducers == 0 || Shape.ProducerBlocks == 0 || ( Shape.ProducerBlocks & ( Shape.ProducerBlocks - 1 ) ) != 0 ) {
+            throw std::system_error( EINVAL, std::generic_category(), "SharedMemoryConcurrentQueue geometry" );
+        }
+        const Placement At = Place( Shape );
+        if ( ::ftruncate( Descriptor, static_cast<off_t>( At.Total ) ) != 0 ) {
+            throw std::system_error( errno, std::generic_category(), "ftruncate" );
+        }
+        Map( At.Total );
+
+        // the file starts out zeroed, so the entries of every ring are null
+        Header* NewHeader      = ::new ( static_cast<void*>( Base ) ) Header{};
+        NewHeader->Shape       = Shape;
+        NewHeader->RegionBytes = At.Total;
+        NewHeader->SlotStride  = At.SlotStride;
+        NewHeader->Slots       = OffsetPtr<ProducerSlot>{ At.Slots };
+        NewHeader->FreeLinks   = OffsetPtr<std::atomic<std::uint32_t>>{ At.FreeLinks };
+        NewHeader->Blocks      = OffsetPtr<BlockType>{ At.Blocks };
+        for ( std::uint32_t i = 0; i < Shape.MaxProducers; ++i ) {
+            ::new ( static_cast<void*>( Base + At.Slots + At.SlotStride * i ) ) ProducerSlot{};
+        }
+        for ( std::uint32_t i = 0; i < Shape.BlockCount; ++i ) {
+            ::new ( static_cast<void*>( Base + At.FreeLinks + i * sizeof( std::atomic<std::uint32_t> ) ) ) std::atomic<std::uint32_t>{ 0 };
+            ::new ( static_cast<void*>( Base + At.Blocks + i * sizeof( BlockType ) ) ) BlockType{};
+        }
+        Bind();
+        for ( std::uint32_t i = Shape.BlockCount; i != 0; --i ) {
+            ReturnBlock( i );
+        }
+        RegionHeader->Ready.store( Magic, std::memory_order_release );
+    }
+
+    void Attach() {
+        struct stat Status {};
+        if ( ::fstat( Descriptor, &Status ) != 0 ) {
+            throw std::system_error( errno, std::generic_category(), "fstat" );
+        }
+        if ( static_cast<std::uint64_t>( Status.st_size ) < sizeof( Header ) ) {
+            throw std::system_error( EINVAL, std::generic_category(), "not a SharedMemoryConcurrentQueue region" );
+        }
+        Map( static_cast<std::uint64_t>( Status.st_size ) );
+
+        // everything is checked against what this process would have laid out for the same geometry
+        const Header&   Found = *RegionHeader;
+        const Placement At    = Place( Found.Shape );
+        if ( Found.Ready.load( std::memory_order_acquire ) != Magic || Found.RegionVersion != Version || Found.ElementSize != sizeof( T ) || Found.BlockBytes != sizeof( BlockType ) ||
+             Found.BlockSizeValue != BLOCK_SIZE || Found.Shape.ProducerBlocks == 0 || ( Found.Shape.ProducerBlocks & ( Found.Shape.ProducerBlocks - 1 ) ) != 0 || Found.RegionBytes != At.Total ||
+             At.Total > MappedBytes || Found.SlotStride != At.SlotStride || Found.Slots.Offset != At.Slots || Found.FreeLinks.Offset != At.FreeLinks || Found.Blocks.Offset != At.Blocks ) {
+            throw std::system_error( EINVAL, std::generic_category(), "SharedMemoryConcurrentQueue region does not match" );
+        }
+        Bind();
+    }
+
+    // process local shortcuts into the mapping
+    void Bind() noexcept {
+        Slots      = reinterpret_cast<std::byte*>( RegionHeader->Slots.Get( Base ) );
+        FreeLinks  = RegionHeader->FreeLinks.Get( Base );
+        Blocks     = RegionHeader->Blocks.Get( Base );
+        SlotStride = RegionHeader->SlotStride;
+        RingMask   = RegionHeader->Shape.ProducerBlocks - 1;
+    }
+
+    ProducerSlot&       SlotAt( std::uint32_t Index ) noexcept { return *reinterpret_cast<ProducerSlot*>( Slots + SlotStride * Index ); }
+    const ProducerSlot& SlotAt( std::uint32_t Index ) const noexcept { return *reinterpret_cast<const ProducerSlot*>( Slots + SlotStride * Index ); }
+
+    static RingEntry* EntriesOf( ProducerSlot& Slot ) noexcept { return reinterpret_cast<RingEntry*>( reinterpret_cast<std::byte*>( &Slot ) + sizeof( ProducerSlot ) ); }
+
+    // fills the entries of [ FirstNew, End ) from the free list, or none of them
+    bool TakeBlocks( RingEntry* Entries, std::uint64_t FirstNew, std::uint64_t End ) noexcept {
+        // the blocks taken so far are ours, so their free list links can chain them
+        std::uint32_t Taken = 0;
+        for ( std::uint64_t n = FirstNew; n < End; ++n ) {
+            std::uint32_t Number = TakeBlock();
+            if ( Number == 0 ) {
+                while ( Taken != 0 ) {
+                    std::uint32_t Next = FreeLinks[ Taken - 1 ].load( std::memory_order_relaxed );
+                    ReturnBlock( Taken );
+                    Taken = Next;
+                }
+                return false;
+            }
+            FreeLinks[ Number - 1 ].store( Taken, std::memory_order_relaxed );
+            Taken = Number;
+        }
+        for ( std::uint64_t n = FirstNew; n < End; ++n ) {
+            BlockType* Block = Blocks + ( Taken - 1 );
+            Taken            = FreeLinks[ Taken - 1 ].load( std::memory_order_relaxed );
+            Block->Reset();
+            Entries[ n & RingMask ].store( OffsetPtr<BlockType>::From( Base, Block ), std::memory_order_relaxed );
+        }
+        return true;
+    }
+
+    // block numbers start at 1, 0 means the free list is empty
+    std::uint32_t TakeBlock() noexcept {
+        std::uint64_t Head = RegionHeader->FreeHead.load( std::memory_order_acquire );
+        for ( ;; ) {
+            std::uint32_t Number = static_cast<std::uint32_t>( Head );
+            if ( Number == 0 ) {
+                return 0;
+            }
+            std::uint64_t Next = FreeLinks[ Number - 1 ].load( std::memory_order_relaxed );
+            if ( RegionHeader->FreeHead.compare_exchange_weak( Head, ( ( Head >> 32 ) + 1 ) << 32 | Next, std::memory_order_acquire, std::memory_order_acquire ) ) {
+                return Number;
+            }
+        }
+    }
+
+    void ReturnBlock( std::uint32_t Number ) noexcept {
+        std::uint64_t Head = RegionHeader->FreeHead.load( std::memory_order_relaxed );
+        do {
+            FreeLinks[ Number - 1 ].store( static_cast<std::uint32_t>( Head ), std::memory_order_relaxed );
+        } while ( !RegionHeader->FreeHead.compare_exchange_weak( Head, ( ( Head >> 32 ) + 1 ) << 32 | Number, std::memory_order_release, std::memory_order_relaxed ) );
+    }
+
+    // claims up to MaxCount elements of one producer, starting somewhere else every time
+    template <class Function>
+    std::size_t ConsumeFromAny( Function&& Func, std::size_t MaxCount ) {
+        std::uint32_t Count = RegionHeader->SlotCount.load( std::memory_order_acquire );
+        if ( Count == 0 || MaxCount == 0 ) {
+            return 0;
+        }
+        std::uint32_t Start = Rotation.fetch_add( 1, std::memory_order_relaxed ) % Count;
+        for ( std::uint32_t i = 0; i < Count; ++i ) {
+            std::uint32_t Index = Start + i < Count ? Start + i : Start + i - Count;
+            if ( std::size_t Consumed = Consume( SlotAt( Index ), Func, MaxCount ) ) {
+                return Consumed;
+            }
+        }
+        return 0;
+    }
+
+    template <class Function>
+    std::size_t Consume( ProducerSlot& Slot, Function& Func, std::size_t MaxCount ) {
+        std::uint64_t Head = Slot.HeadIndex.load( std::memory_order_relaxed );
+        std::uint64_t Count;
+        do {
+            std::uint64_t Tail = Slot.TailIndex.load( std::memory_order_acquire );
+            if ( Head >= Tail ) {
+                return 0;
+            }
+            Count = std::min<std::uint64_t>( Tail - Head, MaxCount );
+        } while ( !Slot.HeadIndex.compare_exchange_weak( Head, Head + Count, std::memory_order_relaxed, std::memory_order_relaxed ) );
+
+        // the blocks of claimed elements stay in the ring until we mark them empty
+        RingEntry* Entries = EntriesOf( Slot );
+        for ( std::uint64_t Index = Head, Last = Head + Count; Index != Last; ) {
+            RingEntry&  Entry = Entries[ ( Index / BLOCK_SIZE ) & RingMask ];
+            BlockType*  Block = Entry.load( std::memory_order_relaxed ).Get( Base );
+            std::size_t Inner = static_cast<std::size_t>( Index & ( BLOCK_SIZE - 1 ) );
+            std::size_t Step  = static_cast<std::size_t>( std::min<std::uint64_t>( Last - Index, BLOCK_SIZE - Inner ) );
+            for ( std::size_t i = 0; i < Step; ++i ) {
+                Func( *( *Block )[ Inner + i ] );
+            }
+            // the last of the block, every element of it was enqueued so the producer is past it for good.
+            // SetSomeEmpty only releases, the fence orders the other consumers' reads before the next owner
+            if ( Block->SetSomeEmpty( Inner, Step ) ) {
+                std::atomic_thread_fence( std::memory_order_acquire );
+                Entry.store( OffsetPtr<BlockType>{}, std::memory_order_relaxed );
+                ReturnBlock( static_cast<std::uint32_t>( Block - Blocks ) + 1 );
+            }
+            Index += Step;
+        }
+        return static_cast<std::size_t>( Count );
+    }
+
+    int                         Descriptor{ -1 };
+    std::byte*                  Base{ nullptr };
+    std::uint64_t               MappedBytes{ 0 };
+    Header*                     RegionHeader{ nullptr };
+    std::byte*                  Slots{ nullptr };
+    std::atomic<std::uint32_t>* FreeLinks{ nullptr };
+    BlockType*                  Blocks{ nullptr };
+    std::uint64_t               SlotStride{ 0 };
+    std::uint64_t               RingMask{ 0 };
+    // per mapping, consumers of different processes do not need to agree on where to start
+    std::atomic<std::uint32_t> Rotation{ 0 };
+};
+
+}  // namespace hakle
+
+#endif
+
+#endif  // SHAREDMEMORYCONCURRENTQUEUE_H
@@ -0,0 +1,217 @@
+//
+// Created by wwjszz on 26-10-16.
+//
+
+#ifndef SPILLSTORE_H
+#define SPILLSTORE_H
+
+#include "common/common.h"
+
+#if defined( __linux__ )
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace hakle {
+
+// Overflow storage of one sub-queue: elements past the producer's in-memory budget are appended to a chain of
+// fixed-size segment files and read back in order. Segments are unnamed O_TMPFILE files mapped MAP_SHARED,
+// so their pages are page cache the kernel can write back and drop instead of anonymous memory, and the file
+// is gone once the last consumer unmaps it. A finished segment is handed to writeback in one sequential batch.
+// Single producer; consumers take turns through a claim bit in Head, a consumer that finds it taken moves on.
+// NOTE: T must be trivially copyable, elements are copied into the mapping byte for byte
+template <class T, std::size_t SEGMENT_BYTES>
+class SpillStore {
+public:
+    static_assert( std::is_trivially_copyable<T>::value, "only trivially copyable elements can be spilled" );
+
+    static constexpr std::size_t SegmentCapacity = SEGMENT_BYTES / sizeof( T ) != 0 ? SEGMENT_BYTES / sizeof( T ) : 1;
+
+    SpillStore() = default;
+    ~SpillStore() {
+        Segment* Current = ReadSegment != nullptr ? ReadSegment : FirstSegment;
+        while ( Current != nullptr ) {
+            Segment* Next = Current->Next;
+            Close( Current );
+            Current = Next;
+        }
+    }
+
+    SpillStore( const SpillStore& )            = delete;
+    SpillStore& operator=( const SpillStore& ) = delete;
+
+    HAKLE_NODISCARD std::size_t Size() const noexcept {
+        std::size_t Tail = TailIndex.load( std::memory_order_relaxed );
+        std::size_t Head = HeadIndex.load( std::memory_order_relaxed ) >> 1;
+        return Tail > Head ? Tail - Head : 0;
+    }
+
+    // producer side, everything appended so far has been claimed
+    HAKLE_NODISCARD bool Drained() const noexcept { return ( HeadIndex.load( std::memory_order_acquire ) >> 1 ) == TailIndex.load( std::memory_order_relaxed ); }
+
+    // producer only. appends Count elements built from ItemFirst, all or nothing;
+    // CanCreate false only uses segments that already exist
+    template <class Iterator>
+    bool Append( Iterator ItemFirst, std::size_t Count, const char* Directory, bool CanCreate ) {
+        const std::size_t Tail = TailIndex.load( std::memory_order_relaxed );
+        Segment*          Seg  = WriteSegment;
+        std::size_t       Used = WriteUsed;
+
+        // make room first, so a failure leaves nothing half written; new segments stay linked for next time
+        std::size_t Room = Seg != nullptr ? SegmentCapacity - Used : 0;
+        for ( Segment* Spare = Seg != nullptr ? Seg->Next : FirstSegment; Room < Count; Spare = Spare->Next ) {
+            if ( Spare == nullptr ) {
+                if ( !CanCreate || ( Spare = Open( Directory ) ) == nullptr ) {
+                    return false;
+                }
+                // published to consumers by the release store of TailIndex
+                ( LastSegment != nullptr ? LastSegment->Next : FirstSegment ) = Spare;
+                LastSegment                                                   = Spare;
+            }
+            Room += SegmentCapacity;
+        }
+
+        for ( std::size_t Left = Count; Left != 0; ) {
+            if ( Seg == nullptr || Used == SegmentCapacity ) {
+                if ( Seg != nullptr ) {
+                    // full: start writing it back now, as one sequential run
+                    ::sync_file_range( Seg->Fd, 0, SegmentCapacity * sizeof( T ), SYNC_FILE_RANGE_WRITE );
+                }
+                Seg  = Seg != nullptr ? Seg->Next : FirstSegment;
+                Used = 0;
+            }
+            std::size_t Step = std::min( Left, SegmentCapacity - Used );
+            for ( std::size_t i = 0; i < Step; ++i ) {
+                ::new ( static_cast<void*>( Seg->Items + Used + i ) ) T( *ItemFirst );
+                ++ItemFirst;
+            }
+            Used += Step;
+            Left -= Step;
+        }
+
+        WriteSegment = Seg;
+        WriteUsed    = Used;
+        TailIndex.store( Tail + Count, std::memory_order_release );
+        return true;
+    }
+
+    // consumer side, hands up to MaxCount elements to Func( T& ) one by one or to Func( T*, std::size_t ) per run.
+    // CanRead is asked after the tail is read and before anything is claimed, the sub-queue uses it to hold
+    // spilled elements back until its in-memory ones are gone. if Func throws, the claimed rest is dropped;
+    // Claimed, if given, is increased by the number of elements taken before Func sees any of them
+    template <class Function, class Predicate>
+    std::size_t Consume( Function& Func, std::size_t MaxCount, Predicate&& CanRead, std::size_t* Claimed = nullptr ) {
+        std::size_t Head = HeadIndex.load( std::memory_order_relaxed );
+        if ( MaxCount == 0 || ( Head & ClaimBit ) != 0 ) {
+            return 0;
+        }
+        std::size_t Tail = TailIndex.load( std::memory_order_acquire );
+        if ( ( Head >> 1 ) >= Tail || !CanRead() ) {
+            return 0;
+        }
+        if ( !HeadIndex.compare_exchange_strong( Head, Head | ClaimBit, std::memory_order_acquire, std::memory_order_relaxed ) ) {
+            return 0;
+        }
+
+        std::size_t Index = Head >> 1;
+        std::size_t Count = std::min( Tail - Index, MaxCount );
+        if ( Claimed != nullptr ) {
+            *Claimed += Count;
+        }
+        struct Publish {
+            std::atomic<std::size_t>& HeadIndex;
+            std::size_t               NewHead;
+            ~Publish() { HeadIndex.store( NewHead << 1, std::memory_order_release ); }
+        } publish{ HeadIndex, Index + Count };
+
+        if ( ReadSegment == nullptr ) {
+            ReadSegment = FirstSegment;
+        }
+        for ( std::size_t Left = Count; Left != 0; ) {
+            // segments behind the head are done, they are only closed here where nobody can still read them
+            while ( Index >= ReadBase + SegmentCapacity ) {
+                Segment* Done = ReadSegment;
+                ReadSegment   = Done->Next;
+                ReadBase += SegmentCapacity;
+                Close( Done );
+            }
+            std::size_t Step  = std::min( Left, ReadBase + SegmentCapacity - Index );
+            T*          Items = ReadSegment->Items + ( Index - ReadBase );
+            HAKLE_CONSTEXPR_IF( std::is_invocable<Function&, T*, std::size_t>::value ) { Func( Items, Step ); }
+            else {
+                for ( std::size_t i = 0; i < Step; ++i ) {
+                    Func( Items[ i ] );
+                }
+            }
+            Index += Step;
+            Left -= Step;
+        }
+        return Count;
+    }
+
+private:
+    struct Segment {
+        Segment* Next{ nullptr };
+        T*       Items{ nullptr };
+        int      Fd{ -1 };
+    };
+
+    static constexpr std::size_t ClaimBit = 1;
+
+    static Segment* Open( const char* Directory ) noexcept {
+        const std::size_t Bytes = SegmentCapacity * sizeof( T );
+        int               Fd    = ::open( Directory, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600 );
+        if ( Fd < 0 ) {
+            return nullptr;
+        }
+        void* Mapping = MAP_FAILED;
+        if ( ::ftruncate( Fd, static_cast<off_t>( Bytes ) ) == 0 ) {
+            Mapping = ::mmap( nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0 );
+        }
+        Segment* NewSegment = Mapping != MAP_FAILED ? new ( std::nothrow ) Segment{} : nullptr;
+        if ( NewSegment == nullptr ) {
+            if ( Mapping != MAP_FAILED ) {
+                ::munmap( Mapping, Bytes );
+            }
+            ::close( Fd );
+            return nullptr;
+        }
+        // written front to back and read back the same way
+        ::madvise( Mapping, Bytes, MADV_SEQUENTIAL );
+        NewSegment->Items = static_cast<T*>( Mapping );
+        NewSegment->Fd    = Fd;
+        return NewSegment;
+    }
+
+    static void Close( Segment* InSegment ) noexcept {
+        ::munmap( InSegment->Items, SegmentCapacity * sizeof( T ) );
+        ::close( InSegment->Fd );
+        delete InSegment;
+    }
+
+    // element index << 1, ClaimBit while a consumer is reading; ReadSegment / ReadBase belong to the claimer
+    std::atomic<std::size_t> HeadIndex{ 0 };
+    Segment*                 ReadSegment{ nullptr };
+    std::size_t              ReadBase{ 0 };
+
+    // producer side
+    std::atomic<std::size_t> TailIndex{ 0 };
+    Segment*                 FirstSegment{ nullptr };
+    Segment*                 WriteSegment{ nullptr };
+    std::size_t              WriteUsed{ 0 };
+    Segment*                 LastSegment{ nullptr };
+};
+
+}  // namespace hakle
+
+#endif
+
+#endif  // SPILLSTORE_H
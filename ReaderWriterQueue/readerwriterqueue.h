@@ -84,6 +84,10 @@ public:
         return Value.compare_exchange_strong( Expected, Desired, std::memory_order_relaxed );
     }
 
+    bool CompareExchangeWeakAcquire( T& Expected, T Desired ) noexcept {
+        return Value.compare_exchange_weak( Expected, Desired, std::memory_order_acquire, std::memory_order_relaxed );
+    }
+
 private:
     std::atomic<T> Value;
 };
@@ -574,7 +578,7 @@ private:
 };
 
 #if HAKLE_CPP_VERSION >= 20
-using Semaphore = std::binary_semaphore;
+using Semaphore = std::counting_semaphore<>;
 
 //---------------------------------------------------------
 // LightweightSemaphore
@@ -586,21 +590,48 @@ public:
     explicit LightWeightSemaphore( signed_size_t InitialCount = 0 ) : Count( InitialCount ), Sem( 0 ) { assert( InitialCount >= 0 ); }
 
     bool TryWait() noexcept {
-        if ( Count.Load() > 0 ) {
-            Count.FetchAddAcquire( -1 );
-            return true;
+        signed_size_t OldCount = Count.Load();
+        while ( OldCount > 0 ) {
+            if ( Count.CompareExchangeWeakAcquire( OldCount, OldCount - 1 ) ) {
+                return true;
+            }
         }
         return false;
     }
 
+    // Timeout is in milliseconds, -1 waits forever
     bool Wait( const std::int64_t Timeout = -1 ) { return TryWait() || TryWaitWithPartialSpinning( Timeout ); }
 
+    // acquire up to Max permits without blocking, returns the number acquired
+    signed_size_t TryWaitMany( signed_size_t Max ) noexcept {
+        assert( Max >= 0 );
+        signed_size_t OldCount = Count.Load();
+        while ( OldCount > 0 ) {
+            signed_size_t NewCount = OldCount > Max ? OldCount - Max : 0;
+            if ( Count.CompareExchangeWeakAcquire( OldCount, NewCount ) ) {
+                return OldCount - NewCount;
+            }
+        }
+        return 0;
+    }
+
+    // acquire at least one and up to Max permits, returns 0 only on timeout
+    signed_size_t WaitMany( signed_size_t Max, const std::int64_t Timeout = -1 ) {
+        assert( Max >= 0 );
+        signed_size_t Result = TryWaitMany( Max );
+        if ( Result == 0 && Max > 0 ) {
+            Result = TryWaitManyWithPartialSpinning( Max, Timeout );
+        }
+        return Result;
+    }
+
     void Signal( signed_size_t Num = 1 ) {
         assert( Num > 0 );
         const signed_size_t OldCount = Count.FetchAddRelease( Num );
-        assert( OldCount >= -1 );
-        if ( OldCount < 0 ) {
-            Sem.release();
+        // wake at most as many waiters as are currently blocked
+        const signed_size_t ToRelease = -OldCount < Num ? -OldCount : Num;
+        if ( ToRelease > 0 ) {
+            Sem.release( static_cast<std::ptrdiff_t>( ToRelease ) );
         }
     }
 
@@ -614,11 +645,9 @@ private:
         // spin
         short spin = 1024;
         while ( --spin >= 0 ) {
-            if ( Count.Load() > 0 ) {
-                Count.FetchAddAcquire( -1 );
+            if ( TryWait() ) {
                 return true;
             }
-            // TODO: Prevent the compiler from collapsing the loop.
         }
         // sub
         signed_size_t OldCount = Count.FetchAddAcquire( -1 );
@@ -632,16 +661,49 @@ private:
         if ( Timeout > 0 && Sem.try_acquire_for( std::chrono::milliseconds( Timeout ) ) ) {
             return true;
         }
-        // since we sub, we need to add
-        while ( true ) {
-            OldCount = Count.FetchAdd( 1 );
-            if ( OldCount < 0 ) {
+        // we timed out but are still counted as a waiter: take our decrement back while the count says
+        // someone is waiting, otherwise a Signal already counted us as woken and its release is on the way
+        OldCount = Count.Load();
+        while ( OldCount < 0 ) {
+            if ( Count.CompareExchangeStrong( OldCount, OldCount + 1 ) ) {
                 return false;
             }
-            else if ( Sem.try_acquire() ) {
-                return true;
+        }
+        Sem.acquire();
+        return true;
+    }
+
+    signed_size_t TryWaitManyWithPartialSpinning( signed_size_t Max, const std::int64_t Timeout = -1 ) {
+        // spin
+        short spin = 1024;
+        while ( --spin >= 0 ) {
+            if ( signed_size_t Result = TryWaitMany( Max ); Result > 0 ) {
+                return Result;
+            }
+        }
+        // block for a single permit, then grab whatever else is already there
+        signed_size_t OldCount = Count.FetchAddAcquire( -1 );
+        if ( OldCount <= 0 ) {
+            bool Acquired = false;
+            if ( Timeout < 0 ) {
+                Sem.acquire();
+                Acquired = true;
+            }
+            else if ( Timeout > 0 ) {
+                Acquired = Sem.try_acquire_for( std::chrono::milliseconds( Timeout ) );
+            }
+            if ( !Acquired ) {
+                // same undo as the single-permit wait
+                OldCount = Count.Load();
+                while ( OldCount < 0 ) {
+                    if ( Count.CompareExchangeStrong( OldCount, OldCount + 1 ) ) {
+                        return 0;
+                    }
+                }
+                Sem.acquire();
             }
         }
+        return Max > 1 ? 1 + TryWaitMany( Max - 1 ) : 1;
     }
 
     WeakAtomic<signed_size_t> Count;
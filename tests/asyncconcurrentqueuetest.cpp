@@ -0,0 +1,336 @@
+#include "ConcurrentQueue/AsyncConcurrentQueue.h"
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace hakle;
+
+namespace {
+
+// fire-and-forget coroutine, runs until its first real suspension
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask        get_return_object() noexcept { return {}; }
+        std::suspend_never  initial_suspend() noexcept { return {}; }
+        std::suspend_never  final_suspend() noexcept { return {}; }
+        void                return_void() noexcept {}
+        void                unhandled_exception() noexcept { std::terminate(); }
+    };
+};
+
+// collects posted handles, the test decides when they run
+struct ManualExecutor {
+    void Post( std::coroutine_handle<> Handle ) { Handles.push_back( Handle ); }
+
+    std::size_t RunAll() {
+        std::size_t Count = 0;
+        while ( !Handles.empty() ) {
+            std::coroutine_handle<> Handle = Handles.front();
+            Handles.pop_front();
+            Handle.resume();
+            ++Count;
+        }
+        return Count;
+    }
+
+    std::deque<std::coroutine_handle<>> Handles;
+};
+
+// one worker thread draining posted handles
+class ThreadExecutor {
+public:
+    ThreadExecutor()
+        : Worker( [ this ] {
+            std::unique_lock<std::mutex> Lock( Mutex );
+            for ( ;; ) {
+                Cond.wait( Lock, [ this ] { return Stopped || !Handles.empty(); } );
+                if ( Handles.empty() ) {
+                    return;
+                }
+                std::coroutine_handle<> Handle = Handles.front();
+                Handles.pop_front();
+                Lock.unlock();
+                Handle.resume();
+                Lock.lock();
+            }
+        } ) {}
+
+    ~ThreadExecutor() {
+        {
+            std::lock_guard<std::mutex> Lock( Mutex );
+            Stopped = true;
+        }
+        Cond.notify_one();
+        Worker.join();
+    }
+
+    void Post( std::coroutine_handle<> Handle ) {
+        {
+            std::lock_guard<std::mutex> Lock( Mutex );
+            Handles.push_back( Handle );
+        }
+        Cond.notify_one();
+    }
+
+private:
+    std::mutex                          Mutex;
+    std::condition_variable             Cond;
+    std::deque<std::coroutine_handle<>> Handles;
+    bool                                Stopped{ false };
+    std::thread                         Worker;
+};
+
+DetachedTask ReceiveOne( AsyncConcurrentQueue<int>& queue, int& out ) { out = co_await AsyncDequeue( queue ); }
+
+template <class Executor>
+DetachedTask ReceiveOneOn( AsyncConcurrentQueue<int>& queue, Executor& executor, int& out ) {
+    out = co_await AsyncDequeue( queue, executor );
+}
+
+}  // namespace
+
+TEST( AsyncConcurrentQueueTest, ReadyElementDoesNotSuspend ) {
+    AsyncConcurrentQueue<int> queue;
+    EXPECT_TRUE( queue.Enqueue( 3 ) );
+
+    int value = -1;
+    ReceiveOne( queue, value );
+    EXPECT_EQ( value, 3 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( AsyncConcurrentQueueTest, SuspendsUntilEnqueue ) {
+    AsyncConcurrentQueue<int> queue;
+
+    int value = -1;
+    ReceiveOne( queue, value );
+    EXPECT_EQ( value, -1 );
+
+    // without an executor the waiter runs inline on the enqueuing thread
+    EXPECT_TRUE( queue.Enqueue( 42 ) );
+    EXPECT_EQ( value, 42 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( AsyncConcurrentQueueTest, ResumesOnExecutor ) {
+    AsyncConcurrentQueue<int> queue;
+    ManualExecutor            executor;
+
+    int value = -1;
+    ReceiveOneOn( queue, executor, value );
+    EXPECT_TRUE( executor.Handles.empty() );
+
+    EXPECT_TRUE( queue.Enqueue( 7 ) );
+    EXPECT_EQ( value, -1 );
+    EXPECT_EQ( executor.RunAll(), 1 );
+    EXPECT_EQ( value, 7 );
+}
+
+TEST( AsyncConcurrentQueueTest, BurstWakesOnlyAsManyAsThereAreElements ) {
+    AsyncConcurrentQueue<int> queue;
+    ManualExecutor            executor;
+
+    constexpr int    waiterCount = 8;
+    std::vector<int> values( waiterCount, -1 );
+    for ( int i = 0; i < waiterCount; ++i ) {
+        ReceiveOneOn( queue, executor, values[ i ] );
+    }
+
+    std::vector<int> input{ 0, 1, 2 };
+    EXPECT_TRUE( queue.EnqueueBulk( input.begin(), input.size() ) );
+    EXPECT_EQ( executor.RunAll(), 3 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+
+    input = { 3, 4, 5, 6, 7 };
+    EXPECT_TRUE( queue.EnqueueBulk( input.begin(), input.size() ) );
+    EXPECT_EQ( executor.RunAll(), 5 );
+
+    // oldest waiters are served first, and every element lands in exactly one of them
+    EXPECT_EQ( values[ 0 ], 0 );
+    EXPECT_EQ( values[ 1 ], 1 );
+    EXPECT_EQ( values[ 2 ], 2 );
+    std::sort( values.begin(), values.end() );
+    for ( int i = 0; i < waiterCount; ++i ) {
+        EXPECT_EQ( values[ i ], i );
+    }
+}
+
+TEST( AsyncConcurrentQueueTest, DequeueBulkWithToken ) {
+    AsyncConcurrentQueue<int> queue;
+    auto                      producer = queue.GetProducerToken();
+    auto                      consumer = queue.GetConsumerToken();
+    ManualExecutor            executor;
+
+    std::vector<int> output( 8, -1 );
+    std::size_t      count = 0;
+    auto             task  = [ & ]() -> DetachedTask { count = co_await AsyncDequeueBulk( queue, consumer, output.begin(), output.size(), executor ); };
+    task();
+    EXPECT_TRUE( executor.Handles.empty() );
+
+    std::vector<int> input( 5 );
+    std::iota( input.begin(), input.end(), 10 );
+    EXPECT_TRUE( queue.EnqueueBulk( producer, input.begin(), input.size() ) );
+    EXPECT_EQ( executor.RunAll(), 1 );
+    EXPECT_EQ( count, 5 );
+    for ( int i = 0; i < 5; ++i ) {
+        EXPECT_EQ( output[ i ], 10 + i );
+    }
+
+    // MaxCount of zero never suspends
+    auto empty = [ & ]() -> DetachedTask { count = co_await AsyncDequeueBulk( queue, output.begin(), 0 ); };
+    count      = 1;
+    empty();
+    EXPECT_EQ( count, 0 );
+}
+
+TEST( AsyncConcurrentQueueTest, MultiProducerMultiConsumer ) {
+    AsyncConcurrentQueue<int> queue;
+    ThreadExecutor            executors[ 2 ];
+
+    constexpr int           producerCount = 4;
+    constexpr int           consumerCount = 4;
+    constexpr int           itemsPerProd  = 20000;
+    constexpr std::uint64_t totalItems    = static_cast<std::uint64_t>( producerCount ) * itemsPerProd;
+
+    std::atomic<std::uint64_t> consumed{ 0 };
+    std::atomic<std::uint64_t> sum{ 0 };
+    std::atomic<int>           finished{ 0 };
+
+    // every consumer stops at the first negative value, one per consumer is enqueued at the end
+    auto consume = [ & ]( ThreadExecutor& executor, bool bulk ) -> DetachedTask {
+        auto token = queue.GetConsumerToken();
+        for ( bool done = false; !done; ) {
+            int         items[ 16 ];
+            std::size_t count = 0;
+            if ( bulk ) {
+                count = co_await AsyncDequeueBulk( queue, token, items, 16, executor );
+            }
+            else {
+                items[ 0 ] = co_await AsyncDequeue( queue, executor );
+                count      = 1;
+            }
+            for ( std::size_t i = 0; i < count; ++i ) {
+                if ( items[ i ] < 0 ) {
+                    done = true;
+                    continue;
+                }
+                sum.fetch_add( static_cast<std::uint64_t>( items[ i ] ), std::memory_order_relaxed );
+                consumed.fetch_add( 1, std::memory_order_relaxed );
+            }
+        }
+        finished.fetch_add( 1, std::memory_order_release );
+    };
+    for ( int c = 0; c < consumerCount; ++c ) {
+        consume( executors[ c & 1 ], c < 2 );
+    }
+
+    std::vector<std::thread> threads;
+    for ( int p = 0; p < producerCount; ++p ) {
+        threads.emplace_back( [ &, p ] {
+            auto token = queue.GetProducerToken();
+            for ( int i = 0; i < itemsPerProd; ++i ) {
+                int value = p * itemsPerProd + i;
+                if ( ( i & 1 ) == 0 ) {
+                    queue.EnqueueWithToken( token, value );
+                }
+                else {
+                    queue.Enqueue( value );
+                }
+            }
+        } );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+    while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+        std::this_thread::yield();
+    }
+    // a bulk consumer may swallow several stop values, so keep feeding them until everyone has left
+    while ( finished.load( std::memory_order_acquire ) < consumerCount ) {
+        queue.Enqueue( -1 );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+
+    EXPECT_EQ( consumed.load(), totalItems );
+    EXPECT_EQ( sum.load(), totalItems * ( totalItems - 1 ) / 2 );
+}
+
+TEST( AsyncConcurrentQueueTest, ParkingNeverResumesItselfInline ) {
+    AsyncConcurrentQueue<int> queue;
+
+    // runs every handle on the posting thread and remembers how deep resumes got nested
+    struct InlineExecutor {
+        void Post( std::coroutine_handle<> Handle ) {
+            static thread_local int depth = 0;
+            ++depth;
+            int seen = maxDepth.load( std::memory_order_relaxed );
+            while ( depth > seen && !maxDepth.compare_exchange_weak( seen, depth, std::memory_order_relaxed ) ) {
+            }
+            Handle.resume();
+            --depth;
+        }
+
+        std::atomic<int> maxDepth{ 0 };
+    } executor;
+
+    constexpr int    producerCount = 4;
+    constexpr int    itemsPerProd  = 50000;
+    std::atomic<int> consumed{ 0 };
+
+    // a single consumer, so any nesting means a waiter was resumed from inside its own await_suspend
+    auto consume = [ & ]() -> DetachedTask {
+        for ( int i = 0; i < producerCount * itemsPerProd; ++i ) {
+            co_await AsyncDequeue( queue, executor );
+            consumed.fetch_add( 1, std::memory_order_release );
+        }
+    };
+    consume();
+
+    std::vector<std::thread> threads;
+    for ( int p = 0; p < producerCount; ++p ) {
+        threads.emplace_back( [ & ] {
+            for ( int i = 0; i < itemsPerProd; ++i ) {
+                queue.Enqueue( i );
+            }
+        } );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+
+    EXPECT_EQ( consumed.load( std::memory_order_acquire ), producerCount * itemsPerProd );
+    EXPECT_LE( executor.maxDepth.load(), 1 );
+}
+
+TEST( AsyncConcurrentQueueTest, MovedFromQueueCanStillEnqueue ) {
+    AsyncConcurrentQueue<int> source;
+    AsyncConcurrentQueue<int> target( std::move( source ) );
+
+    // the waiter list went with the move, enqueueing must not look for waiters that are not there
+    EXPECT_TRUE( source.Enqueue( 1 ) );
+    int value = -1;
+    EXPECT_TRUE( source.TryDequeue( value ) );
+    EXPECT_EQ( value, 1 );
+
+    value = -1;
+    ReceiveOne( target, value );
+    EXPECT_TRUE( target.Enqueue( 2 ) );
+    EXPECT_EQ( value, 2 );
+
+    // moving back restores the waiter list
+    source = std::move( target );
+    value  = -1;
+    ReceiveOne( source, value );
+    EXPECT_TRUE( source.Enqueue( 3 ) );
+    EXPECT_EQ( value, 3 );
+}
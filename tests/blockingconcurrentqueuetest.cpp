@@ -0,0 +1,200 @@
+#include "ConcurrentQueue/BlockingConcurrentQueue.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace hakle;
+
+TEST( BlockingConcurrentQueueTest, TryDequeue ) {
+    BlockingConcurrentQueue<int> queue;
+
+    int value = 0;
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+
+    EXPECT_TRUE( queue.Enqueue( 1 ) );
+    EXPECT_TRUE( queue.Enqueue( 2 ) );
+    EXPECT_EQ( queue.SizeApprox(), 2 );
+
+    EXPECT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 1 );
+    EXPECT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 2 );
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( BlockingConcurrentQueueTest, TimedWaitTimesOut ) {
+    BlockingConcurrentQueue<int> queue;
+
+    int  value = 0;
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE( queue.WaitDequeueTimed( value, 20 ) );
+    EXPECT_FALSE( queue.WaitDequeueTimed( value, std::chrono::milliseconds( 20 ) ) );
+    EXPECT_GE( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 40 ) );
+
+    int items[ 4 ];
+    EXPECT_EQ( queue.WaitDequeueBulkTimed( items, 4, 0 ), 0 );
+    EXPECT_EQ( queue.WaitDequeueBulkTimed( items, 4, std::chrono::milliseconds( 10 ) ), 0 );
+
+    // a failed wait must not leave a stale permit behind
+    EXPECT_TRUE( queue.Enqueue( 7 ) );
+    EXPECT_TRUE( queue.WaitDequeueTimed( value, 0 ) );
+    EXPECT_EQ( value, 7 );
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+}
+
+TEST( BlockingConcurrentQueueTest, WaitDequeueWakesUp ) {
+    BlockingConcurrentQueue<int> queue;
+
+    std::atomic<int> received{ 0 };
+    std::thread      consumer( [ & ] {
+        int value = 0;
+        queue.WaitDequeue( value );
+        received.store( value, std::memory_order_relaxed );
+    } );
+
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    EXPECT_TRUE( queue.Enqueue( 42 ) );
+    consumer.join();
+    EXPECT_EQ( received.load(), 42 );
+}
+
+TEST( BlockingConcurrentQueueTest, WaitDequeueBulkTakesBurst ) {
+    BlockingConcurrentQueue<int> queue;
+    auto                         producer = queue.GetProducerToken();
+    auto                         consumer = queue.GetConsumerToken();
+
+    std::vector<int> input( 100 );
+    std::iota( input.begin(), input.end(), 0 );
+    EXPECT_TRUE( queue.EnqueueBulk( producer, input.begin(), input.size() ) );
+
+    std::vector<int> output( 64 );
+    EXPECT_EQ( queue.WaitDequeueBulk( consumer, output.begin(), output.size() ), 64 );
+    for ( int i = 0; i < 64; ++i ) {
+        EXPECT_EQ( output[ i ], i );
+    }
+    EXPECT_EQ( queue.WaitDequeueBulkTimed( consumer, output.begin(), output.size(), std::chrono::milliseconds( 10 ) ), 36 );
+    for ( int i = 0; i < 36; ++i ) {
+        EXPECT_EQ( output[ i ], 64 + i );
+    }
+    EXPECT_EQ( queue.TryDequeueBulk( output.begin(), output.size() ), 0 );
+}
+
+TEST( BlockingConcurrentQueueTest, MultiProducerMultiConsumer ) {
+    BlockingConcurrentQueue<int> queue;
+
+    constexpr int           producerCount = 4;
+    constexpr int           consumerCount = 4;
+    constexpr int           itemsPerProd  = 20000;
+    constexpr std::uint64_t totalItems    = static_cast<std::uint64_t>( producerCount ) * itemsPerProd;
+
+    std::atomic<std::uint64_t> consumed{ 0 };
+    std::atomic<std::uint64_t> sum{ 0 };
+
+    std::vector<std::thread> threads;
+    for ( int p = 0; p < producerCount; ++p ) {
+        threads.emplace_back( [ &, p ] {
+            auto token = queue.GetProducerToken();
+            for ( int i = 0; i < itemsPerProd; ++i ) {
+                int value = p * itemsPerProd + i;
+                if ( ( i & 1 ) == 0 ) {
+                    queue.EnqueueWithToken( token, value );
+                }
+                else {
+                    queue.Enqueue( value );
+                }
+            }
+        } );
+    }
+    for ( int c = 0; c < consumerCount; ++c ) {
+        threads.emplace_back( [ &, c ] {
+            auto token = queue.GetConsumerToken();
+            int  items[ 32 ];
+            while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                std::size_t count = 0;
+                if ( ( c & 1 ) == 0 ) {
+                    count = queue.WaitDequeueBulkTimed( token, items, 32, std::chrono::milliseconds( 5 ) );
+                }
+                else {
+                    count = queue.WaitDequeueTimed( items[ 0 ], 5 ) ? 1 : 0;
+                }
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    sum.fetch_add( static_cast<std::uint64_t>( items[ i ] ), std::memory_order_relaxed );
+                }
+                consumed.fetch_add( count, std::memory_order_relaxed );
+            }
+        } );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+
+    EXPECT_EQ( consumed.load(), totalItems );
+    EXPECT_EQ( sum.load(), totalItems * ( totalItems - 1 ) / 2 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( BlockingConcurrentQueueTest, TimedWaitRacesSignal ) {
+    // zero and very short timeouts keep the waiters expiring right while permits arrive, which is where the undo path runs
+    LightWeightSemaphore sem;
+
+    constexpr int           waiterCount  = 8;
+    constexpr std::uint64_t totalPermits = 20000;
+
+    std::atomic<std::uint64_t> acquired{ 0 };
+    std::atomic<std::uint64_t> timeouts{ 0 };
+
+    std::vector<std::thread> threads;
+    for ( int w = 0; w < waiterCount; ++w ) {
+        threads.emplace_back( [ &, w ] {
+            while ( acquired.load( std::memory_order_relaxed ) < totalPermits ) {
+                std::int64_t  timeout = ( w & 2 ) == 0 ? 0 : 1;
+                std::uint64_t got     = 0;
+                if ( ( w & 1 ) == 0 ) {
+                    got = sem.Wait( timeout ) ? 1 : 0;
+                }
+                else {
+                    got = static_cast<std::uint64_t>( sem.WaitMany( 4, timeout ) );
+                }
+                if ( got == 0 ) {
+                    timeouts.fetch_add( 1, std::memory_order_relaxed );
+                }
+                acquired.fetch_add( got, std::memory_order_relaxed );
+            }
+        } );
+    }
+    threads.emplace_back( [ & ] {
+        for ( std::uint64_t signalled = 0; signalled < totalPermits; ) {
+            LightWeightSemaphore::signed_size_t num = ( signalled % 3 ) + 1;
+            if ( signalled + num > totalPermits ) {
+                num = static_cast<LightWeightSemaphore::signed_size_t>( totalPermits - signalled );
+            }
+            sem.Signal( num );
+            signalled += static_cast<std::uint64_t>( num );
+            if ( signalled % 64 == 0 ) {
+                std::this_thread::sleep_for( std::chrono::microseconds( 500 ) );
+            }
+        }
+    } );
+    for ( auto& t : threads ) {
+        t.join();
+    }
+
+    // every permit went to exactly one waiter, every timed-out waiter gave its slot back and no wake-up was left
+    // behind in the underlying semaphore for a later waiter to consume without a permit
+    EXPECT_EQ( acquired.load(), totalPermits );
+    EXPECT_GT( timeouts.load(), 0u );
+    EXPECT_EQ( sem.Available(), 0u );
+    EXPECT_FALSE( sem.TryWait() );
+    EXPECT_FALSE( sem.Wait( 5 ) );
+    EXPECT_EQ( sem.WaitMany( 4, 5 ), 0 );
+    sem.Signal( 2 );
+    EXPECT_EQ( sem.Available(), 2u );
+    EXPECT_EQ( sem.TryWaitMany( 4 ), 2 );
+    EXPECT_FALSE( sem.Wait( 0 ) );
+}
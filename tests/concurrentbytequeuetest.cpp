@@ -0,0 +1,242 @@
+#include "ConcurrentQueue/ConcurrentByteQueue.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace hakle;
+
+namespace {
+
+// small blocks so that records run across block boundaries all the time
+using SmallByteQueue = ConcurrentByteQueue<64>;
+
+std::string ToString( const SmallByteQueue::ByteRecord& record ) {
+    std::string result( record.Size(), '\0' );
+    EXPECT_EQ( record.CopyTo( std::as_writable_bytes( std::span<char>( result ) ) ), record.Size() );
+    return result;
+}
+
+bool Enqueue( SmallByteQueue& queue, SmallByteQueue::ProducerToken& token, std::string_view text ) { return queue.Enqueue( token, text.data(), text.size() ); }
+
+// payload of the given length, derived from a seed so the consumer can check it
+std::vector<std::byte> MakePayload( std::uint32_t seed, std::size_t length ) {
+    std::vector<std::byte> payload( length );
+    for ( std::size_t i = 0; i < length; ++i ) {
+        payload[ i ] = static_cast<std::byte>( ( seed * 31 + i * 7 ) & 0xff );
+    }
+    if ( length >= sizeof( seed ) ) {
+        std::memcpy( payload.data(), &seed, sizeof( seed ) );
+    }
+    return payload;
+}
+
+}  // namespace
+
+TEST( ConcurrentByteQueueTest, RoundTripInOrder ) {
+    SmallByteQueue queue;
+    auto           token = queue.GetProducerToken();
+
+    EXPECT_TRUE( Enqueue( queue, token, "hello" ) );
+    EXPECT_TRUE( Enqueue( queue, token, "" ) );
+    EXPECT_TRUE( Enqueue( queue, token, "world!" ) );
+    EXPECT_EQ( queue.SizeApprox(), 12 + 4 + 12 );
+
+    SmallByteQueue::ByteRecord record;
+    ASSERT_TRUE( queue.TryDequeue( record ) );
+    EXPECT_TRUE( record.IsContiguous() );
+    EXPECT_EQ( std::string_view( reinterpret_cast<const char*>( record.Span().data() ), record.Size() ), "hello" );
+
+    ASSERT_TRUE( queue.TryDequeue( record ) );
+    EXPECT_EQ( record.Size(), 0 );
+    EXPECT_TRUE( record.Span().empty() );
+
+    ASSERT_TRUE( queue.TryDequeue( record ) );
+    EXPECT_EQ( ToString( record ), "world!" );
+
+    EXPECT_FALSE( queue.TryDequeue( record ) );
+    EXPECT_FALSE( record );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( ConcurrentByteQueueTest, RecordsSpanBlocks ) {
+    SmallByteQueue queue;
+    auto           token = queue.GetProducerToken();
+
+    // 60 usable bytes per block, lengths chosen to hit every split point including several blocks at once
+    std::vector<std::size_t> lengths;
+    for ( std::size_t length = 0; length < 200; length += 3 ) {
+        lengths.push_back( length );
+    }
+    for ( std::size_t i = 0; i < lengths.size(); ++i ) {
+        auto payload = MakePayload( static_cast<std::uint32_t>( i ), lengths[ i ] );
+        ASSERT_TRUE( queue.Enqueue( token, payload ) );
+    }
+
+    std::size_t spanning = 0;
+    for ( std::size_t i = 0; i < lengths.size(); ++i ) {
+        SmallByteQueue::ByteRecord record;
+        ASSERT_TRUE( queue.TryDequeue( record ) );
+        ASSERT_EQ( record.Size(), lengths[ i ] );
+
+        auto                   expected = MakePayload( static_cast<std::uint32_t>( i ), lengths[ i ] );
+        std::vector<std::byte> pieces;
+        std::size_t            spanCount = 0;
+        record.ForEachSpan( [ & ]( std::span<const std::byte> part ) {
+            EXPECT_FALSE( part.empty() );
+            pieces.insert( pieces.end(), part.begin(), part.end() );
+            ++spanCount;
+        } );
+        EXPECT_EQ( pieces, expected );
+        EXPECT_EQ( record.IsContiguous(), spanCount <= 1 );
+        spanning += spanCount > 1;
+
+        std::vector<std::byte> copy( lengths[ i ] );
+        EXPECT_EQ( record.CopyTo( copy ), lengths[ i ] );
+        EXPECT_EQ( copy, expected );
+    }
+    EXPECT_GT( spanning, 0 );
+    SmallByteQueue::ByteRecord record;
+    EXPECT_FALSE( queue.TryDequeue( record ) );
+}
+
+TEST( ConcurrentByteQueueTest, BlocksAreRecycled ) {
+    // every block comes from the initial pool, so TryEnqueue never has to allocate
+    SmallByteQueue queue( 4 );
+    auto           token = queue.GetProducerToken();
+
+    const auto payload = MakePayload( 7, 45 );
+    for ( int round = 0; round < 10000; ++round ) {
+        ASSERT_TRUE( queue.TryEnqueue( token, payload ) ) << round;
+        ASSERT_TRUE( queue.TryEnqueue( token, payload ) ) << round;
+        for ( int i = 0; i < 2; ++i ) {
+            ASSERT_TRUE( queue.TryConsume( [ & ]( const SmallByteQueue::ByteRecord& record ) {
+                std::vector<std::byte> copy( record.Size() );
+                record.CopyTo( copy );
+                EXPECT_EQ( copy, payload );
+            } ) );
+        }
+    }
+
+    // a held record keeps its blocks, so the pool runs dry until it is released
+    ASSERT_TRUE( queue.TryEnqueue( token, payload ) );
+    SmallByteQueue::ByteRecord held;
+    ASSERT_TRUE( queue.TryDequeue( held ) );
+    std::size_t accepted = 0;
+    while ( queue.TryEnqueue( token, payload ) ) {
+        ++accepted;
+    }
+    EXPECT_LT( accepted, 16 );
+    held.Release();
+    SmallByteQueue::ByteRecord record;
+    while ( queue.TryDequeue( record ) ) {
+    }
+    record.Release();
+    EXPECT_TRUE( queue.TryEnqueue( token, payload ) );
+}
+
+TEST( ConcurrentByteQueueTest, DroppedTokenStreamIsReused ) {
+    SmallByteQueue queue;
+    {
+        auto token = queue.GetProducerToken();
+        EXPECT_TRUE( Enqueue( queue, token, "left behind" ) );
+    }
+    auto token = queue.GetProducerToken();
+    EXPECT_TRUE( Enqueue( queue, token, "next" ) );
+
+    SmallByteQueue::ByteRecord record;
+    ASSERT_TRUE( queue.TryDequeue( record ) );
+    EXPECT_EQ( ToString( record ), "left behind" );
+    ASSERT_TRUE( queue.TryDequeue( record ) );
+    EXPECT_EQ( ToString( record ), "next" );
+    EXPECT_FALSE( queue.TryDequeue( record ) );
+}
+
+TEST( ConcurrentByteQueueTest, ManyStreamsReuseDroppedOnes ) {
+    SmallByteQueue queue;
+
+    // streams of dropped tokens keep their records and go to the next tokens, in any order
+    constexpr int                              streamCount = 100;
+    std::vector<SmallByteQueue::ProducerToken> tokens;
+    for ( int i = 0; i < streamCount; ++i ) {
+        tokens.push_back( queue.GetProducerToken() );
+        ASSERT_TRUE( tokens.back().Valid() );
+        EXPECT_TRUE( Enqueue( queue, tokens.back(), "first" ) );
+    }
+    tokens.resize( streamCount / 2 );
+    for ( int i = 0; i < streamCount / 2; ++i ) {
+        tokens.push_back( queue.GetProducerToken() );
+        EXPECT_TRUE( Enqueue( queue, tokens.back(), "second" ) );
+    }
+
+    int first  = 0;
+    int second = 0;
+    for ( SmallByteQueue::ByteRecord record; queue.TryDequeue( record ); ) {
+        std::string text = ToString( record );
+        first += text == "first" ? 1 : 0;
+        second += text == "second" ? 1 : 0;
+    }
+    EXPECT_EQ( first, streamCount );
+    EXPECT_EQ( second, streamCount / 2 );
+}
+
+TEST( ConcurrentByteQueueTest, MultiProducerMultiConsumer ) {
+    SmallByteQueue queue;
+
+    constexpr int           producerCount = 4;
+    constexpr int           consumerCount = 4;
+    constexpr std::uint32_t itemsPerProd  = 20000;
+    constexpr std::uint64_t totalItems    = static_cast<std::uint64_t>( producerCount ) * itemsPerProd;
+
+    std::atomic<std::uint64_t> consumed{ 0 };
+    std::atomic<std::uint64_t> sum{ 0 };
+    std::atomic<std::uint64_t> corrupt{ 0 };
+
+    std::vector<std::thread> threads;
+    for ( int p = 0; p < producerCount; ++p ) {
+        threads.emplace_back( [ &, p ] {
+            auto token = queue.GetProducerToken();
+            for ( std::uint32_t i = 0; i < itemsPerProd; ++i ) {
+                std::uint32_t seed = p * itemsPerProd + i;
+                queue.Enqueue( token, MakePayload( seed, 4 + seed % 150 ) );
+            }
+        } );
+    }
+    for ( int c = 0; c < consumerCount; ++c ) {
+        threads.emplace_back( [ & ] {
+            // each consumer sees every producer's records in order
+            std::vector<std::int64_t> last( producerCount, -1 );
+            SmallByteQueue::ByteRecord record;
+            while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                if ( !queue.TryDequeue( record ) ) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                std::vector<std::byte> copy( record.Size() );
+                record.CopyTo( copy );
+                std::uint32_t seed = 0;
+                std::memcpy( &seed, copy.data(), sizeof( seed ) );
+                int producer = static_cast<int>( seed / itemsPerProd );
+                if ( copy != MakePayload( seed, 4 + seed % 150 ) || static_cast<std::int64_t>( seed ) <= last[ producer ] ) {
+                    corrupt.fetch_add( 1, std::memory_order_relaxed );
+                }
+                last[ producer ] = seed;
+                sum.fetch_add( seed, std::memory_order_relaxed );
+                consumed.fetch_add( 1, std::memory_order_relaxed );
+            }
+        } );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+
+    EXPECT_EQ( corrupt.load(), 0 );
+    EXPECT_EQ( consumed.load(), totalItems );
+    EXPECT_EQ( sum.load(), totalItems * ( totalItems - 1 ) / 2 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
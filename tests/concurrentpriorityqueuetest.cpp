@@ -0,0 +1,219 @@
+#include "ConcurrentQueue/ConcurrentPriorityQueue.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace hakle;
+
+TEST( ConcurrentPriorityQueueTest, StrictPriority ) {
+    ConcurrentPriorityQueue<int, 3> queue;
+    EXPECT_FALSE( queue.IsWeighted() );
+
+    int value = -1;
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+
+    for ( int i = 0; i < 10; ++i ) {
+        EXPECT_TRUE( queue.Enqueue( 2, 200 + i ) );
+        EXPECT_TRUE( queue.Enqueue( 1, 100 + i ) );
+        EXPECT_TRUE( queue.Enqueue( 0, i ) );
+    }
+    EXPECT_EQ( queue.SizeApprox(), 30 );
+    EXPECT_EQ( queue.SizeApprox( 1 ), 10 );
+
+    // every control message overtakes everything queued below it
+    for ( int level = 0; level < 3; ++level ) {
+        for ( int i = 0; i < 10; ++i ) {
+            EXPECT_TRUE( queue.TryDequeue( value ) );
+            EXPECT_EQ( value, level * 100 + i );
+        }
+    }
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+
+    // a late urgent element still jumps the line
+    EXPECT_TRUE( queue.Enqueue( 2, 7 ) );
+    EXPECT_TRUE( queue.Enqueue( 0, 8 ) );
+    EXPECT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 8 );
+    EXPECT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 7 );
+}
+
+TEST( ConcurrentPriorityQueueTest, TokensAndBulk ) {
+    ConcurrentPriorityQueue<int, 2> queue;
+    auto                            high     = queue.GetProducerToken( 0 );
+    auto                            low      = queue.GetProducerToken( 1 );
+    auto                            consumer = queue.GetConsumerToken();
+    EXPECT_EQ( high.GetLevel(), 0 );
+    EXPECT_EQ( low.GetLevel(), 1 );
+
+    std::vector<int> input( 20 );
+    std::iota( input.begin(), input.end(), 0 );
+    EXPECT_TRUE( queue.EnqueueBulk( low, input.begin(), 10 ) );
+    EXPECT_TRUE( queue.EnqueueBulk( high, input.begin() + 10, 10 ) );
+
+    // the urgent level is drained first, then the bulk call tops up from the next one
+    std::vector<int> output( 15 );
+    EXPECT_EQ( queue.TryDequeueBulk( consumer, output.begin(), output.size() ), 15 );
+    for ( int i = 0; i < 10; ++i ) {
+        EXPECT_EQ( output[ i ], 10 + i );
+    }
+    for ( int i = 10; i < 15; ++i ) {
+        EXPECT_EQ( output[ i ], i - 10 );
+    }
+
+    EXPECT_TRUE( queue.EnqueueWithToken( high, 99 ) );
+    int value = -1;
+    EXPECT_TRUE( queue.TryDequeue( consumer, value ) );
+    EXPECT_EQ( value, 99 );
+    EXPECT_EQ( queue.TryDequeueBulk( output.begin(), output.size() ), 5 );
+    EXPECT_FALSE( queue.TryDequeue( consumer, value ) );
+}
+
+TEST( ConcurrentPriorityQueueTest, WeightedRoundRobin ) {
+    ConcurrentPriorityQueue<int, 3> queue( { 4, 2, 1 } );
+    EXPECT_TRUE( queue.IsWeighted() );
+
+    for ( int i = 0; i < 700; ++i ) {
+        for ( int level = 0; level < 3; ++level ) {
+            EXPECT_TRUE( queue.Enqueue( level, level ) );
+        }
+    }
+
+    // while every level has elements, each round of 7 turns gives 4 / 2 / 1
+    auto consumer = queue.GetConsumerToken();
+    int  counts[ 3 ]{};
+    for ( int i = 0; i < 70; ++i ) {
+        int value = -1;
+        EXPECT_TRUE( queue.TryDequeue( consumer, value ) );
+        ++counts[ value ];
+    }
+    EXPECT_EQ( counts[ 0 ], 40 );
+    EXPECT_EQ( counts[ 1 ], 20 );
+    EXPECT_EQ( counts[ 2 ], 10 );
+
+    // the tokenless schedule is shared by all tokenless consumers
+    int shared[ 3 ]{};
+    for ( int i = 0; i < 700; ++i ) {
+        int value = -1;
+        EXPECT_TRUE( queue.TryDequeue( value ) );
+        ++shared[ value ];
+    }
+    EXPECT_EQ( shared[ 0 ], 400 );
+    EXPECT_EQ( shared[ 1 ], 200 );
+    EXPECT_EQ( shared[ 2 ], 100 );
+}
+
+TEST( ConcurrentPriorityQueueTest, WeightedFallsBackToNonEmptyLevel ) {
+    ConcurrentPriorityQueue<int, 4> queue( { 8, 4, 2, 1 } );
+    for ( int i = 0; i < 50; ++i ) {
+        EXPECT_TRUE( queue.Enqueue( 3, i ) );
+    }
+
+    // turns scheduled for the empty levels go to the only level with work
+    int value = -1;
+    for ( int i = 0; i < 50; ++i ) {
+        EXPECT_TRUE( queue.TryDequeue( value ) );
+        EXPECT_EQ( value, i );
+    }
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+}
+
+TEST( ConcurrentPriorityQueueTest, WeightsAreReducedAndCapped ) {
+    // common factors cost nothing, the round is as long as for { 4, 2, 1 }
+    ConcurrentPriorityQueue<int, 3> reduced( { 400, 200, 100 } );
+    EXPECT_EQ( reduced.RoundLength(), 7 );
+
+    for ( int i = 0; i < 70; ++i ) {
+        for ( int level = 0; level < 3; ++level ) {
+            EXPECT_TRUE( reduced.Enqueue( level, level ) );
+        }
+    }
+    int counts[ 3 ]{};
+    for ( int i = 0; i < 70; ++i ) {
+        int value = -1;
+        EXPECT_TRUE( reduced.TryDequeue( value ) );
+        ++counts[ value ];
+    }
+    EXPECT_EQ( counts[ 0 ], 40 );
+    EXPECT_EQ( counts[ 1 ], 20 );
+    EXPECT_EQ( counts[ 2 ], 10 );
+
+    // a huge round is scaled down, and a tiny weight still gets its turn
+    ConcurrentPriorityQueue<int, 3> capped( { 3000000000u, 1000000000u, 1 } );
+    EXPECT_LE( capped.RoundLength(), decltype( capped )::MaxRoundLength );
+    EXPECT_GE( capped.RoundLength(), decltype( capped )::MaxRoundLength - decltype( capped )::LevelCount );
+
+    const int round = static_cast<int>( capped.RoundLength() );
+    for ( int i = 0; i < round; ++i ) {
+        for ( int level = 0; level < 3; ++level ) {
+            EXPECT_TRUE( capped.Enqueue( level, level ) );
+        }
+    }
+    auto consumer = capped.GetConsumerToken();
+    int  turns[ 3 ]{};
+    for ( int i = 0; i < round; ++i ) {
+        int value = -1;
+        EXPECT_TRUE( capped.TryDequeue( consumer, value ) );
+        ++turns[ value ];
+    }
+    EXPECT_EQ( turns[ 2 ], 1 );
+    EXPECT_NEAR( static_cast<double>( turns[ 0 ] ) / turns[ 1 ], 3.0, 0.01 );
+}
+
+TEST( ConcurrentPriorityQueueTest, MultiProducerMultiConsumer ) {
+    ConcurrentPriorityQueue<int, 3> queue( { 4, 2, 1 } );
+
+    constexpr int           producerCount = 6;
+    constexpr int           consumerCount = 4;
+    constexpr int           itemsPerProd  = 20000;
+    constexpr std::uint64_t totalItems    = static_cast<std::uint64_t>( producerCount ) * itemsPerProd;
+
+    std::atomic<std::uint64_t> consumed{ 0 };
+    std::atomic<std::uint64_t> sum{ 0 };
+
+    std::vector<std::thread> threads;
+    for ( int p = 0; p < producerCount; ++p ) {
+        threads.emplace_back( [ &, p ] {
+            auto token = queue.GetProducerToken( static_cast<std::size_t>( p % 3 ) );
+            for ( int i = 0; i < itemsPerProd; ++i ) {
+                int value = p * itemsPerProd + i;
+                if ( ( i & 1 ) == 0 ) {
+                    queue.EnqueueWithToken( token, value );
+                }
+                else {
+                    queue.Enqueue( static_cast<std::size_t>( p % 3 ), value );
+                }
+            }
+        } );
+    }
+    for ( int c = 0; c < consumerCount; ++c ) {
+        threads.emplace_back( [ &, c ] {
+            auto token = queue.GetConsumerToken();
+            int  items[ 16 ];
+            while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                std::size_t count = 0;
+                if ( ( c & 1 ) == 0 ) {
+                    count = queue.TryDequeueBulk( token, items, 16 );
+                }
+                else {
+                    count = queue.TryDequeue( items[ 0 ] ) ? 1 : 0;
+                }
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    sum.fetch_add( static_cast<std::uint64_t>( items[ i ] ), std::memory_order_relaxed );
+                }
+                consumed.fetch_add( count, std::memory_order_relaxed );
+            }
+        } );
+    }
+    for ( auto& t : threads ) {
+        t.join();
+    }
+
+    EXPECT_EQ( consumed.load(), totalItems );
+    EXPECT_EQ( sum.load(), totalItems * ( totalItems - 1 ) / 2 );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
@@ -1,5 +1,6 @@
 #include "ConcurrentQueue/Block.h"
 #include "ConcurrentQueue/ConcurrentQueue.h"
+#include "ConcurrentQueue/ReadinessNotifier.h"
 #include "common/allocator.h"
 
 #include <algorithm>
@@ -8,6 +9,7 @@
 #include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
@@ -16,6 +18,11 @@
 #include <thread>
 #include <vector>
 
+#if defined( __linux__ )
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
 #define SPMC
 
 using Clock = std::chrono::steady_clock;
@@ -546,6 +553,297 @@ Result TestCQ_NormalBulkEnq_ConsTokenBulkDeq( const BenchmarkConfig& cfg ) {
     return r;
 }
 
+// 10. 多生产者 / 单消费者：ConcurrentQueue 与 MpscQueue 对比
+template <class Queue>
+Result TestCQ_SingleConsumer( const BenchmarkConfig& cfg, const char* name ) {
+    constexpr std::size_t BULK = 256;
+
+    Queue             queue;
+    const std::size_t totalItems = cfg.prodThreads * cfg.itemsPerProd;
+
+    std::atomic<std::size_t> produced{ 0 };
+
+    double seconds = MeasureSeconds( [ & ] {
+        std::vector<std::thread> producers;
+
+        for ( std::size_t p = 0; p < cfg.prodThreads; ++p ) {
+            producers.emplace_back( [ &, p ] {
+                auto token = queue.GetProducerToken();
+                for ( std::size_t i = 0; i < cfg.itemsPerProd; ++i ) {
+                    int v = static_cast<int>( p * cfg.itemsPerProd + i );
+                    queue.EnqueueWithToken( token, v );
+                    produced.fetch_add( 1, std::memory_order_relaxed );
+                }
+            } );
+        }
+
+        // 唯一的消费者
+        std::thread consumer( [ & ] {
+            std::vector<int> buf( BULK );
+            std::size_t      consumed = 0;
+            while ( consumed < totalItems ) {
+                consumed += queue.TryDequeueBulk( buf.data(), BULK );
+            }
+        } );
+
+        for ( auto& t : producers )
+            t.join();
+        consumer.join();
+    } );
+
+    double thr = ( double )totalItems / seconds;
+    Result r{ name, seconds, thr };
+    PrintResult( r, totalItems );
+    return r;
+}
+
+// 11. 倾斜负载：少数热点生产者 + 大量空闲生产者，ConsumerToken 消费
+// fairness: 消费到一半时，各生产者已被取走比例的最小值（越接近 0.5 越公平）
+template <std::size_t Quota, bool Adaptive>
+struct RotationTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr std::size_t ConsumerRotationQuota = Quota;
+    static constexpr bool        AdaptiveRotationQuota = Adaptive;
+};
+
+template <class Traits>
+Result TestCQ_SkewedProducers( const BenchmarkConfig& cfg, const char* name ) {
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, Traits>;
+
+    const std::size_t hotProducers  = 2;
+    const std::size_t idleProducers = 30;
+    const std::size_t idleItems     = cfg.itemsPerProd / 100;
+    const std::size_t producerCount = hotProducers + idleProducers;
+    const std::size_t totalItems    = hotProducers * cfg.itemsPerProd + idleProducers * idleItems;
+
+    Queue                                      queue;
+    std::vector<typename Queue::ProducerToken> prodTokens;
+    for ( std::size_t i = 0; i < producerCount; ++i ) {
+        prodTokens.emplace_back( queue.GetProducerToken() );
+    }
+
+    std::vector<std::atomic<std::size_t>> perProducer( producerCount );
+    std::vector<std::size_t>              snapshot( producerCount );
+    std::atomic<std::size_t>              consumed{ 0 };
+    std::atomic<bool>                     snapped{ false };
+
+    double seconds = MeasureSeconds( [ & ] {
+        std::vector<std::thread> producers, consumers;
+
+        for ( std::size_t p = 0; p < producerCount; ++p ) {
+            producers.emplace_back( [ &, p ] {
+                std::size_t count = p < hotProducers ? cfg.itemsPerProd : idleItems;
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    queue.EnqueueWithToken( prodTokens[ p ], static_cast<int>( p ) );
+                }
+            } );
+        }
+
+        for ( std::size_t c = 0; c < cfg.consThreads; ++c ) {
+            consumers.emplace_back( [ & ] {
+                auto token = queue.GetConsumerToken();
+                int  value;
+                while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                    if ( queue.TryDequeue( token, value ) ) {
+                        perProducer[ value ].fetch_add( 1, std::memory_order_relaxed );
+                        std::size_t done = consumed.fetch_add( 1, std::memory_order_relaxed ) + 1;
+                        if ( done == totalItems / 2 && !snapped.exchange( true ) ) {
+                            for ( std::size_t p = 0; p < producerCount; ++p ) {
+                                snapshot[ p ] = perProducer[ p ].load( std::memory_order_relaxed );
+                            }
+                        }
+                    }
+                }
+            } );
+        }
+
+        for ( auto& t : producers )
+            t.join();
+        for ( auto& t : consumers )
+            t.join();
+    } );
+
+    double fairness = 1.0;
+    for ( std::size_t p = 0; p < producerCount; ++p ) {
+        std::size_t count = p < hotProducers ? cfg.itemsPerProd : idleItems;
+        fairness          = std::min( fairness, ( double )snapshot[ p ] / ( double )count );
+    }
+
+    double thr = ( double )totalItems / seconds;
+    Result r{ name, seconds, thr };
+    PrintResult( r, totalItems );
+    std::cout << "    fairness(min drained at 50%)=" << fairness << "\n";
+    return r;
+}
+
+// 12. 多消费者普通 TryDequeue：扫描前三个非空生产者 vs 随机二选一
+template <bool Random>
+struct SelectionTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool RandomProducerSelection = Random;
+};
+
+template <class Traits>
+Result TestCQ_ManyConsumers( const BenchmarkConfig& cfg, std::size_t threads, const char* name ) {
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, Traits>;
+
+    Queue             queue;
+    const std::size_t itemsPerProd = cfg.prodThreads * cfg.itemsPerProd / threads;
+    const std::size_t totalItems   = threads * itemsPerProd;
+
+    std::atomic<std::size_t> consumed{ 0 };
+
+    double seconds = MeasureSeconds( [ & ] {
+        std::vector<std::thread> producers, consumers;
+
+        for ( std::size_t p = 0; p < threads; ++p ) {
+            producers.emplace_back( [ &, p ] {
+                auto token = queue.GetProducerToken();
+                for ( std::size_t i = 0; i < itemsPerProd; ++i ) {
+                    queue.EnqueueWithToken( token, static_cast<int>( p * itemsPerProd + i ) );
+                }
+            } );
+        }
+
+        for ( std::size_t c = 0; c < threads; ++c ) {
+            consumers.emplace_back( [ & ] {
+                int value;
+                while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                    if ( queue.TryDequeue( value ) ) {
+                        consumed.fetch_add( 1, std::memory_order_relaxed );
+                    }
+                }
+            } );
+        }
+
+        for ( auto& t : producers )
+            t.join();
+        for ( auto& t : consumers )
+            t.join();
+    } );
+
+    double thr = ( double )totalItems / seconds;
+    Result r{ name, seconds, thr };
+    PrintResult( r, totalItems );
+    return r;
+}
+
+// 13. 单生产者 / 多消费者：默认布局 vs 缓存行隔离布局（生产者与消费者字段分开）
+template <bool Isolated>
+struct LayoutTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool CacheLineIsolatedLayout = Isolated;
+};
+
+template <class Traits>
+Result TestCQ_SingleProducerManyConsumers( const BenchmarkConfig& cfg, std::size_t consumerThreads, const char* name ) {
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, Traits>;
+
+    Queue             queue;
+    const std::size_t totalItems = cfg.prodThreads * cfg.itemsPerProd;
+
+    std::atomic<std::size_t> consumed{ 0 };
+
+    double seconds = MeasureSeconds( [ & ] {
+        std::vector<std::thread> consumers;
+
+        std::thread producer( [ & ] {
+            auto token = queue.GetProducerToken();
+            for ( std::size_t i = 0; i < totalItems; ++i ) {
+                queue.EnqueueWithToken( token, static_cast<int>( i ) );
+            }
+        } );
+
+        for ( std::size_t c = 0; c < consumerThreads; ++c ) {
+            consumers.emplace_back( [ & ] {
+                auto token = queue.GetConsumerToken();
+                int  value;
+                while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                    if ( queue.TryDequeue( token, value ) ) {
+                        consumed.fetch_add( 1, std::memory_order_relaxed );
+                    }
+                }
+            } );
+        }
+
+        producer.join();
+        for ( auto& t : consumers )
+            t.join();
+    } );
+
+    double thr = ( double )totalItems / seconds;
+    Result r{ name, seconds, thr };
+    PrintResult( r, totalItems );
+    std::cout << "    sizeof(ExplicitProducer)=" << sizeof( typename Queue::ExplicitProducer ) << " sizeof(ImplicitProducer)=" << sizeof( typename Queue::ImplicitProducer ) << "\n";
+    return r;
+}
+
+#if defined( __linux__ )
+// 14. eventfd 就绪通知：单个 epoll 消费者 + 多生产者，统计 write(2) 次数
+// BurstSize == 0 表示生产者不停入队；否则每入队 BurstSize 个就歇一会儿，让消费者睡下去
+struct NotifyingTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool ReadinessNotification = true;
+};
+
+Result TestCQ_EventFdConsumer( const BenchmarkConfig& cfg, std::size_t burstSize, const char* name ) {
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, NotifyingTraits>;
+
+    Queue                  queue;
+    hakle::EventFdNotifier notifier;
+    queue.SetNotifier( &hakle::EventFdNotifier::Signal, &notifier );
+
+    const std::size_t totalItems = cfg.prodThreads * cfg.itemsPerProd;
+    std::size_t       sleeps     = 0;
+
+    int         epollFd = ::epoll_create1( EPOLL_CLOEXEC );
+    epoll_event watch{};
+    watch.events = EPOLLIN;
+    ::epoll_ctl( epollFd, EPOLL_CTL_ADD, notifier.Fd(), &watch );
+
+    double seconds = MeasureSeconds( [ & ] {
+        std::vector<std::thread> producers;
+        for ( std::size_t p = 0; p < cfg.prodThreads; ++p ) {
+            producers.emplace_back( [ & ] {
+                auto token = queue.GetProducerToken();
+                for ( std::size_t i = 0; i < cfg.itemsPerProd; ++i ) {
+                    queue.EnqueueWithToken( token, static_cast<int>( i ) );
+                    if ( burstSize != 0 && ( i + 1 ) % burstSize == 0 ) {
+                        std::this_thread::sleep_for( std::chrono::microseconds( 50 ) );
+                    }
+                }
+            } );
+        }
+
+        std::thread consumer( [ & ] {
+            auto        token    = queue.GetConsumerToken();
+            std::size_t consumed = 0;
+            int         items[ 64 ];
+            epoll_event ready;
+            while ( consumed < totalItems ) {
+                std::size_t count = queue.TryDequeueBulk( token, items, 64 );
+                consumed += count;
+                if ( count != 0 || consumed == totalItems || !queue.ArmNotifier() ) {
+                    continue;
+                }
+                ++sleeps;
+                ::epoll_wait( epollFd, &ready, 1, 100 );
+                notifier.Acknowledge();
+            }
+        } );
+
+        for ( auto& t : producers )
+            t.join();
+        consumer.join();
+    } );
+    ::close( epollFd );
+
+    double thr = ( double )totalItems / seconds;
+    Result r{ name, seconds, thr };
+    PrintResult( r, totalItems );
+    const std::uint64_t writes = notifier.WriteCount();
+    std::cout << "    write(2)=" << writes << "  per 1M items=" << writes * 1000000 / totalItems << "  per second=" << static_cast<std::uint64_t>( writes / seconds )
+              << "  consumer sleeps=" << sleeps << "\n";
+    return r;
+}
+#endif
+
 #ifdef SPMC
 // 2. 普通 Enqueue / TryDequeue
 Result TestFastQueue_EnqDeq( const BenchmarkConfig& cfg ) {
@@ -772,6 +1070,23 @@ int main() {
     results.push_back( TestCQ_NormalEnq_ConsTokenDeq( cfg ) );
     results.push_back( TestCQ_ProdTokenBulkEnq_ConsTokenBulkDeq( cfg ) );
     results.push_back( TestCQ_NormalBulkEnq_ConsTokenBulkDeq( cfg ) );
+    results.push_back( TestCQ_SingleConsumer<hakle::ConcurrentQueue<int>>( cfg, "CQ_SingleConsumer" ) );
+    results.push_back( TestCQ_SingleConsumer<hakle::MpscQueue<int>>( cfg, "MpscQueue_SingleConsumer" ) );
+    results.push_back( TestCQ_SkewedProducers<RotationTraits<16, false>>( cfg, "CQ_Skewed_Quota16" ) );
+    results.push_back( TestCQ_SkewedProducers<RotationTraits<256, false>>( cfg, "CQ_Skewed_Quota256" ) );
+    results.push_back( TestCQ_SkewedProducers<RotationTraits<256, true>>( cfg, "CQ_Skewed_Adaptive" ) );
+    results.push_back( TestCQ_ManyConsumers<SelectionTraits<false>>( cfg, 32, "CQ_32x32_ScanSelection" ) );
+    results.push_back( TestCQ_ManyConsumers<SelectionTraits<true>>( cfg, 32, "CQ_32x32_RandomSelection" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<false>>( cfg, 8, "CQ_1x8_PackedLayout" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<true>>( cfg, 8, "CQ_1x8_IsolatedLayout" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<false>>( cfg, 16, "CQ_1x16_PackedLayout" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<true>>( cfg, 16, "CQ_1x16_IsolatedLayout" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<false>>( cfg, 32, "CQ_1x32_PackedLayout" ) );
+    results.push_back( TestCQ_SingleProducerManyConsumers<LayoutTraits<true>>( cfg, 32, "CQ_1x32_IsolatedLayout" ) );
+#if defined( __linux__ )
+    results.push_back( TestCQ_EventFdConsumer( cfg, 0, "CQ_EventFd_Saturated" ) );
+    results.push_back( TestCQ_EventFdConsumer( cfg, 64, "CQ_EventFd_Bursts64" ) );
+#endif
 #ifdef SPMC
     results.push_back( TestFastQueue_EnqDeq( cfg ) );
     results.push_back( TestSlowQueue_EnqDeq( cfg ) );
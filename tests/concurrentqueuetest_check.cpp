@@ -2,10 +2,17 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <optional>
 #include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#include <poll.h>
+#endif
+
 // 工具：根据 prodThreads / itemsPerProd 计算理论总和
 std::uint64_t CalcExpectedSum(std::size_t prodThreads,
                               std::size_t itemsPerProd)
@@ -481,6 +488,1118 @@ TEST(ConcurrentQueueCorrectness, ProducerTokenEnq_ConsumerTokenDeq_SingleElement
     EXPECT_EQ(sum.load(), expectedSum);
 }
 
+// 大量短生命周期线程使用隐式生产者：线程退出后生产者被回收复用，残留元素仍可取出
+TEST(ConcurrentQueueCorrectness, ShortLivedThreads_ImplicitProducerReuse)
+{
+    hakle::ConcurrentQueue<int> queue;
+
+    constexpr std::size_t rounds        = 200;
+    constexpr std::size_t threadsPerRnd = 4;
+    constexpr std::size_t itemsPerThr   = 100;
+    constexpr std::size_t totalItems    = rounds * threadsPerRnd * itemsPerThr;
+
+    for (std::size_t r = 0; r < rounds; ++r) {
+        std::vector<std::thread> producers;
+        for (std::size_t t = 0; t < threadsPerRnd; ++t) {
+            producers.emplace_back([&, r, t] {
+                for (std::size_t i = 0; i < itemsPerThr; ++i) {
+                    queue.Enqueue(static_cast<int>((r * threadsPerRnd + t) * itemsPerThr + i));
+                }
+            });
+        }
+        for (auto& t : producers) t.join();
+    }
+
+    // 每轮最多 threadsPerRnd 个线程同时存活，退出线程的生产者必须被复用，生产者总数不能随轮数增长
+    std::size_t implicitProducers = 0;
+    for (const auto& depth : queue.GetProducerDepths()) {
+        EXPECT_EQ(depth.Type, hakle::ConcurrentQueue<int>::ProducerType::Implicit);
+        ++implicitProducers;
+    }
+    EXPECT_GE(implicitProducers, 1u);
+    EXPECT_LE(implicitProducers, threadsPerRnd);
+
+    std::uint64_t sum = 0;
+    std::size_t   consumed = 0;
+    int           value;
+    while (queue.TryDequeue(value)) {
+        sum += static_cast<std::uint64_t>(value);
+        ++consumed;
+    }
+
+    EXPECT_EQ(consumed, totalItems);
+    EXPECT_EQ(sum, static_cast<std::uint64_t>(totalItems) * (totalItems - 1) / 2);
+}
+
+// 线程本地的隐式生产者缓存：移动、交换、销毁后重建队列都不能取到过期的生产者
+TEST(ConcurrentQueueCorrectness, ImplicitProducerCache_MoveSwapDestroy)
+{
+    hakle::ConcurrentQueue<int> a;
+    EXPECT_TRUE(a.Enqueue(1));
+
+    hakle::ConcurrentQueue<int> b(std::move(a));
+    EXPECT_TRUE(b.Enqueue(2));
+    EXPECT_TRUE(a.Enqueue(10));
+
+    int value;
+    EXPECT_TRUE(b.TryDequeue(value));
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(b.TryDequeue(value));
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(b.TryDequeue(value));
+    EXPECT_TRUE(a.TryDequeue(value));
+    EXPECT_EQ(value, 10);
+    EXPECT_FALSE(a.TryDequeue(value));
+
+    a.swap(b);
+    EXPECT_TRUE(a.Enqueue(3));
+    EXPECT_TRUE(b.Enqueue(20));
+    EXPECT_TRUE(a.TryDequeue(value));
+    EXPECT_EQ(value, 3);
+    EXPECT_TRUE(b.TryDequeue(value));
+    EXPECT_EQ(value, 20);
+
+    a = std::move(b);
+    EXPECT_TRUE(a.Enqueue(4));
+    EXPECT_TRUE(b.Enqueue(30));
+    EXPECT_TRUE(a.TryDequeue(value));
+    EXPECT_EQ(value, 4);
+    EXPECT_TRUE(b.TryDequeue(value));
+    EXPECT_EQ(value, 30);
+
+    // 反复在同一块栈内存上构造新队列
+    for (int round = 0; round < 100; ++round) {
+        hakle::ConcurrentQueue<int> local;
+        EXPECT_TRUE(local.Enqueue(round));
+        EXPECT_TRUE(local.TryDequeue(value));
+        EXPECT_EQ(value, round);
+        EXPECT_FALSE(local.TryDequeue(value));
+    }
+}
+
+// 队列被移动后，已经缓存了隐式生产者的线程继续入队：生产者必须改用新队列的块管理器，原队列销毁后也不能再碰它
+TEST(ConcurrentQueueCorrectness, ImplicitProducerCache_EnqueueAfterMove)
+{
+    constexpr int before = 10;
+    constexpr int after  = 5000;  // 需要从块管理器取多个新块
+
+    auto                        source = std::make_unique<hakle::ConcurrentQueue<int>>();
+    hakle::ConcurrentQueue<int> target;
+
+    std::atomic<int> stage{0};
+    std::thread      worker([&] {
+        for (int i = 0; i < before; ++i) {
+            EXPECT_TRUE(source->Enqueue(i));
+        }
+        stage.store(1, std::memory_order_release);
+        while (stage.load(std::memory_order_acquire) != 2) {
+            std::this_thread::yield();
+        }
+        for (int i = before; i < before + after; ++i) {
+            EXPECT_TRUE(target.Enqueue(i));
+        }
+    });
+
+    while (stage.load(std::memory_order_acquire) != 1) {
+        std::this_thread::yield();
+    }
+    target = std::move(*source);
+    source.reset();
+    stage.store(2, std::memory_order_release);
+    worker.join();
+
+    int value;
+    for (int i = 0; i < before + after; ++i) {
+        ASSERT_TRUE(target.TryDequeue(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(target.TryDequeue(value));
+}
+
+// 大量空闲生产者中只有少数有元素：TryDequeue / TryDequeueBulk 都要能找到它们，清空后再入队也要能找到
+TEST(ConcurrentQueueCorrectness, SparseProducers_NonEmptyIndex)
+{
+    hakle::ConcurrentQueue<int> queue;
+
+    constexpr std::size_t producerCount = 1500;  // 跨越多个索引段
+    constexpr std::size_t stride        = 300;
+
+    std::vector<hakle::ConcurrentQueue<int>::ProducerToken> tokens;
+    tokens.reserve(producerCount);
+    for (std::size_t i = 0; i < producerCount; ++i) {
+        tokens.emplace_back(queue);
+    }
+
+    for (int round = 0; round < 3; ++round) {
+        std::uint64_t expected = 0;
+        std::size_t   count    = 0;
+        for (std::size_t i = 0; i < producerCount; i += stride) {
+            EXPECT_TRUE(queue.EnqueueWithToken(tokens[i], static_cast<int>(i)));
+            expected += i;
+            ++count;
+        }
+        EXPECT_TRUE(queue.Enqueue(7));
+        expected += 7;
+        ++count;
+
+        std::uint64_t sum = 0;
+        int           value;
+        if (round == 1) {
+            std::vector<int> buf(count + 4);
+            EXPECT_EQ(queue.TryDequeueBulk(buf.begin(), buf.size()), count);
+            for (std::size_t i = 0; i < count; ++i) sum += static_cast<std::uint64_t>(buf[i]);
+        } else {
+            for (std::size_t i = 0; i < count; ++i) {
+                EXPECT_TRUE(queue.TryDequeue(value));
+                sum += static_cast<std::uint64_t>(value);
+            }
+        }
+        EXPECT_EQ(sum, expected);
+        EXPECT_FALSE(queue.TryDequeue(value));
+    }
+}
+
+// 队列总大小与每个生产者的深度快照
+TEST(ConcurrentQueueCorrectness, SizeApprox_ProducerDepths)
+{
+    using Queue = hakle::ConcurrentQueue<int>;
+    Queue queue;
+    EXPECT_EQ(queue.SizeApprox(), 0u);
+    EXPECT_TRUE(queue.GetProducerDepths().empty());
+
+    auto token = queue.GetProducerToken();
+    for (int i = 0; i < 5; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, i));
+    for (int i = 0; i < 70; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    EXPECT_EQ(queue.SizeApprox(), 75u);
+
+    auto depths = queue.GetProducerDepths();
+    ASSERT_EQ(depths.size(), 2u);
+    std::size_t explicitDepth = 0, implicitDepth = 0;
+    for (const auto& d : depths) {
+        EXPECT_TRUE(d.Active);
+        if (d.Type == Queue::ProducerType::Explicit) explicitDepth += d.Depth;
+        else implicitDepth += d.Depth;
+    }
+    EXPECT_EQ(explicitDepth, 5u);
+    EXPECT_EQ(implicitDepth, 70u);
+
+    int value;
+    for (int i = 0; i < 10; ++i) EXPECT_TRUE(queue.TryDequeue(value));
+    EXPECT_EQ(queue.SizeApprox(), 65u);
+}
+
+// 有界模式：单个生产者上限（按块向上取整）与整个队列的容量上限
+struct SubQueueBoundedTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr std::size_t MaxSubQueueSize = 40;  // 向上取整为 2 个块，即 64
+};
+
+struct CapacityBoundedTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr std::size_t MaxCapacity = 100;
+};
+
+TEST(ConcurrentQueueCorrectness, BoundedMode_MaxSubQueueSize)
+{
+    hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, SubQueueBoundedTraits> queue;
+    auto token = queue.GetProducerToken();
+
+    for (int i = 0; i < 64; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, i));
+    EXPECT_FALSE(queue.EnqueueWithToken(token, 64));
+    std::vector<int> more(8, 1);
+    EXPECT_FALSE(queue.EnqueueBulk(token, more.begin(), more.size()));
+
+    for (int i = 0; i < 64; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    EXPECT_FALSE(queue.Enqueue(64));
+    EXPECT_FALSE(queue.EnqueueBulk(more.begin(), more.size()));
+
+    // 取走一个完整的块后可以继续入队
+    int value;
+    for (int i = 0; i < 32; ++i) EXPECT_TRUE(queue.TryDequeueFromProducer(token, value));
+    EXPECT_TRUE(queue.EnqueueBulk(token, more.begin(), more.size()));
+    EXPECT_EQ(queue.SizeApprox(), 64u + 32u + 8u);
+}
+
+// 生产者缓存的 HeadIndex 过期时只会偏向“已满”：反复填满再取空，满时失败、取空后必须能继续入队
+TEST(ConcurrentQueueCorrectness, BoundedMode_CachedHeadRefresh)
+{
+    hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, SubQueueBoundedTraits> queue;
+    auto token = queue.GetProducerToken();
+    std::vector<int> bulk(16, 1);
+    int value;
+
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 64; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, i));
+        EXPECT_FALSE(queue.EnqueueWithToken(token, 64));
+        for (int i = 0; i < 64; ++i) EXPECT_TRUE(queue.TryDequeueFromProducer(token, value));
+
+        for (int i = 0; i < 4; ++i) EXPECT_TRUE(queue.EnqueueBulk(bulk.begin(), bulk.size()));
+        EXPECT_FALSE(queue.Enqueue(64));
+        for (int i = 0; i < 64; ++i) EXPECT_TRUE(queue.TryDequeue(value));
+        EXPECT_FALSE(queue.TryDequeue(value));
+    }
+}
+
+TEST(ConcurrentQueueCorrectness, BoundedMode_MaxCapacity)
+{
+    hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, CapacityBoundedTraits> queue;
+    auto token = queue.GetProducerToken();
+
+    std::vector<int> items(60, 1);
+    EXPECT_TRUE(queue.EnqueueBulk(token, items.begin(), items.size()));
+    for (int i = 0; i < 40; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    EXPECT_FALSE(queue.Enqueue(100));
+    EXPECT_FALSE(queue.EnqueueWithToken(token, 100));
+    EXPECT_FALSE(queue.EnqueueBulk(items.begin(), 1));
+
+    int value;
+    EXPECT_TRUE(queue.TryDequeue(value));
+    std::vector<int> out(4);
+    EXPECT_EQ(queue.TryDequeueBulk(out.begin(), out.size()), 4u);
+    EXPECT_TRUE(queue.EnqueueBulk(items.begin(), 5));
+    EXPECT_FALSE(queue.Enqueue(100));
+    EXPECT_EQ(queue.SizeApprox(), 100u);
+}
+
+// 有界模式下回调抛异常：本次取出的元素都已离开队列，它们占用的容量也必须归还
+TEST(ConcurrentQueueCorrectness, BoundedMode_ThrowingConsumerReleasesCapacity)
+{
+    hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, CapacityBoundedTraits> queue;
+    auto ptoken = queue.GetProducerToken();
+    auto ctoken = queue.GetConsumerToken();
+
+    std::vector<int> items(50, 1);
+    EXPECT_TRUE(queue.EnqueueBulk(ptoken, items.begin(), items.size()));
+    EXPECT_TRUE(queue.EnqueueBulk(items.begin(), items.size()));
+    EXPECT_FALSE(queue.Enqueue(100));
+
+    int  seen    = 0;
+    auto thrower = [&](int&) { if (++seen == 3) throw 1; };
+    EXPECT_THROW(queue.TryConsumeBulk(thrower, 10), int);
+    seen = 0;
+    EXPECT_THROW(queue.TryConsumeBulk(ctoken, thrower, 10), int);
+    seen = 0;
+    EXPECT_THROW(queue.TryConsumeBulkFromProducer(ptoken, [&](int*, std::size_t) { throw 1; }, 10), int);
+    EXPECT_EQ(queue.SizeApprox(), 70u);
+
+    // 三次各取走 10 个，正好空出 30 个位置
+    for (int i = 0; i < 30; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    EXPECT_FALSE(queue.Enqueue(100));
+    EXPECT_EQ(queue.SizeApprox(), 100u);
+}
+
+struct MoveCounted {
+    static inline std::atomic<int> Moves{0};
+    static inline std::atomic<int> Alive{0};
+
+    explicit MoveCounted(int v) : value(v) { ++Alive; }
+    MoveCounted(MoveCounted&& other) noexcept : value(other.value) { ++Moves; ++Alive; }
+    MoveCounted& operator=(MoveCounted&& other) noexcept { value = other.value; ++Moves; return *this; }
+    ~MoveCounted() { --Alive; }
+
+    int value;
+};
+
+TEST(ConcurrentQueueCorrectness, TryConsumeBulk_InPlace)
+{
+    {
+        hakle::ConcurrentQueue<MoveCounted> queue;
+        auto ptoken = queue.GetProducerToken();
+        const int N = 300;
+        for (int i = 0; i < N; ++i) {
+            EXPECT_TRUE(queue.Enqueue(i));
+            EXPECT_TRUE(queue.EnqueueWithToken(ptoken, N + i));
+        }
+
+        // 消费时元素原地交给回调，不应再发生移动
+        int movesBefore = MoveCounted::Moves.load();
+        long long sum = 0;
+        std::size_t got = queue.TryConsumeBulk([&](MoveCounted& item) { sum += item.value; }, 100);
+        EXPECT_EQ(got, 100u);
+
+        auto ctoken = queue.GetConsumerToken();
+        std::size_t total = got;
+        while ((got = queue.TryConsumeBulk(ctoken, [&](MoveCounted& item) { sum += item.value; }, 64)) != 0) {
+            total += got;
+        }
+        EXPECT_EQ(total, 2u * N);
+        EXPECT_EQ(sum, static_cast<long long>(2 * N - 1) * (2 * N) / 2);
+        EXPECT_EQ(MoveCounted::Moves.load(), movesBefore);
+        EXPECT_EQ(MoveCounted::Alive.load(), 0);
+
+        // 回调抛异常时，本次取出的剩余元素也要被析构
+        for (int i = 0; i < 10; ++i) EXPECT_TRUE(queue.EnqueueWithToken(ptoken, i));
+        int seen = 0;
+        EXPECT_THROW(queue.TryConsumeBulkFromProducer(ptoken, [&](MoveCounted&) { if (++seen == 3) throw 1; }, 10), int);
+        EXPECT_EQ(MoveCounted::Alive.load(), 0);
+        EXPECT_EQ(queue.SizeApprox(), 0u);
+    }
+    EXPECT_EQ(MoveCounted::Alive.load(), 0);
+}
+
+TEST(ConcurrentQueueCorrectness, ReserveCommit_InPlace)
+{
+    hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, CapacityBoundedTraits> queue;
+    auto token = queue.GetProducerToken();
+
+    decltype(queue)::Reservation reservation;
+    ASSERT_TRUE(queue.Reserve(token, 80, reservation));
+    std::vector<int> items(21, 1);
+    EXPECT_FALSE(queue.EnqueueBulk(items.begin(), items.size()));  // 预留的槽位也计入 MaxCapacity
+
+    int value = 0;
+    EXPECT_FALSE(queue.TryDequeue(value));
+    queue.Cancel(token, reservation);
+
+    ASSERT_TRUE(queue.Reserve(token, 100, reservation));
+    // 通过队列使用的分配器在槽位上原地构造
+    hakle::HakleAllocator<int> alloc;
+    int next = 0;
+    reservation.ForEachSpan([&](int* slots, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) hakle::HakeAllocatorTraits<hakle::HakleAllocator<int>>::Construct(alloc, slots + i, next++);
+    });
+    EXPECT_FALSE(queue.Enqueue(1));
+    queue.Commit(token, reservation);
+
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(queue.TryDequeue(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.TryDequeue(value));
+}
+
+TEST(ConcurrentQueueCorrectness, MpscQueue_SingleConsumer)
+{
+    hakle::MpscQueue<int> queue;
+    static_assert(hakle::MpscQueue<int>::SingleConsumer);
+
+    const int P = 4;
+    const int N = 20000;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < P; ++p) {
+        producers.emplace_back([&queue, p] {
+            auto token = queue.GetProducerToken();
+            for (int i = 0; i < N; ++i) {
+                // 一半走 token，一半走隐式生产者
+                if (i % 2 == 0) EXPECT_TRUE(queue.EnqueueWithToken(token, p * N + i));
+                else EXPECT_TRUE(queue.Enqueue(p * N + i));
+            }
+        });
+    }
+
+    // 同一生产者、同一子队列内的元素应保持 FIFO
+    std::vector<int> lastSeen(2 * P, -1);
+    std::vector<int> buf(64);
+    int total = 0;
+    while (total < P * N) {
+        std::size_t got = queue.TryDequeueBulk(buf.begin(), buf.size());
+        int value;
+        if (got == 0 && queue.TryDequeue(value)) {
+            buf[0] = value;
+            got = 1;
+        }
+        for (std::size_t i = 0; i < got; ++i) {
+            int p = buf[i] / N, lane = p * 2 + (buf[i] % 2);
+            EXPECT_GT(buf[i], lastSeen[lane]);
+            lastSeen[lane] = buf[i];
+        }
+        total += static_cast<int>(got);
+    }
+    for (auto& t : producers) t.join();
+
+    int value;
+    EXPECT_FALSE(queue.TryDequeue(value));
+    EXPECT_EQ(queue.SizeApprox(), 0u);
+}
+
+struct AdaptiveQuotaTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr std::size_t ConsumerRotationQuota = 4;
+    static constexpr bool        AdaptiveRotationQuota = true;
+};
+
+struct SmallQuotaTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr std::size_t ConsumerRotationQuota = 4;
+};
+
+TEST(ConcurrentQueueCorrectness, ConsumerToken_AdaptiveRotationQuota)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, AdaptiveQuotaTraits>;
+    static_assert(Queue::ConsumerRotationQuota == 4 && Queue::AdaptiveRotationQuota);
+
+    // 单个消费者时轮转是确定的：在深生产者上连续取出的个数就是它的配额。
+    // 自适应时配额随深度增长到上限 4 * 16，固定配额时每次只取 4 个就换下一个生产者
+    auto longestDeepRun = [](auto& q) {
+        using Q = std::remove_reference_t<decltype(q)>;
+        std::vector<typename Q::ProducerToken> producerTokens;
+        for (int p = 0; p < 6; ++p) producerTokens.emplace_back(q.GetProducerToken());
+        for (int p = 0; p < 6; ++p) {
+            for (int i = 0; i < (p == 0 ? 1000 : 200); ++i) EXPECT_TRUE(q.EnqueueWithToken(producerTokens[p], p));
+        }
+
+        auto token = q.GetConsumerToken();
+        std::size_t run = 0, longest = 0, shallowLeft = 5 * 200;
+        int value;
+        while (shallowLeft != 0 && q.TryDequeue(token, value)) {
+            run     = value == 0 ? run + 1 : 0;
+            longest = std::max(longest, run);
+            shallowLeft -= value == 0 ? 0 : 1;
+        }
+        while (q.TryDequeue(value)) {
+        }
+        return longest;
+    };
+    {
+        Queue adaptive;
+        EXPECT_EQ(longestDeepRun(adaptive), 4u * 16);
+        hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, SmallQuotaTraits> fixed;
+        EXPECT_EQ(longestDeepRun(fixed), 4u);
+    }
+
+    Queue queue;
+    const int P = 6;
+    std::vector<Queue::ProducerToken> tokens;
+    for (int p = 0; p < P; ++p) tokens.emplace_back(queue.GetProducerToken());
+
+    // 一个很深的生产者，其余都很浅
+    int expected = 0;
+    for (int p = 0; p < P; ++p) {
+        int count = p == 0 ? 5000 : 3;
+        for (int i = 0; i < count; ++i) EXPECT_TRUE(queue.EnqueueWithToken(tokens[p], 1));
+        expected += count;
+    }
+
+    std::atomic<int> consumed{0};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 4; ++c) {
+        consumers.emplace_back([&] {
+            auto token = queue.GetConsumerToken();
+            auto moved = std::move(token);  // token 移动后仍可用
+            int value;
+            while (consumed.load() < expected) {
+                if (queue.TryDequeue(moved, value)) consumed.fetch_add(value);
+            }
+        });
+    }
+    for (auto& t : consumers) t.join();
+
+    EXPECT_EQ(consumed.load(), expected);
+    EXPECT_EQ(queue.SizeApprox(), 0u);
+}
+
+struct RandomSelectionTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool RandomProducerSelection = true;
+};
+
+// 随机二选一：生产者跨越多个 segment，只有少数非空；随机起点绕回后也要能找到，且每个元素恰好取出一次
+TEST(ConcurrentQueueCorrectness, TryDequeue_RandomProducerSelection)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, RandomSelectionTraits>;
+    static_assert(Queue::RandomProducerSelection);
+
+    Queue queue;
+    const int P = 700;
+    std::vector<Queue::ProducerToken> tokens;
+    for (int p = 0; p < P; ++p) tokens.emplace_back(queue.GetProducerToken());
+
+    // 只有一个生产者非空，位置在第一个 segment 开头，绝大多数随机起点都要绕回
+    int value = -1;
+    EXPECT_FALSE(queue.TryDequeue(value));
+    for (int round = 0; round < 50; ++round) {
+        EXPECT_TRUE(queue.EnqueueWithToken(tokens[0], round));
+        EXPECT_TRUE(queue.TryDequeue(value));
+        EXPECT_EQ(value, round);
+        EXPECT_FALSE(queue.TryDequeue(value));
+    }
+
+    const int PerProducer = 2000;
+    std::vector<int> hot;
+    for (int p = 3; p < P; p += 97) hot.push_back(p);
+    for (int p : hot)
+        for (int i = 0; i < PerProducer; ++i) EXPECT_TRUE(queue.EnqueueWithToken(tokens[p], p * PerProducer + i));
+
+    const int total = static_cast<int>(hot.size()) * PerProducer;
+    std::vector<std::atomic<int>> seen(P * PerProducer);
+    std::atomic<int> consumed{0};
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < 8; ++c) {
+        consumers.emplace_back([&] {
+            int v;
+            while (consumed.load() < total) {
+                if (queue.TryDequeue(v)) {
+                    seen[v].fetch_add(1);
+                    consumed.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& t : consumers) t.join();
+
+    EXPECT_EQ(consumed.load(), total);
+    for (int p : hot)
+        for (int i = 0; i < PerProducer; ++i) EXPECT_EQ(seen[p * PerProducer + i].load(), 1);
+    EXPECT_FALSE(queue.TryDequeue(value));
+}
+
+struct ReclaimTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool ReclaimInactiveProducers = true;
+};
+
+// ProducerToken 销毁且已被取空的生产者会被摘链回收，节点之后可被新 token 复用
+TEST(ConcurrentQueueCorrectness, ReclaimInactiveProducers_Sequential)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, ReclaimTraits>;
+    static_assert(Queue::ReclaimInactiveProducers);
+
+    Queue queue;
+    auto consumer = queue.GetConsumerToken();
+    int value;
+    {
+        std::vector<Queue::ProducerToken> tokens;
+        for (int p = 0; p < 100; ++p) {
+            tokens.emplace_back(queue.GetProducerToken());
+            for (int i = 0; i < 40; ++i) EXPECT_TRUE(queue.EnqueueWithToken(tokens.back(), i));
+        }
+        for (int i = 0; i < 100 * 40; ++i) EXPECT_TRUE(queue.TryDequeue(consumer, value));
+        EXPECT_FALSE(queue.TryDequeue(value));
+
+        // 还有元素的生产者不能被回收
+        for (int i = 0; i < 5; ++i) EXPECT_TRUE(queue.EnqueueWithToken(tokens[0], 1000 + i));
+    }
+    queue.CollectInactiveProducers();
+    EXPECT_EQ(queue.GetProducerDepths().size(), 1u);
+
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(queue.TryDequeue(consumer, value));
+        EXPECT_EQ(value, 1000 + i);
+    }
+    queue.CollectInactiveProducers();
+    EXPECT_TRUE(queue.GetProducerDepths().empty());
+    EXPECT_FALSE(queue.TryDequeue(consumer, value));
+
+    // 复用回收的节点
+    std::vector<Queue::ProducerToken> tokens;
+    for (int p = 0; p < 10; ++p) {
+        tokens.emplace_back(queue.GetProducerToken());
+        EXPECT_TRUE(queue.EnqueueWithToken(tokens.back(), p));
+    }
+    EXPECT_EQ(queue.GetProducerDepths().size(), 10u);
+    int sum = 0;
+    for (int p = 0; p < 10; ++p) {
+        EXPECT_TRUE(queue.TryDequeue(consumer, value));
+        sum += value;
+    }
+    EXPECT_EQ(sum, 45);
+    EXPECT_FALSE(queue.TryDequeue(value));
+}
+
+// 短生命周期 token 并发入队，同时有 ConsumerToken / 无 token 消费者和回收线程，每个元素恰好取出一次
+TEST(ConcurrentQueueCorrectness, ReclaimInactiveProducers_Concurrent)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, ReclaimTraits>;
+
+    Queue queue;
+    const int Producers = 4, Rounds = 200, PerRound = 50;
+    const int total = Producers * Rounds * PerRound;
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> consumed{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < Producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int r = 0; r < Rounds; ++r) {
+                Queue::ProducerToken token = queue.GetProducerToken();
+                for (int i = 0; i < PerRound; ++i)
+                    EXPECT_TRUE(queue.EnqueueWithToken(token, (p * Rounds + r) * PerRound + i));
+            }
+        });
+    }
+    for (int c = 0; c < 4; ++c) {
+        threads.emplace_back([&, c] {
+            auto token = queue.GetConsumerToken();
+            int v;
+            while (consumed.load() < total) {
+                bool ok = c % 2 == 0 ? queue.TryDequeue(token, v) : queue.TryDequeue(v);
+                if (ok) {
+                    seen[v].fetch_add(1);
+                    consumed.fetch_add(1);
+                }
+            }
+        });
+    }
+    std::thread collector([&] {
+        while (!done.load()) {
+            queue.CollectInactiveProducers();
+            std::this_thread::yield();
+        }
+    });
+    for (auto& t : threads) t.join();
+    done = true;
+    collector.join();
+
+    EXPECT_EQ(consumed.load(), total);
+    for (int i = 0; i < total; ++i) EXPECT_EQ(seen[i].load(), 1);
+
+    queue.CollectInactiveProducers();
+    EXPECT_TRUE(queue.GetProducerDepths().empty());
+}
+
+// 生产者注册表：跨多个分段按下标取节点；token 复用空闲节点不增加生产者；ConsumerToken 直接定位到各自的生产者
+TEST(ConcurrentQueueCorrectness, ProducerRegistry_TokenReuseAndConsumerPositioning)
+{
+    {
+        hakle::ProducerRegistry<int> registry;
+        std::vector<int> nodes(1000);
+        for (std::size_t i = 0; i < nodes.size(); ++i) {
+            std::uint32_t slot = 0;
+            EXPECT_TRUE(registry.Add(&nodes[i], slot));
+            EXPECT_EQ(slot, i);
+        }
+        EXPECT_EQ(registry.Size(), nodes.size());
+        for (std::size_t i = 0; i < nodes.size(); ++i) EXPECT_EQ(registry.At(i), &nodes[i]);
+        registry.Set(500, nullptr);
+        EXPECT_EQ(registry.At(500), nullptr);
+        EXPECT_EQ(registry.At(nodes.size()), nullptr);
+        // 只统计非空槽位；重复写同一个值不改变计数
+        EXPECT_EQ(registry.LiveSize(), nodes.size() - 1);
+        registry.Set(500, nullptr);
+        EXPECT_EQ(registry.LiveSize(), nodes.size() - 1);
+        registry.Set(500, &nodes[500]);
+        registry.Set(500, &nodes[500]);
+        EXPECT_EQ(registry.LiveSize(), nodes.size());
+    }
+
+    hakle::ConcurrentQueue<int> queue;
+    for (int round = 0; round < 3; ++round) {
+        std::vector<hakle::ConcurrentQueue<int>::ProducerToken> tokens;
+        for (int p = 0; p < 500; ++p) tokens.emplace_back(queue.GetProducerToken());
+    }
+    EXPECT_EQ(queue.GetProducerDepths().size(), 500u);
+
+    // 每个 ConsumerToken 的第一次出队来自不同的生产者
+    constexpr int Producers = 8;
+    hakle::ConcurrentQueue<int> fresh;
+    std::vector<hakle::ConcurrentQueue<int>::ProducerToken> tokens;
+    for (int p = 0; p < Producers; ++p) tokens.emplace_back(fresh.GetProducerToken());
+    for (int p = 0; p < Producers; ++p) {
+        for (int i = 0; i < 10; ++i) EXPECT_TRUE(fresh.EnqueueWithToken(tokens[p], p * 100 + i));
+    }
+
+    std::vector<hakle::ConcurrentQueue<int>::ConsumerToken> consumers;
+    std::vector<bool> used(Producers, false);
+    for (int c = 0; c < Producers; ++c) {
+        consumers.emplace_back(fresh.GetConsumerToken());
+        int value;
+        EXPECT_TRUE(fresh.TryDequeue(consumers.back(), value));
+        EXPECT_FALSE(used[value / 100]);
+        used[value / 100] = true;
+    }
+
+    // 回收注册表中间的一段生产者：回收时把存活的生产者压到注册表前部，token 按存活生产者计数，仍然均匀分散，而不是都挤到同一个生产者上
+    using ReclaimQueue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, ReclaimTraits>;
+    ReclaimQueue holes;
+    std::vector<std::optional<ReclaimQueue::ProducerToken>> holeTokens;
+    for (int p = 0; p < 2 * Producers; ++p) holeTokens.emplace_back(holes.GetProducerToken());
+    for (int p = Producers / 2; p < Producers / 2 + Producers; ++p) holeTokens[p].reset();
+    holes.CollectInactiveProducers();
+    ASSERT_EQ(holes.GetProducerDepths().size(), static_cast<std::size_t>(Producers));
+
+    std::vector<int> live;
+    for (int p = 0; p < 2 * Producers; ++p) {
+        if (!holeTokens[p]) continue;
+        live.push_back(p);
+        for (int i = 0; i < 10; ++i) EXPECT_TRUE(holes.EnqueueWithToken(*holeTokens[p], p * 100 + i));
+    }
+
+    std::vector<ReclaimQueue::ConsumerToken> holeConsumers;
+    std::vector<int> hits(2 * Producers, 0);
+    for (int c = 0; c < 2 * Producers; ++c) {
+        holeConsumers.emplace_back(holes.GetConsumerToken());
+        int value;
+        EXPECT_TRUE(holes.TryDequeue(holeConsumers.back(), value));
+        ++hits[value / 100];
+    }
+    for (int p : live) EXPECT_EQ(hits[p], 2) << "producer " << p;
+
+    // 新的生产者复用被回收的节点，填回紧跟在存活生产者后面的空槽：每个新 ConsumerToken 恰好落在一个不同的生产者上
+    for (int p = Producers / 2; p < Producers / 2 + Producers; ++p) {
+        holeTokens[p].emplace(holes.GetProducerToken());
+        for (int i = 0; i < 10; ++i) EXPECT_TRUE(holes.EnqueueWithToken(*holeTokens[p], p * 100 + i));
+    }
+    ASSERT_EQ(holes.GetProducerDepths().size(), static_cast<std::size_t>(2 * Producers));
+    holes.CollectInactiveProducers();
+
+    std::vector<ReclaimQueue::ConsumerToken> refilledConsumers;
+    std::vector<int> refilledHits(2 * Producers, 0);
+    for (int c = 0; c < 2 * Producers; ++c) {
+        refilledConsumers.emplace_back(holes.GetConsumerToken());
+        int value;
+        EXPECT_TRUE(holes.TryDequeue(refilledConsumers.back(), value));
+        ++refilledHits[value / 100];
+    }
+    for (int p = 0; p < 2 * Producers; ++p) EXPECT_EQ(refilledHits[p], 1) << "producer " << p;
+}
+
+struct IsolatedLayoutTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool CacheLineIsolatedLayout = true;
+};
+
+// 缓存行隔离布局：子队列按缓存行对齐，单生产者多消费者下每个元素恰好取出一次
+TEST(ConcurrentQueueCorrectness, CacheLineIsolatedLayout_SingleProducerManyConsumers)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, IsolatedLayoutTraits>;
+    static_assert(alignof(Queue::ExplicitProducer) >= HAKLE_CACHE_LINE_SIZE);
+    static_assert(alignof(Queue::ImplicitProducer) >= HAKLE_CACHE_LINE_SIZE);
+    static_assert(sizeof(hakle::ConcurrentQueue<int>::ExplicitProducer) < sizeof(Queue::ExplicitProducer));
+
+    Queue queue;
+    const int total = 200000;
+    std::vector<std::atomic<int>> seen(total);
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        auto token = queue.GetProducerToken();
+        for (int i = 0; i < total; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, i));
+    });
+    threads.emplace_back([&] {
+        for (int i = 0; i < total; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    });
+    for (int c = 0; c < 8; ++c) {
+        threads.emplace_back([&, c] {
+            auto token = queue.GetConsumerToken();
+            int v;
+            while (consumed.load() < 2 * total) {
+                bool ok = c % 2 == 0 ? queue.TryDequeue(token, v) : queue.TryDequeue(v);
+                if (ok) {
+                    seen[v].fetch_add(1);
+                    consumed.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(consumed.load(), 2 * total);
+    for (int i = 0; i < total; ++i) EXPECT_EQ(seen[i].load(), 2);
+}
+
+#if defined(__linux__)
+struct NotifyTraits : hakle::ConcurrentQueueDefaultTraits<int, hakle::HakleAllocator<int>> {
+    static constexpr bool ReadinessNotification = true;
+};
+
+// eventfd 就绪通知：消费者醒着时不写 fd，睡前 Arm 之后一阵突发只写一次
+TEST(ConcurrentQueueCorrectness, ReadinessNotifier_EventFdCoalescing)
+{
+    using Queue = hakle::ConcurrentQueue<int, hakle::HakleAllocator<int>, NotifyTraits>;
+    static_assert(sizeof(hakle::ConcurrentQueue<int>) < sizeof(Queue));
+
+    hakle::EventFdNotifier notifier;
+    Queue queue;
+    queue.SetNotifier(&hakle::EventFdNotifier::Signal, &notifier);
+
+    // 没有 Arm，消费者被视为醒着
+    for (int i = 0; i < 10; ++i) EXPECT_TRUE(queue.Enqueue(i));
+    EXPECT_EQ(notifier.WriteCount(), 0u);
+    EXPECT_FALSE(queue.ArmNotifier());  // 还有元素，不能睡
+    int v;
+    while (queue.TryDequeue(v)) {}
+
+    EXPECT_TRUE(queue.ArmNotifier());
+    {
+        auto token = queue.GetProducerToken();
+        for (int i = 0; i < 100; ++i) EXPECT_TRUE(i % 2 == 0 ? queue.Enqueue(i) : queue.EnqueueWithToken(token, i));
+    }
+    EXPECT_EQ(notifier.WriteCount(), 1u);
+    EXPECT_EQ(notifier.Acknowledge(), 1u);
+    EXPECT_EQ(notifier.Acknowledge(), 0u);
+
+    // move 之后通知跟着元素走
+    Queue moved(std::move(queue));
+    while (moved.TryDequeue(v)) {}
+    EXPECT_TRUE(moved.ArmNotifier());
+    EXPECT_TRUE(queue.Enqueue(1));
+    EXPECT_EQ(notifier.WriteCount(), 1u);
+    EXPECT_TRUE(moved.Enqueue(1));
+    EXPECT_EQ(notifier.WriteCount(), 2u);
+    notifier.Acknowledge();
+    while (moved.TryDequeue(v)) {}
+
+    // epoll 式消费循环：多个生产者并发入队，每个元素取出一次，写次数不超过睡眠次数
+    const int producers = 4;
+    const int perProducer = 50000;
+    std::atomic<int> consumed{0};
+    std::uint64_t sleeps = 0;
+    const std::uint64_t writesBefore = notifier.WriteCount();
+    std::thread consumer([&] {
+        pollfd pfd{notifier.Fd(), POLLIN, 0};
+        int item;
+        while (consumed.load() < producers * perProducer) {
+            while (moved.TryDequeue(item)) consumed.fetch_add(1);
+            if (consumed.load() == producers * perProducer || !moved.ArmNotifier()) continue;
+            ++sleeps;
+            ::poll(&pfd, 1, 100);
+            notifier.Acknowledge();
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < perProducer; ++i) EXPECT_TRUE(moved.Enqueue(i));
+        });
+    }
+    for (auto& t : threads) t.join();
+    consumer.join();
+
+    EXPECT_EQ(consumed.load(), producers * perProducer);
+    EXPECT_LE(notifier.WriteCount() - writesBefore, sleeps);
+}
+
+struct SpillTraits : hakle::ConcurrentQueueDefaultTraits<std::uint64_t, hakle::HakleAllocator<std::uint64_t>> {
+    static constexpr std::size_t SpillBlockBudget = 2;     // 每个子队列内存里最多 64 个元素
+    static constexpr std::size_t SpillSegmentSize = 4096;  // 512 个元素一个段文件，频繁换段
+    static constexpr const char* SpillDirectory   = "/tmp";
+};
+
+// 超出内存预算的元素落到段文件里，读回来仍然按生产者 FIFO
+TEST(ConcurrentQueueCorrectness, SpillToDisk_PerProducerFifo)
+{
+    using Queue = hakle::ConcurrentQueue<std::uint64_t, hakle::HakleAllocator<std::uint64_t>, SpillTraits>;
+    static_assert(Queue::SpillToDisk && !hakle::ConcurrentQueue<std::uint64_t>::SpillToDisk);
+
+    Queue queue;
+    auto token = queue.GetProducerToken();
+
+    // 显式生产者：单个 + 批量混着来，中途被消费一部分也不能乱序
+    std::uint64_t next = 0;
+    std::uint64_t expected = 0;
+    std::uint64_t batch[100];
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 150; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, next++));
+        for (auto& b : batch) b = next++;
+        EXPECT_TRUE(queue.EnqueueBulk(token, batch, 100));
+        std::uint64_t v;
+        for (int i = 0; i < 120; ++i) {
+            ASSERT_TRUE(queue.TryDequeueFromProducer(token, v));
+            ASSERT_EQ(v, expected++);
+        }
+    }
+    EXPECT_EQ(queue.SizeApprox(), next - expected);
+    std::uint64_t out[70];
+    for (std::size_t count; (count = queue.TryDequeueBulk(out, 70)) != 0;) {
+        for (std::size_t i = 0; i < count; ++i) ASSERT_EQ(out[i], expected++);
+    }
+    EXPECT_EQ(expected, next);
+    EXPECT_EQ(queue.SizeApprox(), 0u);
+
+    // 读空之后回到内存，再次超出预算又落盘
+    for (std::uint64_t i = 0; i < 1000; ++i) EXPECT_TRUE(queue.EnqueueWithToken(token, next++));
+    // 隐式生产者走同样的路径
+    for (std::uint64_t i = 0; i < 1000; i += 100) {
+        for (std::uint64_t j = 0; j < 100; ++j) batch[j] = i + j;
+        EXPECT_TRUE(queue.EnqueueBulk(batch, 100));
+    }
+    std::uint64_t v;
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(queue.TryDequeueFromProducer(token, v));
+        ASSERT_EQ(v, expected++);
+    }
+    for (std::uint64_t i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(queue.TryDequeue(v));
+        ASSERT_EQ(v, i);
+    }
+    EXPECT_FALSE(queue.TryDequeue(v));
+
+    // 不允许分配时也不能开新的段文件
+    Queue bounded;
+    auto boundedToken = bounded.GetProducerToken();
+    std::size_t accepted = 0;
+    while (accepted < 10000 && bounded.TryEnqueue(boundedToken, std::uint64_t{accepted})) ++accepted;
+    EXPECT_EQ(accepted, SpillTraits::SpillBlockBudget * Queue::BlockSize);
+}
+
+// 多生产者多消费者：每个消费者看到的同一生产者的元素严格递增
+TEST(ConcurrentQueueCorrectness, SpillToDisk_MPMC)
+{
+    using Queue = hakle::ConcurrentQueue<std::uint64_t, hakle::HakleAllocator<std::uint64_t>, SpillTraits>;
+    Queue queue;
+
+    const int producers = 4;
+    const int consumers = 4;
+    const std::uint64_t perProducer = 50000;
+    const std::uint64_t total = producers * perProducer;
+    std::atomic<std::uint64_t> consumed{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<int> disorder{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            auto token = queue.GetProducerToken();
+            for (std::uint64_t i = 0; i < perProducer; ++i) {
+                std::uint64_t value = static_cast<std::uint64_t>(p) << 32 | i;
+                EXPECT_TRUE(p % 2 == 0 ? queue.EnqueueWithToken(token, value) : queue.Enqueue(value));
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            std::vector<std::int64_t> last(producers, -1);
+            std::uint64_t items[32];
+            while (consumed.load() < total) {
+                std::size_t count = c % 2 == 0 ? queue.TryDequeueBulk(items, 32) : queue.TryDequeue(items[0]);
+                for (std::size_t i = 0; i < count; ++i) {
+                    int p = static_cast<int>(items[i] >> 32);
+                    std::int64_t seq = static_cast<std::int64_t>(items[i] & 0xffffffff);
+                    if (seq <= last[p]) disorder.fetch_add(1);
+                    last[p] = seq;
+                    sum.fetch_add(seq);
+                }
+                consumed.fetch_add(count);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(disorder.load(), 0);
+    EXPECT_EQ(consumed.load(), total);
+    EXPECT_EQ(sum.load(), producers * (perProducer * (perProducer - 1) / 2));
+    EXPECT_EQ(queue.SizeApprox(), 0u);
+}
+#endif
+
+// 对数线性直方图：桶的上下界包住落进来的值，分位数取桶上界且不超过最大值
+TEST(ConcurrentQueueCorrectness, LogLinearHistogram_Buckets)
+{
+    using hakle::LogLinearHistogram;
+    for (std::uint64_t v : {0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, ~0ull}) {
+        std::size_t bucket = LogLinearHistogram::BucketFor(v);
+        ASSERT_LT(bucket, LogLinearHistogram::BucketCount);
+        EXPECT_LE(LogLinearHistogram::BucketLowerBound(bucket), v);
+        EXPECT_GE(LogLinearHistogram::BucketUpperBound(bucket), v);
+    }
+    EXPECT_EQ(LogLinearHistogram::BucketFor(~0ull), LogLinearHistogram::BucketCount - 1);
+
+    LogLinearHistogram histogram;
+    for (std::uint64_t v = 1; v <= 1000; ++v) histogram.Record(v);
+    EXPECT_EQ(histogram.Count(), 1000u);
+    EXPECT_EQ(histogram.Sum(), 500500u);
+    EXPECT_EQ(histogram.Max(), 1000u);
+    // 桶宽不超过 1/16
+    EXPECT_GE(histogram.ValueAtQuantile(0.5), 500u);
+    EXPECT_LE(histogram.ValueAtQuantile(0.5), 500u + 500u / 16);
+    EXPECT_EQ(histogram.ValueAtQuantile(1.0), 1000u);
+
+    LogLinearHistogram merged = histogram;
+    merged.Merge(histogram);
+    EXPECT_EQ(merged.Count(), 2000u);
+    EXPECT_EQ(merged.CountAt(LogLinearHistogram::BucketFor(7)), 2u);
+}
+
+// 计时模式：每个出队的元素都记一次停留时间，不管走哪条入队/出队路径
+TEST(ConcurrentQueueCorrectness, SojournTiming_AllPaths)
+{
+    // 默认队列和默认块不带时间戳
+    static_assert(!hakle::ConcurrentQueue<int>::SojournTiming && hakle::TimedConcurrentQueue<int>::SojournTiming);
+    static_assert(!hakle::details::HasStamps<hakle::HakleFlagsBlock<int, 32>> && !hakle::details::HasStamps<hakle::HakleCounterBlock<int, 32>>);
+    static_assert(hakle::details::HasStamps<hakle::HakleTimestampedFlagsBlock<int, 32>>);
+
+    hakle::TimedConcurrentQueue<int> queue;
+    hakle::TimedConcurrentQueue<int> moved;  // 先于 token 声明，token 指向的节点最后归它
+    auto token = queue.GetProducerToken();
+
+    int next = 0;
+    for (int i = 0; i < 50; ++i) ASSERT_TRUE(queue.EnqueueWithToken(token, next++));
+    for (int i = 0; i < 50; ++i) ASSERT_TRUE(queue.Enqueue(next++));
+    std::vector<int> items(70);
+    for (int& item : items) item = next++;
+    ASSERT_TRUE(queue.EnqueueBulk(token, items.begin(), items.size()));
+    ASSERT_TRUE(queue.EnqueueBulk(items.begin(), items.size()));
+
+    decltype(queue)::Reservation reservation;
+    ASSERT_TRUE(queue.Reserve(token, 40, reservation));
+    hakle::HakleAllocator<int> alloc;
+    reservation.ForEachSpan([&](int* slots, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) hakle::HakeAllocatorTraits<hakle::HakleAllocator<int>>::Construct(alloc, slots + i, next++);
+    });
+    queue.Commit(token, reservation);
+    const std::size_t total = 50 + 50 + 2 * items.size() + 40;
+
+    const auto sleepFor = std::chrono::milliseconds(5);
+    std::this_thread::sleep_for(sleepFor);
+
+    std::size_t dequeued = 0;
+    int value;
+    for (int i = 0; i < 30; ++i) dequeued += queue.TryDequeue(value);
+    auto consumerToken = queue.GetConsumerToken();
+    for (int i = 0; i < 30; ++i) dequeued += queue.TryDequeue(consumerToken, value);
+    dequeued += queue.TryDequeueFromProducer(token, value);
+    dequeued += queue.TryDequeueBulk(consumerToken, items.begin(), items.size());
+    std::size_t got;
+    while ((got = queue.TryDequeueBulk(items.begin(), items.size())) != 0) dequeued += got;
+    ASSERT_EQ(dequeued, total);
+
+    hakle::LogLinearHistogram histogram = queue.GetSojournHistogram();
+    EXPECT_EQ(histogram.Count(), total);
+    // 每个元素都至少等了 sleepFor
+    const std::uint64_t minimum = std::chrono::duration_cast<std::chrono::nanoseconds>(sleepFor).count();
+    EXPECT_GE(histogram.ValueAtQuantile(0.0), minimum);
+    EXPECT_GE(histogram.Mean(), static_cast<double>(minimum));
+    EXPECT_GE(histogram.Max(), minimum);
+
+    // 出队失败不记录；移动后直方图跟着队列走，moved 原来的直方图清掉
+    EXPECT_FALSE(queue.TryDequeue(value));
+    ASSERT_TRUE(moved.Enqueue(1));
+    ASSERT_TRUE(moved.TryDequeue(value));
+    moved = std::move(queue);
+    EXPECT_EQ(moved.GetSojournHistogram().Count(), total);
+    EXPECT_EQ(queue.GetSojournHistogram().Count(), 0u);
+    ASSERT_TRUE(moved.Enqueue(1));
+    ASSERT_TRUE(moved.TryDequeue(value));
+    EXPECT_EQ(moved.GetSojournHistogram().Count(), total + 1);
+}
+
+// 多个消费者线程各写各的直方图，合并后总数等于出队总数
+TEST(ConcurrentQueueCorrectness, SojournTiming_MergeAcrossConsumers)
+{
+    hakle::TimedConcurrentQueue<int> queue;
+
+    const int producers = 4;
+    const int consumers = 4;
+    const int perProducer = 20000;
+    const int total = producers * perProducer;
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            auto token = queue.GetProducerToken();
+            for (int i = 0; i < perProducer; ++i) {
+                EXPECT_TRUE(p % 2 == 0 ? queue.EnqueueWithToken(token, i) : queue.Enqueue(i));
+            }
+        });
+    }
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&, c] {
+            int items[16];
+            while (consumed.load() < total) {
+                std::size_t count = c % 2 == 0 ? queue.TryDequeueBulk(items, 16) : queue.TryDequeue(items[0]);
+                consumed.fetch_add(static_cast<int>(count));
+                // 边消费边读合并结果
+                if (c == 0) {
+                    EXPECT_LE(queue.GetSojournHistogram().Count(), static_cast<std::uint64_t>(total));
+                }
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+
+    EXPECT_EQ(consumed.load(), total);
+    hakle::LogLinearHistogram histogram = queue.GetSojournHistogram();
+    EXPECT_EQ(histogram.Count(), static_cast<std::uint64_t>(total));
+    EXPECT_GE(histogram.ValueAtQuantile(0.99), histogram.ValueAtQuantile(0.5));
+    EXPECT_LE(histogram.ValueAtQuantile(0.99), histogram.Max());
+}
+
 // 还可以继续加：
 // - 普通 Enq + ConsumerToken Deq（单元素）
 // - 普通 BulkEnq + ConsumerToken BulkDeq
@@ -586,6 +586,42 @@ TEST_F( HashTableTest, BoundaryValues ) {
     EXPECT_EQ( outValue, 200 );
 }
 
+// 删除与墓碑复用
+TEST_F( HashTableTest, RemoveAndReuseTombstone ) {
+    TestHashTable tombstoneTable( UINT32_MAX, UINT32_MAX - 1 );
+    uint32_t      outValue = 0;
+
+    // 未配置墓碑时删除失败
+    EXPECT_FALSE( table->Remove( 1 ) );
+
+    for ( uint32_t i = 0; i < 6; ++i ) {
+        EXPECT_EQ( tombstoneTable.GetOrAdd( i, outValue, i * 10 ), HashTableStatus::ADD_SUCCESS );
+    }
+    EXPECT_TRUE( tombstoneTable.Remove( 3 ) );
+    EXPECT_FALSE( tombstoneTable.Remove( 3 ) );
+    EXPECT_FALSE( tombstoneTable.Get( 3, outValue ) );
+
+    // 其他键不受影响
+    EXPECT_TRUE( tombstoneTable.Get( 4, outValue ) );
+    EXPECT_EQ( outValue, 40 );
+
+    // 少量键反复删除再插入（类似线程 id 被复用）应复用墓碑，表不应持续增长
+    std::size_t sizeAfterWarmup = 0;
+    for ( uint32_t round = 0; round < 1000; ++round ) {
+        uint32_t key = 100 + round % 2;
+        EXPECT_EQ( tombstoneTable.GetOrAdd( key, outValue, round ), HashTableStatus::ADD_SUCCESS );
+        EXPECT_TRUE( tombstoneTable.Remove( key ) );
+        if ( round == 99 ) {
+            sizeAfterWarmup = tombstoneTable.GetSize();
+        }
+    }
+    EXPECT_EQ( tombstoneTable.GetSize(), sizeAfterWarmup );
+
+    EXPECT_EQ( tombstoneTable.GetOrAdd( 3, outValue, 33 ), HashTableStatus::ADD_SUCCESS );
+    EXPECT_TRUE( tombstoneTable.Get( 3, outValue ) );
+    EXPECT_EQ( outValue, 33 );
+}
+
 int main( int argc, char** argv ) {
     ::testing::InitGoogleTest( &argc, argv );
     return RUN_ALL_TESTS();
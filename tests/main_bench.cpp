@@ -442,6 +442,125 @@ static void BM_CQ_NormalBulkEnq_ConsTokenBulkDeq(benchmark::State& state)
 }
 BENCHMARK(BM_CQ_NormalBulkEnq_ConsTokenBulkDeq)->MeasureProcessCPUTime();
 
+// 9. 多生产者 普通 Enqueue / TryDequeue，生产者数量由参数给出，总元素数固定
+// 每次 TryDequeue 都要遍历生产者链表，用来观察遍历本身的开销
+constexpr std::size_t kManyProdTotalItems = 2000000;
+
+static void BM_CQ_NormalEnqDeq_ManyProducers(benchmark::State& state)
+{
+    const std::size_t prodThreads  = static_cast<std::size_t>(state.range(0));
+    const std::size_t itemsPerProd = kManyProdTotalItems / prodThreads;
+    const std::size_t totalItems   = prodThreads * itemsPerProd;
+
+    for (auto _ : state) {
+        hakle::ConcurrentQueue<int> queue;
+
+        std::atomic<std::size_t> consumed{0};
+
+        std::vector<std::thread> producers, consumers;
+
+        for (std::size_t p = 0; p < prodThreads; ++p) {
+            producers.emplace_back([&, p] {
+                for (std::size_t i = 0; i < itemsPerProd; ++i) {
+                    queue.Enqueue(static_cast<int>(p * itemsPerProd + i));
+                }
+            });
+        }
+
+        for (std::size_t c = 0; c < kConsThreads; ++c) {
+            consumers.emplace_back([&] {
+                int value;
+                while (consumed.load(std::memory_order_relaxed) < totalItems) {
+                    if (queue.TryDequeue(value)) {
+                        consumed.fetch_add(1, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+
+        for (auto& t : producers) t.join();
+        for (auto& t : consumers) t.join();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * totalItems));
+}
+BENCHMARK(BM_CQ_NormalEnqDeq_ManyProducers)->Arg(64)->Arg(256)->MeasureProcessCPUTime();
+
+// 10. 多生产者 Bulk Enqueue / TryDequeueBulk
+static void BM_CQ_BulkEnqDeq_ManyProducers(benchmark::State& state)
+{
+    const std::size_t prodThreads  = static_cast<std::size_t>(state.range(0));
+    const std::size_t itemsPerProd = kManyProdTotalItems / prodThreads;
+    const std::size_t totalItems   = prodThreads * itemsPerProd;
+
+    for (auto _ : state) {
+        hakle::ConcurrentQueue<int> queue;
+
+        std::atomic<std::size_t> consumed{0};
+
+        std::vector<std::thread> producers, consumers;
+
+        for (std::size_t p = 0; p < prodThreads; ++p) {
+            producers.emplace_back([&, p] {
+                std::vector<int> buf(kBulkSize);
+                std::size_t      sent = 0;
+                while (sent < itemsPerProd) {
+                    std::size_t n = std::min(kBulkSize, itemsPerProd - sent);
+                    for (std::size_t i = 0; i < n; ++i) {
+                        buf[i] = static_cast<int>(p * itemsPerProd + sent + i);
+                    }
+                    queue.EnqueueBulk(buf.data(), n);
+                    sent += n;
+                }
+            });
+        }
+
+        for (std::size_t c = 0; c < kConsThreads; ++c) {
+            consumers.emplace_back([&] {
+                std::vector<int> buf(kBulkSize);
+                while (consumed.load(std::memory_order_relaxed) < totalItems) {
+                    std::size_t got = queue.TryDequeueBulk(buf.data(), kBulkSize);
+                    if (got > 0) {
+                        consumed.fetch_add(got, std::memory_order_relaxed);
+                    }
+                }
+            });
+        }
+
+        for (auto& t : producers) t.join();
+        for (auto& t : consumers) t.join();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * totalItems));
+}
+BENCHMARK(BM_CQ_BulkEnqDeq_ManyProducers)->Arg(64)->Arg(256)->MeasureProcessCPUTime();
+
+// 11. 大量空闲生产者 + 单个活跃生产者，TryDequeue 只应访问非空的生产者
+constexpr std::size_t kSparseItems = 200000;
+
+static void BM_CQ_TryDequeue_IdleProducers(benchmark::State& state)
+{
+    const std::size_t idleProducers = static_cast<std::size_t>(state.range(0));
+
+    for (auto _ : state) {
+        hakle::ConcurrentQueue<int> queue;
+
+        std::vector<hakle::ConcurrentQueue<int>::ProducerToken> idle;
+        idle.reserve(idleProducers);
+        for (std::size_t i = 0; i < idleProducers; ++i) {
+            idle.emplace_back(queue);
+        }
+
+        auto active = queue.GetProducerToken();
+        int  value;
+        for (std::size_t i = 0; i < kSparseItems; ++i) {
+            queue.EnqueueWithToken(active, static_cast<int>(i));
+            queue.TryDequeue(value);
+            queue.TryDequeue(value);  // 队列已空，空扫描的开销
+        }
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kSparseItems));
+}
+BENCHMARK(BM_CQ_TryDequeue_IdleProducers)->Arg(16)->Arg(4096)->MeasureProcessCPUTime();
+
 #endif // USE_MY
 
 // ---------------- moodycamel 版本，同样模式 ----------------
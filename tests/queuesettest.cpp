@@ -0,0 +1,197 @@
+#include "ConcurrentQueue/QueueSet.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace hakle;
+
+namespace {
+
+template <class T>
+struct LaneTraits : ConcurrentQueueDefaultTraits<T, HakleAllocator<T>> {
+    static constexpr bool ReadinessNotification = true;
+};
+
+template <class T>
+using Lane = ConcurrentQueue<T, HakleAllocator<T>, LaneTraits<T>>;
+
+}  // namespace
+
+TEST( QueueSetTest, WaitReturnsReadyMember ) {
+    Lane<int>         control;
+    Lane<std::string> data;
+    Lane<int>         bulk;
+
+    QueueSet set;
+    EXPECT_EQ( set.Add( control ), 0 );
+    EXPECT_EQ( set.Add( data ), 1 );
+    EXPECT_EQ( set.Add( bulk ), 2 );
+    EXPECT_EQ( set.Size(), 3 );
+
+    EXPECT_EQ( set.TryWait(), QueueSet::NoMember );
+
+    EXPECT_TRUE( data.Enqueue( "hello" ) );
+    EXPECT_TRUE( data.Enqueue( "world" ) );
+    EXPECT_EQ( set.TryWait(), 1 );
+
+    std::string value;
+    EXPECT_TRUE( data.TryDequeue( value ) );
+    EXPECT_EQ( value, "hello" );
+    EXPECT_TRUE( data.TryDequeue( value ) );
+    EXPECT_FALSE( data.TryDequeue( value ) );
+    EXPECT_EQ( set.TryWait(), QueueSet::NoMember );
+}
+
+TEST( QueueSetTest, ElementsEnqueuedBeforeAdd ) {
+    Lane<int> lane;
+    EXPECT_TRUE( lane.Enqueue( 5 ) );
+
+    QueueSet set;
+    set.Add( lane );
+    EXPECT_EQ( set.Wait( std::chrono::milliseconds( 10 ) ), 0 );
+
+    int value = 0;
+    EXPECT_TRUE( lane.TryDequeue( value ) );
+    EXPECT_EQ( value, 5 );
+    EXPECT_EQ( set.Wait( std::chrono::milliseconds( 10 ) ), QueueSet::NoMember );
+}
+
+TEST( QueueSetTest, LowerIndexWins ) {
+    Lane<int> lanes[ 3 ];
+    QueueSet  set;
+    for ( auto& lane : lanes ) {
+        set.Add( lane );
+    }
+    EXPECT_EQ( set.TryWait(), QueueSet::NoMember );
+
+    EXPECT_TRUE( lanes[ 2 ].Enqueue( 2 ) );
+    EXPECT_TRUE( lanes[ 0 ].Enqueue( 0 ) );
+
+    int value = -1;
+    EXPECT_EQ( set.TryWait(), 0 );
+    EXPECT_TRUE( lanes[ 0 ].TryDequeue( value ) );
+    EXPECT_EQ( set.TryWait(), 2 );
+    EXPECT_TRUE( lanes[ 2 ].TryDequeue( value ) );
+    EXPECT_EQ( set.TryWait(), QueueSet::NoMember );
+}
+
+TEST( QueueSetTest, WaitBlocksUntilEnqueue ) {
+    Lane<int> lanes[ 2 ];
+    QueueSet  set;
+    set.Add( lanes[ 0 ] );
+    set.Add( lanes[ 1 ] );
+
+    auto        start = std::chrono::steady_clock::now();
+    std::size_t ready = QueueSet::NoMember;
+    std::thread consumer( [ & ] { ready = set.Wait(); } );
+
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    EXPECT_TRUE( lanes[ 1 ].Enqueue( 1 ) );
+    consumer.join();
+
+    EXPECT_EQ( ready, 1 );
+    EXPECT_GE( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 20 ) );
+}
+
+TEST( QueueSetTest, ManyProducersOneConsumer ) {
+    constexpr int           laneCount    = 3;
+    constexpr int           itemsPerLane = 50000;
+    constexpr std::uint64_t totalItems   = static_cast<std::uint64_t>( laneCount ) * itemsPerLane;
+
+    Lane<int> lanes[ laneCount ];
+    QueueSet  set;
+    for ( auto& lane : lanes ) {
+        set.Add( lane );
+    }
+
+    std::vector<std::thread> producers;
+    for ( int l = 0; l < laneCount; ++l ) {
+        producers.emplace_back( [ &, l ] {
+            auto token = lanes[ l ].GetProducerToken();
+            for ( int i = 0; i < itemsPerLane; ++i ) {
+                // pause now and then so the consumer really goes to sleep
+                if ( i % 1000 == 0 ) {
+                    std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+                }
+                lanes[ l ].EnqueueWithToken( token, l * itemsPerLane + i );
+            }
+        } );
+    }
+
+    std::uint64_t consumed = 0;
+    std::uint64_t sum      = 0;
+    std::uint64_t perLane[ laneCount ]{};
+    while ( consumed < totalItems ) {
+        std::size_t index = set.Wait( 1000 );
+        ASSERT_NE( index, QueueSet::NoMember );
+        int items[ 64 ];
+        for ( std::size_t count; ( count = lanes[ index ].TryDequeueBulk( items, 64 ) ) != 0; ) {
+            for ( std::size_t i = 0; i < count; ++i ) {
+                sum += static_cast<std::uint64_t>( items[ i ] );
+            }
+            consumed += count;
+            perLane[ index ] += count;
+        }
+    }
+    for ( auto& t : producers ) {
+        t.join();
+    }
+
+    EXPECT_EQ( consumed, totalItems );
+    EXPECT_EQ( sum, totalItems * ( totalItems - 1 ) / 2 );
+    for ( int l = 0; l < laneCount; ++l ) {
+        EXPECT_EQ( perLane[ l ], static_cast<std::uint64_t>( itemsPerLane ) );
+    }
+}
+
+TEST( QueueSetTest, AddBeyondMaxMembersFails ) {
+    std::vector<Lane<int>> lanes( QueueSet::MaxMembers + 1 );
+    QueueSet               set;
+    for ( std::size_t i = 0; i < QueueSet::MaxMembers; ++i ) {
+        EXPECT_EQ( set.Add( lanes[ i ] ), i );
+    }
+
+    // a full set turns the queue away and leaves its notifier unbound
+    Lane<int>& extra = lanes.back();
+    EXPECT_EQ( set.Add( extra ), QueueSet::NoMember );
+    EXPECT_EQ( set.Size(), QueueSet::MaxMembers );
+    EXPECT_TRUE( extra.Enqueue( 1 ) );
+    EXPECT_EQ( set.TryWait(), QueueSet::NoMember );
+
+    EXPECT_TRUE( lanes[ QueueSet::MaxMembers - 1 ].Enqueue( 2 ) );
+    EXPECT_EQ( set.TryWait(), QueueSet::MaxMembers - 1 );
+}
+
+TEST( QueueSetTest, StalePermitsDoNotExtendTimeout ) {
+    Lane<int> lane;
+    QueueSet  set;
+    set.Add( lane );
+
+    // a second consumer keeps taking the member before the waiter gets to it, so the waiter mostly wakes on
+    // permits whose member is already gone; each of those must not start the timeout over
+    std::atomic<bool> stop{ false };
+    std::thread       thief( [ & ] {
+        while ( !stop.load( std::memory_order_relaxed ) ) {
+            lane.Enqueue( 1 );
+            set.TryWait();
+            int value;
+            while ( lane.TryDequeue( value ) ) {
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+        }
+    } );
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( 300 );
+    while ( std::chrono::steady_clock::now() < deadline ) {
+        auto start = std::chrono::steady_clock::now();
+        set.Wait( 20 );
+        EXPECT_LT( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 100 ) );
+    }
+    stop = true;
+    thief.join();
+}
@@ -0,0 +1,261 @@
+#include "ConcurrentQueue/SharedMemoryConcurrentQueue.h"
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace hakle;
+
+namespace {
+
+using Queue = SharedMemoryConcurrentQueue<std::uint64_t, 8>;
+
+// a small region so that blocks wrap around and run out quickly
+constexpr Queue::Geometry SmallGeometry{ 4, 4, 2 };
+
+std::string UniqueName( const char* Test ) { return std::string( "/hakle-" ) + Test + "-" + std::to_string( ::getpid() ); }
+
+}  // namespace
+
+TEST( SharedMemoryConcurrentQueueTest, RoundTripInOrder ) {
+    Queue queue = Queue::Create();
+    auto  token = queue.GetProducerToken();
+    ASSERT_TRUE( token.Valid() );
+
+    for ( std::uint64_t i = 0; i < 100; ++i ) {
+        EXPECT_TRUE( queue.Enqueue( token, i ) );
+    }
+    std::vector<std::uint64_t> batch{ 100, 101, 102, 103, 104 };
+    EXPECT_TRUE( queue.EnqueueBulk( token, batch.begin(), batch.size() ) );
+    EXPECT_EQ( queue.SizeApprox(), 105 );
+
+    std::uint64_t value = 0;
+    for ( std::uint64_t i = 0; i < 50; ++i ) {
+        ASSERT_TRUE( queue.TryDequeue( value ) );
+        EXPECT_EQ( value, i );
+    }
+    std::uint64_t out[ 64 ];
+    EXPECT_EQ( queue.TryDequeueBulk( out, 64 ), 55 );
+    for ( std::uint64_t i = 0; i < 55; ++i ) {
+        EXPECT_EQ( out[ i ], 50 + i );
+    }
+    EXPECT_FALSE( queue.TryDequeue( value ) );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, BlocksAreReused ) {
+    Queue queue = Queue::Create( SmallGeometry );
+    auto  token = queue.GetProducerToken();
+
+    // two blocks in flight per producer
+    std::uint64_t next = 0;
+    while ( queue.Enqueue( token, next ) ) {
+        ++next;
+    }
+    EXPECT_EQ( next, 2 * Queue::BlockSize );
+
+    std::uint64_t value    = 0;
+    std::uint64_t expected = 0;
+    for ( int round = 0; round < 1000; ++round ) {
+        for ( std::size_t i = 0; i < Queue::BlockSize; ++i ) {
+            ASSERT_TRUE( queue.TryDequeue( value ) );
+            ASSERT_EQ( value, expected++ );
+        }
+        // the oldest block is empty again, exactly one block fits
+        for ( std::size_t i = 0; i < Queue::BlockSize; ++i ) {
+            ASSERT_TRUE( queue.Enqueue( token, next++ ) ) << round;
+        }
+        ASSERT_FALSE( queue.Enqueue( token, next ) );
+    }
+
+    // bulk enqueue is all or nothing
+    std::uint64_t items[ 3 * Queue::BlockSize ]{};
+    EXPECT_FALSE( queue.EnqueueBulk( token, items, 3 * Queue::BlockSize ) );
+    while ( queue.TryDequeue( value ) ) {
+        ASSERT_EQ( value, expected++ );
+    }
+    EXPECT_EQ( expected, next );
+    EXPECT_FALSE( queue.EnqueueBulk( token, items, 3 * Queue::BlockSize ) );
+    EXPECT_TRUE( queue.EnqueueBulk( token, items, 2 * Queue::BlockSize ) );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, FreeListIsShared ) {
+    Queue queue = Queue::Create( SmallGeometry );
+    auto  first = queue.GetProducerToken();
+    auto  other = queue.GetProducerToken();
+
+    // four blocks in the region, the second producer can only have what the first one left
+    std::uint64_t items[ 2 * Queue::BlockSize ]{};
+    EXPECT_TRUE( queue.EnqueueBulk( first, items, Queue::BlockSize + 1 ) );
+    EXPECT_FALSE( queue.EnqueueBulk( other, items, 2 * Queue::BlockSize + 1 ) );
+    EXPECT_TRUE( queue.EnqueueBulk( other, items, 2 * Queue::BlockSize ) );
+    EXPECT_FALSE( queue.EnqueueBulk( other, items, 1 ) );
+    EXPECT_TRUE( queue.EnqueueBulk( first, items, Queue::BlockSize - 1 ) );
+    EXPECT_FALSE( queue.EnqueueBulk( first, items, 1 ) );
+    EXPECT_EQ( queue.SizeApprox(), 4 * Queue::BlockSize );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, DrainedBlocksGoToOtherProducers ) {
+    Queue queue = Queue::Create( Queue::Geometry{ 4, 2, 4 } );
+    auto  idle  = queue.GetProducerToken();
+    auto  busy  = queue.GetProducerToken();
+
+    // the first producer takes every block in the region and then stops enqueueing
+    std::uint64_t next = 0;
+    while ( queue.Enqueue( idle, next ) ) {
+        ++next;
+    }
+    EXPECT_EQ( next, 4 * Queue::BlockSize );
+    EXPECT_FALSE( queue.Enqueue( busy, 0 ) );
+
+    std::uint64_t value = 0;
+    for ( std::uint64_t i = 0; i < next; ++i ) {
+        ASSERT_TRUE( queue.TryDequeue( value ) );
+        EXPECT_EQ( value, i );
+    }
+
+    // its drained blocks are back on the free list without it enqueueing again
+    for ( int round = 0; round < 100; ++round ) {
+        for ( std::uint64_t i = 0; i < 4 * Queue::BlockSize; ++i ) {
+            ASSERT_TRUE( queue.Enqueue( busy, i ) ) << round;
+        }
+        EXPECT_FALSE( queue.Enqueue( busy, 0 ) );
+        for ( std::uint64_t i = 0; i < 4 * Queue::BlockSize; ++i ) {
+            ASSERT_TRUE( queue.TryDequeue( value ) );
+            EXPECT_EQ( value, i );
+        }
+    }
+    EXPECT_TRUE( queue.Enqueue( idle, 7 ) );
+    ASSERT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 7 );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, DroppedTokenSlotIsReused ) {
+    Queue queue = Queue::Create( Queue::Geometry{ 4, 1, 2 } );
+    {
+        auto token = queue.GetProducerToken();
+        ASSERT_TRUE( token.Valid() );
+        EXPECT_FALSE( queue.GetProducerToken().Valid() );
+        EXPECT_TRUE( queue.Enqueue( token, 1 ) );
+    }
+    auto token = queue.GetProducerToken();
+    ASSERT_TRUE( token.Valid() );
+    EXPECT_TRUE( queue.Enqueue( token, 2 ) );
+
+    std::uint64_t value = 0;
+    ASSERT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 1 );
+    ASSERT_TRUE( queue.TryDequeue( value ) );
+    EXPECT_EQ( value, 2 );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, NamedRegionMappedTwice ) {
+    const std::string name = UniqueName( "named" );
+    Queue             created = Queue::Create( name.c_str(), SmallGeometry );
+    EXPECT_THROW( Queue::Create( name.c_str() ), std::system_error );
+
+    // a second mapping of the same region sits at another address, offsets make that work
+    Queue opened = Queue::Open( name.c_str() );
+    Queue::Unlink( name.c_str() );
+    EXPECT_EQ( opened.GetGeometry().BlockCount, SmallGeometry.BlockCount );
+
+    auto token = created.GetProducerToken();
+    for ( std::uint64_t i = 0; i < 16; ++i ) {
+        EXPECT_TRUE( created.Enqueue( token, i ) );
+    }
+    std::uint64_t value = 0;
+    for ( std::uint64_t i = 0; i < 16; ++i ) {
+        ASSERT_TRUE( opened.TryDequeue( value ) );
+        EXPECT_EQ( value, i );
+    }
+    EXPECT_FALSE( created.TryDequeue( value ) );
+
+    Queue byFd = Queue::Open( created.Fd() );
+    EXPECT_TRUE( created.Enqueue( token, 42 ) );
+    ASSERT_TRUE( byFd.TryDequeue( value ) );
+    EXPECT_EQ( value, 42 );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, OpenRejectsOtherTypes ) {
+    Queue queue = Queue::Create();
+    EXPECT_THROW( ( SharedMemoryConcurrentQueue<std::uint32_t, 8>::Open( queue.Fd() ) ), std::system_error );
+    EXPECT_THROW( ( SharedMemoryConcurrentQueue<std::uint64_t, 16>::Open( queue.Fd() ) ), std::system_error );
+    EXPECT_THROW( Queue::Open( "/hakle-does-not-exist" ), std::system_error );
+    EXPECT_THROW( Queue::Create( Queue::Geometry{ 4, 4, 3 } ), std::system_error );
+}
+
+TEST( SharedMemoryConcurrentQueueTest, ProducerProcesses ) {
+    constexpr int           producerCount = 3;
+    constexpr int           consumerCount = 2;
+    constexpr std::uint64_t itemsPerProd  = 100000;
+    constexpr std::uint64_t totalItems    = producerCount * itemsPerProd;
+
+    Queue queue = Queue::Create( Queue::Geometry{ 64, 4, 8 } );
+
+    std::vector<pid_t> children;
+    for ( int p = 0; p < producerCount; ++p ) {
+        pid_t pid = ::fork();
+        ASSERT_GE( pid, 0 );
+        if ( pid == 0 ) {
+            // the child maps the inherited descriptor again, at its own address
+            Queue mine  = Queue::Open( queue.Fd() );
+            auto  token = mine.GetProducerToken();
+            for ( std::uint64_t i = 0; i < itemsPerProd; ++i ) {
+                while ( !mine.Enqueue( token, static_cast<std::uint64_t>( p ) << 32 | i ) ) {
+                    std::this_thread::yield();
+                }
+            }
+            ::_exit( 0 );
+        }
+        children.push_back( pid );
+    }
+
+    std::atomic<std::uint64_t> consumed{ 0 };
+    std::atomic<std::uint64_t> sum{ 0 };
+    std::atomic<std::uint64_t> disorder{ 0 };
+    std::vector<std::thread>   consumers;
+    for ( int c = 0; c < consumerCount; ++c ) {
+        consumers.emplace_back( [ & ] {
+            // each consumer sees every producer's elements in order
+            std::vector<std::int64_t> last( producerCount, -1 );
+            std::uint64_t             items[ 16 ];
+            while ( consumed.load( std::memory_order_relaxed ) < totalItems ) {
+                std::size_t count = queue.TryDequeueBulk( items, 16 );
+                if ( count == 0 ) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for ( std::size_t i = 0; i < count; ++i ) {
+                    int          producer = static_cast<int>( items[ i ] >> 32 );
+                    std::int64_t seq      = static_cast<std::int64_t>( items[ i ] & 0xffffffff );
+                    if ( seq <= last[ producer ] ) {
+                        disorder.fetch_add( 1, std::memory_order_relaxed );
+                    }
+                    last[ producer ] = seq;
+                    sum.fetch_add( static_cast<std::uint64_t>( seq ), std::memory_order_relaxed );
+                }
+                consumed.fetch_add( count, std::memory_order_relaxed );
+            }
+        } );
+    }
+    for ( auto& t : consumers ) {
+        t.join();
+    }
+    for ( pid_t pid : children ) {
+        int status = 0;
+        ASSERT_EQ( ::waitpid( pid, &status, 0 ), pid );
+        EXPECT_TRUE( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 );
+    }
+
+    EXPECT_EQ( disorder.load(), 0 );
+    EXPECT_EQ( consumed.load(), totalItems );
+    EXPECT_EQ( sum.load(), producerCount * ( itemsPerProd * ( itemsPerProd - 1 ) / 2 ) );
+    EXPECT_EQ( queue.SizeApprox(), 0 );
+}
@@ -6,6 +6,7 @@
 #include "ConcurrentQueue/ConcurrentQueue.h"
 #include <atomic>
 #include <chrono>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -22,6 +23,27 @@ using TestCounterQueue = SlowQueue<int, kBlockSize>;
 using TestCounterBlockManager = HakleCounterBlockManager<int, kBlockSize>;
 using TestFlagsBlockManager   = HakleCounterBlockManager<int, kBlockSize>;
 
+// 记录逐个构造的次数，memcpy 路径不会经过分配器的 Construct
+template <class Tp>
+struct ConstructCountingAllocator : HakleAllocator<Tp> {
+    static inline int Constructs = 0;
+
+    template <class Up>
+    struct rebind {
+        using other = ConstructCountingAllocator<Up>;
+    };
+
+    ConstructCountingAllocator() noexcept = default;
+    template <class Up>
+    ConstructCountingAllocator( const ConstructCountingAllocator<Up>& ) noexcept {}  // NOLINT(*-explicit-constructor)
+
+    template <class... Args>
+    static void Construct( Tp* ptr, Args&&... args ) {
+        ++Constructs;
+        HakleAllocator<Tp>::Construct( ptr, std::forward<Args>( args )... );
+    }
+};
+
 // 辅助：等待一段时间让操作完成
 void SleepFor( std::int64_t ms ) { std::this_thread::sleep_for( std::chrono::milliseconds( ms ) ); }
 
@@ -367,6 +389,59 @@ TEST( SlowQueueTest, MultiConsumerStressTestWithException ) {
     EXPECT_EQ( queue.Size(), 0 );
 }
 
+// === 测试 8: 平凡类型批量 memcpy 与 EnqueueBulkMove ===
+TEST( SlowQueueTest, BulkMemcpyAndMove ) {
+    TestFlagsBlockManager blockManager( POOL_SIZE );
+    TestFlagsQueue        queue( 10, blockManager );
+    using AllocMode = TestFlagsQueue::AllocMode;
+
+    // 从非对齐位置开始，跨越多个 block
+    EXPECT_TRUE( queue.Enqueue<AllocMode::CanAlloc>( -1 ) );
+    std::vector<int> in( 3 * kBlockSize + 1 );
+    for ( std::size_t i = 0; i < in.size(); ++i ) {
+        in[ i ] = static_cast<int>( i );
+    }
+    EXPECT_TRUE( queue.EnqueueBulk<AllocMode::CanAlloc>( in.begin(), in.size() ) );
+
+    std::vector<int> out( in.size() + 1 );
+    EXPECT_EQ( queue.DequeueBulk( out.begin(), out.size() ), out.size() );
+    EXPECT_EQ( out[ 0 ], -1 );
+    EXPECT_TRUE( std::equal( in.begin(), in.end(), out.begin() + 1 ) );
+
+    // 平凡类型的 EnqueueBulkMove 同样整段 memcpy，不经过 Construct
+    using CountingQueue = SlowQueue<int, kBlockSize, ConstructCountingAllocator<int>>;
+    TestFlagsBlockManager countingManager( POOL_SIZE );
+    CountingQueue         counting( 10, countingManager );
+    ConstructCountingAllocator<int>::Constructs = 0;
+    EXPECT_TRUE( counting.EnqueueBulkMove<CountingQueue::AllocMode::CanAlloc>( in.begin(), in.size() ) );
+    EXPECT_EQ( ConstructCountingAllocator<int>::Constructs, 0 );
+    EXPECT_EQ( counting.DequeueBulk( out.begin(), in.size() ), in.size() );
+    EXPECT_TRUE( std::equal( in.begin(), in.end(), out.begin() ) );
+
+    // 逐个构造的路径确实会被计数
+    EXPECT_TRUE( counting.Enqueue<CountingQueue::AllocMode::CanAlloc>( 1 ) );
+    EXPECT_EQ( ConstructCountingAllocator<int>::Constructs, 1 );
+
+    // 非平凡类型走逐个移动构造
+    using StringQueue        = SlowQueue<std::string, kBlockSize>;
+    using StringBlockManager = HakleBlockManager<HakleCounterBlock<std::string, kBlockSize>>;
+    StringBlockManager       stringManager( POOL_SIZE );
+    StringQueue              strings( 10, stringManager );
+    std::vector<std::string> words( kBlockSize + 1, std::string( 64, 'x' ) );
+    EXPECT_TRUE( strings.EnqueueBulkMove<StringQueue::AllocMode::CanAlloc>( words.begin(), words.size() ) );
+    for ( const std::string& word : words ) {
+        EXPECT_TRUE( word.empty() );
+    }
+
+    std::string word;
+    std::size_t count = 0;
+    while ( strings.Dequeue( word ) ) {
+        EXPECT_EQ( word, std::string( 64, 'x' ) );
+        ++count;
+    }
+    EXPECT_EQ( count, kBlockSize + 1 );
+}
+
 // test/queue_test.cpp 最后加上：
 int main( int argc, char** argv ) {
     ::testing::InitGoogleTest( &argc, argv );